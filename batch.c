@@ -0,0 +1,174 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "morsectrl.h"
+
+/** Maximum length of a line in a batch file */
+#define BATCH_MAX_LINE_LEN      (8192)
+/** Maximum number of arguments of a command in a batch file */
+#define BATCH_MAX_ARGC          (128)
+
+/**
+ * @brief Split a line into arguments in place.
+ *
+ * Arguments are separated by whitespace and may be quoted with single or double quotes. Outside
+ * of single quotes a backslash escapes the following character. Anything following an unquoted
+ * '#' at the start of an argument is treated as a comment.
+ *
+ * @param line      Line to split, modified in place
+ * @param argv      Filled with pointers to each argument
+ * @param max_args  Maximum number of arguments that fit in argv
+ *
+ * @return          The number of arguments, or -1 if the line is malformed
+ */
+static int batch_split_line(char *line, char *argv[], int max_args)
+{
+    char *in = line;
+    char *out = line;
+    int argc = 0;
+
+    while (true)
+    {
+        char quote = '\0';
+
+        while (isspace((unsigned char)*in))
+            in++;
+
+        if (*in == '\0' || *in == '#')
+            break;
+
+        if (argc == max_args)
+        {
+            mctrl_err("Too many arguments\n");
+            return -1;
+        }
+        argv[argc++] = out;
+
+        while (*in != '\0')
+        {
+            if (quote)
+            {
+                if (*in == quote)
+                {
+                    quote = '\0';
+                    in++;
+                    continue;
+                }
+            }
+            else if (*in == '\'' || *in == '"')
+            {
+                quote = *in++;
+                continue;
+            }
+            else if (isspace((unsigned char)*in))
+            {
+                in++;
+                break;
+            }
+
+            if (*in == '\\' && quote != '\'' && in[1] != '\0')
+                in++;
+
+            *out++ = *in++;
+        }
+
+        if (quote)
+        {
+            mctrl_err("Unterminated quote\n");
+            return -1;
+        }
+
+        /* out never overtakes in, so terminating here cannot clobber unread input */
+        *out++ = '\0';
+    }
+
+    return argc;
+}
+
+int morsectrl_batch_run(struct morsectrl *mors, const char *filename)
+{
+    char line[BATCH_MAX_LINE_LEN];
+    char *argv[BATCH_MAX_ARGC + 1];
+    bool use_stdin = !strcmp(filename, "-");
+    FILE *infile;
+    int lineno = 0;
+    int ret;
+
+    infile = use_stdin ? stdin : fopen(filename, "r");
+    if (!infile)
+    {
+        mctrl_err("Could not open batch file %s\n", filename);
+        return MORSE_ARG_ERR;
+    }
+
+    ret = morsectrl_transport_init(mors->transport);
+    if (ret)
+    {
+        mctrl_err("Transport init failed\n");
+        goto exit;
+    }
+
+    while (fgets(line, sizeof(line), infile))
+    {
+        size_t len = strlen(line);
+        int argc;
+
+        lineno++;
+
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n' && !feof(infile))
+        {
+            mctrl_err("%s:%d: line too long\n", filename, lineno);
+            ret = MORSE_ARG_ERR;
+            break;
+        }
+
+        argc = batch_split_line(line, argv, BATCH_MAX_ARGC);
+        if (argc < 0)
+        {
+            mctrl_err("%s:%d: could not parse command\n", filename, lineno);
+            ret = MORSE_ARG_ERR;
+            break;
+        }
+
+        if (argc == 0)
+            continue;
+
+        argv[argc] = NULL;
+
+        ret = morsectrl_run_command(mors, argc, argv, false);
+        fflush(stdout);
+
+        if (ret)
+        {
+            mctrl_err("%s:%d: command '%s' failed (%d)\n", filename, lineno, argv[0], ret);
+            break;
+        }
+    }
+
+    morsectrl_transport_deinit(mors->transport);
+
+exit:
+    if (!use_stdin)
+        fclose(infile);
+
+    return ret;
+}
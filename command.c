@@ -28,13 +28,32 @@
 
 #define MORSECTRL_CMD_REQ_FLAG      (BIT(0))
 
+/** Commands being waited on by morsectrl_poll_commands() */
+struct async_poll_ctx
+{
+    struct morsectrl_transport *transport;
+    struct morsectrl_async_command *cmds;
+    size_t n_cmds;
+};
+
+static void morsectrl_fill_cmd_hdr(struct morsectrl_transport_buff *cmd, int message_id,
+                                   uint16_t host_id)
+{
+    struct command *command = (struct command *)cmd->data;
+
+    memset(&command->hdr, 0, sizeof(command->hdr));
+    command->hdr.message_id = htole16(message_id);
+    command->hdr.len = htole16(cmd->data_len - sizeof(struct command));
+    command->hdr.flags = MORSECTRL_CMD_REQ_FLAG;
+    command->hdr.host_id = htole16(host_id);
+}
+
 int morsectrl_send_command(struct morsectrl_transport *transport,
                            int message_id,
                            struct morsectrl_transport_buff *cmd,
                            struct morsectrl_transport_buff *resp)
 {
     int ret = 0;
-    struct command *command;
     struct response *response;
 
     if (!cmd || !resp)
@@ -43,11 +62,7 @@ int morsectrl_send_command(struct morsectrl_transport *transport,
         goto exit;
     }
 
-    command = (struct command *)cmd->data;
-    memset(&command->hdr, 0, sizeof(command->hdr));
-    command->hdr.message_id = htole16(message_id);
-    command->hdr.len = htole16(cmd->data_len - sizeof(struct command));
-    command->hdr.flags = MORSECTRL_CMD_REQ_FLAG;
+    morsectrl_fill_cmd_hdr(cmd, message_id, 0);
     response = (struct response *)resp->data;
 
     ret = morsectrl_transport_send(transport, cmd, resp);
@@ -72,3 +87,141 @@ int morsectrl_send_command(struct morsectrl_transport *transport,
 exit:
     return ret;
 } // NOLINT - checkstyle.py seems to think this brace is in the wrong place.
+
+int morsectrl_send_command_async(struct morsectrl_transport *transport,
+                                 int message_id,
+                                 struct morsectrl_transport_buff *cmd,
+                                 struct morsectrl_transport_buff *resp,
+                                 struct morsectrl_async_command *async)
+{
+    int ret;
+
+    memset(async, 0, sizeof(*async));
+    async->resp = resp;
+
+    if (!cmd || !resp)
+        return -ENOMEM;
+
+    if (!morsectrl_transport_has_async(transport))
+    {
+        async->ret = morsectrl_send_command(transport, message_id, cmd, resp);
+        async->done = true;
+        return 0;
+    }
+
+    async->host_id = morsectrl_transport_new_tag(transport);
+    morsectrl_fill_cmd_hdr(cmd, message_id, async->host_id);
+
+    ret = morsectrl_transport_submit(transport, cmd, async->host_id);
+    if (ret < 0)
+        morsectrl_transport_debug(transport, "Message submit failed %d\n", ret);
+
+    return ret;
+}
+
+/**
+ * @brief Completion function matching a response to the command with the same host_id.
+ *
+ * Responses to commands that are not being waited on (e.g. already timed out) are dropped.
+ */
+static void morsectrl_async_complete(void *arg, uint16_t tag, int status,
+                                     const uint8_t *data, size_t len)
+{
+    struct async_poll_ctx *ctx = arg;
+    struct morsectrl_async_command *async = NULL;
+    const struct response *response;
+
+    for (size_t i = 0; i < ctx->n_cmds; i++)
+    {
+        if (!ctx->cmds[i].done && ctx->cmds[i].host_id == tag)
+        {
+            async = &ctx->cmds[i];
+            break;
+        }
+    }
+
+    if (!async)
+    {
+        morsectrl_transport_debug(ctx->transport, "Dropping response with host id %u\n", tag);
+        return;
+    }
+
+    async->done = true;
+
+    if (status < 0)
+    {
+        morsectrl_transport_debug(ctx->transport, "Message failed %d\n", status);
+        async->ret = status;
+        return;
+    }
+
+    if (len < sizeof(*response) || len > async->resp->capacity)
+    {
+        morsectrl_transport_debug(ctx->transport, "Bad response length %zu\n", len);
+        async->ret = -ETRANSERR;
+        return;
+    }
+
+    memcpy(async->resp->data, data, len);
+    async->resp->data_len = len;
+
+    response = (const struct response *)async->resp->data;
+    async->ret = le32toh(response->status);
+    if (async->ret && async->ret != 110)
+        morsectrl_transport_debug(ctx->transport, "Command failed\n");
+}
+
+int morsectrl_poll_commands(struct morsectrl_transport *transport,
+                            struct morsectrl_async_command *cmds,
+                            size_t n_cmds)
+{
+    struct async_poll_ctx ctx = {
+        .transport = transport,
+        .cmds = cmds,
+        .n_cmds = n_cmds,
+    };
+    int pending = 0;
+    int ret;
+
+    for (size_t i = 0; i < n_cmds; i++)
+        pending += !cmds[i].done;
+
+    if (!pending)
+        return 0;
+
+    ret = morsectrl_transport_receive(transport, morsectrl_async_complete, &ctx);
+    if (ret < 0)
+        return ret;
+
+    pending = 0;
+    for (size_t i = 0; i < n_cmds; i++)
+        pending += !cmds[i].done;
+
+    return pending;
+}
+
+int morsectrl_wait_commands(struct morsectrl_transport *transport,
+                            struct morsectrl_async_command *cmds,
+                            size_t n_cmds)
+{
+    int ret;
+
+    do
+    {
+        ret = morsectrl_poll_commands(transport, cmds, n_cmds);
+    } while (ret > 0);
+
+    if (ret < 0)
+    {
+        for (size_t i = 0; i < n_cmds; i++)
+        {
+            if (!cmds[i].done)
+            {
+                cmds[i].ret = ret;
+                cmds[i].done = true;
+            }
+        }
+    }
+
+    return ret;
+}
@@ -158,3 +158,67 @@ int morsectrl_send_command(struct morsectrl_transport *transport,
                            int message_id,
                            struct morsectrl_transport_buff *cmd,
                            struct morsectrl_transport_buff *resp);
+
+/**
+ * A command sent with morsectrl_send_command_async(), owned by the caller until complete.
+ */
+struct morsectrl_async_command
+{
+    /** Buffer the response is written to */
+    struct morsectrl_transport_buff *resp;
+    /** Host sequence id the command was tagged with */
+    uint16_t host_id;
+    /** Set once the response (or an error) has been received */
+    bool done;
+    /** Result of the command once done, as returned by morsectrl_send_command() */
+    int ret;
+};
+
+/**
+ * @brief Send a command without waiting for its response.
+ *
+ * The command is tagged with a unique host_id that is used to match it to its response, so that
+ * several commands may be in flight at once. If the transport can only have one command in flight
+ * the command is sent synchronously and is complete on return.
+ *
+ * @param transport     Transport to send the command on.
+ * @param message_id    Command message ID (enum morse_commands_id).
+ * @param cmd           Command buffer. May be freed once this returns.
+ * @param resp          Response buffer. Must remain valid until the command is done.
+ * @param async         Filled with the state of the command.
+ *
+ * @return 0 if the command was sent, otherwise a negative error code.
+ */
+int morsectrl_send_command_async(struct morsectrl_transport *transport,
+                                 int message_id,
+                                 struct morsectrl_transport_buff *cmd,
+                                 struct morsectrl_transport_buff *resp,
+                                 struct morsectrl_async_command *async);
+
+/**
+ * @brief Wait for at least one response to commands sent with morsectrl_send_command_async().
+ *
+ * @param transport     Transport the commands were sent on.
+ * @param cmds          Commands to receive responses for.
+ * @param n_cmds        Number of commands.
+ *
+ * @return The number of commands still not done, otherwise a negative error code.
+ */
+int morsectrl_poll_commands(struct morsectrl_transport *transport,
+                            struct morsectrl_async_command *cmds,
+                            size_t n_cmds);
+
+/**
+ * @brief Wait for all commands sent with morsectrl_send_command_async() to complete.
+ *
+ * On a transport error, commands that are not yet done are completed with the error.
+ *
+ * @param transport     Transport the commands were sent on.
+ * @param cmds          Commands to wait for.
+ * @param n_cmds        Number of commands.
+ *
+ * @return 0 once all commands are done, otherwise a negative transport error code.
+ */
+int morsectrl_wait_commands(struct morsectrl_transport *transport,
+                            struct morsectrl_async_command *cmds,
+                            size_t n_cmds);
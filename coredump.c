@@ -16,14 +16,236 @@
  * <https://www.gnu.org/licenses/>.
  */
 
+#ifdef MORSE_WIN_BUILD
+#include "win/elf.h"
+#else
+#include <elf.h>
+#endif
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "portable_endian.h"
 #include "command.h"
+#include "elf_file.h"
+#include "utilities.h"
 
-static void usage(struct morsectrl *mors)
+/** Size of each read of chip memory, matching the 64k window of the SDIO keyhole */
+#define COREDUMP_CHUNK_SIZE             (64 * 1024UL)
+/** Minimum time between progress updates */
+#define COREDUMP_PROGRESS_INTERVAL_US   (250000)
+
+static struct
+{
+    struct arg_file *output;
+    struct arg_file *firmware;
+} args;
+
+int coredump_init(struct morsectrl *mors, struct mm_argtable *mm_args)
+{
+    MM_INIT_ARGTABLE(mm_args,
+                     "Generate a FW coredump through the driver with pattern "
+                     "/var/log/mmcd_hostname_ip_date/, or directly from chip memory with -o",
+                     args.output = arg_file0("o", "output", "<core file>",
+                                             "read the firmware's RAM directly from the chip and "
+                                             "write it to an ELF core file"),
+                     args.firmware = arg_file0("f", "firmware", "<firmware ELF>",
+                                               "firmware running on the chip, giving the RAM "
+                                               "regions to dump (required with -o)"));
+    return 0;
+}
+
+/**
+ * @brief Write the ELF header and program headers of a core file.
+ *
+ * Each region becomes a PT_LOAD segment, with the segment data following the headers in order.
+ *
+ * @param out       Core file
+ * @param regions   Regions of chip memory being dumped
+ * @param n_regions Number of regions
+ * @param machine   ELF machine of the firmware
+ *
+ * @return          0 on success otherwise -EIO
+ */
+static int coredump_write_headers(FILE *out, const struct elf_file_region *regions,
+                                  size_t n_regions, uint16_t machine)
+{
+    Elf32_Ehdr ehdr;
+    uint32_t offset = sizeof(Elf32_Ehdr) + (n_regions * sizeof(Elf32_Phdr));
+
+    memset(&ehdr, 0, sizeof(ehdr));
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS32;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_type = htole16(ET_CORE);
+    ehdr.e_machine = htole16(machine);
+    ehdr.e_version = htole32(EV_CURRENT);
+    ehdr.e_phoff = htole32(sizeof(Elf32_Ehdr));
+    ehdr.e_ehsize = htole16(sizeof(Elf32_Ehdr));
+    ehdr.e_phentsize = htole16(sizeof(Elf32_Phdr));
+    ehdr.e_phnum = htole16(n_regions);
+
+    if (fwrite(&ehdr, sizeof(ehdr), 1, out) != 1)
+        return -EIO;
+
+    for (size_t ii = 0; ii < n_regions; ii++)
+    {
+        Elf32_Phdr phdr;
+
+        memset(&phdr, 0, sizeof(phdr));
+        phdr.p_type = htole32(PT_LOAD);
+        phdr.p_offset = htole32(offset);
+        phdr.p_vaddr = htole32(regions[ii].addr);
+        phdr.p_paddr = htole32(regions[ii].addr);
+        phdr.p_filesz = htole32(regions[ii].size);
+        phdr.p_memsz = htole32(regions[ii].size);
+        phdr.p_flags = htole32(regions[ii].flags);
+        phdr.p_align = htole32(sizeof(uint32_t));
+
+        if (fwrite(&phdr, sizeof(phdr), 1, out) != 1)
+            return -EIO;
+
+        offset += regions[ii].size;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Print how much of the dump has been done.
+ *
+ * @param done      Octets dumped so far
+ * @param total     Octets to dump
+ * @param start_us  Time the dump started
+ * @param final     Whether this is the last update
+ */
+static void coredump_print_progress(size_t done, size_t total, uint64_t start_us, bool final)
 {
-    mctrl_print("\tcoredump\t\tgenerates a FW coredump through the driver\n"
-           "\t\t\t\twith pattern /var/log/mmcd_hostname_ip_date/\n");
+    uint64_t elapsed_us = MAX(time_monotonic_us() - start_us, (uint64_t)1);
+
+    mctrl_print("\rDumped %zu/%zu KiB (%zu%%), %.1f KiB/s%s",
+                done / 1024, total / 1024, total ? (done * 100) / total : 100,
+                (done / 1024.0) / (elapsed_us / 1000000.0), final ? "\n" : "");
+    fflush(stdout);
+}
+
+/**
+ * @brief Read the firmware's RAM regions from the chip and write them to an ELF core file.
+ *
+ * @param mors      Morsectrl context
+ * @param firmware  Path to the firmware ELF file running on the chip
+ * @param filename  Path of the core file to write
+ *
+ * @return          0 on success otherwise a negative error code
+ */
+static int coredump_direct(struct morsectrl *mors, const char *firmware, const char *filename)
+{
+    struct elf_file_region *regions = NULL;
+    size_t n_regions = 0;
+    size_t total = 0;
+    size_t done = 0;
+    uint16_t machine = 0;
+    uint64_t start_us;
+    uint64_t last_us = 0;
+    FILE *out;
+    int ret;
+
+    ret = elf_file_get_load_regions(firmware, &regions, &n_regions, &machine);
+    if (ret)
+    {
+        mctrl_err("Failed to read the program headers of %s\n", firmware);
+        return ret;
+    }
+
+    out = fopen(filename, "wb");
+    if (!out)
+    {
+        mctrl_err("Failed to open %s\n", filename);
+        free(regions);
+        return -ENOENT;
+    }
+
+    for (size_t ii = 0; ii < n_regions; ii++)
+        total += regions[ii].size;
+
+    ret = coredump_write_headers(out, regions, n_regions, machine);
+    if (ret)
+    {
+        mctrl_err("Failed to write %s\n", filename);
+        goto exit;
+    }
+
+    start_us = time_monotonic_us();
+
+    for (size_t ii = 0; ii < n_regions; ii++)
+    {
+        uint32_t addr = regions[ii].addr;
+        uint32_t end = regions[ii].addr + regions[ii].size;
+
+        if (mors->debug)
+            mctrl_print("Dumping region %zu: 0x%08x-0x%08x\n", ii, addr, end - 1);
+
+        while (addr < end)
+        {
+            /* Stop each read at a 64k boundary so that it is a single keyhole window */
+            uint32_t chunk = MIN(end - addr,
+                                 COREDUMP_CHUNK_SIZE - (addr & (COREDUMP_CHUNK_SIZE - 1)));
+            struct morsectrl_transport_buff *read;
+            uint64_t now_us;
+
+            read = morsectrl_transport_raw_read_alloc(mors->transport, chunk);
+            if (!read)
+            {
+                ret = -ENOMEM;
+                goto exit;
+            }
+
+            ret = morsectrl_transport_mem_read(mors->transport, read, addr);
+            if (ret)
+            {
+                mctrl_err("\nFailed to read chip memory at 0x%08x (%d)\n", addr, ret);
+                morsectrl_transport_buff_free(read);
+                goto exit;
+            }
+
+            if (fwrite(read->data, 1, chunk, out) != chunk)
+            {
+                mctrl_err("\nFailed to write %s\n", filename);
+                morsectrl_transport_buff_free(read);
+                ret = -EIO;
+                goto exit;
+            }
+
+            morsectrl_transport_buff_free(read);
+
+            addr += chunk;
+            done += chunk;
+
+            now_us = time_monotonic_us();
+            if (now_us - last_us >= COREDUMP_PROGRESS_INTERVAL_US)
+            {
+                coredump_print_progress(done, total, start_us, false);
+                last_us = now_us;
+            }
+        }
+    }
+
+    coredump_print_progress(done, total, start_us, true);
+
+exit:
+    if (fclose(out) && !ret)
+    {
+        mctrl_err("Failed to write %s\n", filename);
+        ret = -EIO;
+    }
+
+    if (!ret)
+        mctrl_print("Wrote %zu regions to %s\n", n_regions, filename);
+
+    free(regions);
+    return ret;
 }
 
 int coredump(struct morsectrl *mors, int argc, char *argv[])
@@ -32,16 +254,24 @@ int coredump(struct morsectrl *mors, int argc, char *argv[])
     struct morsectrl_transport_buff *cmd_tbuff;
     struct morsectrl_transport_buff *rsp_tbuff;
 
-    if (argc == 0)
+    if (args.output->count)
     {
-        usage(mors);
-        return 0;
+        if (!args.firmware->count)
+        {
+            mctrl_err("The firmware ELF file must be given with -f to dump chip memory\n");
+            return -1;
+        }
+
+        ret = coredump_direct(mors, args.firmware->filename[0], args.output->filename[0]);
+        if (ret < 0)
+            mctrl_err("Command coredump error (%d)\n", ret);
+
+        return ret;
     }
 
-    if (argc != 1)
+    if (!morsectrl_transport_has_driver(mors->transport))
     {
-        mctrl_err("Invalid command parameters\n");
-        usage(mors);
+        mctrl_err("Without a driver the coredump must be read from the chip, using -o and -f\n");
         return -1;
     }
 
@@ -64,4 +294,4 @@ exit:
     return ret;
 }
 
-MM_CLI_HANDLER(coredump, MM_INTF_REQUIRED, MM_DIRECT_CHIP_NOT_SUPPORTED);
+MM_CLI_HANDLER(coredump, MM_INTF_REQUIRED, MM_DIRECT_CHIP_SUPPORTED);
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Compute the CRC-16 of a buffer using the XMODEM model (polynomial 0x1021, not
+ *        reflected), as used by SDIO data blocks and the UART SLIP transport.
+ *
+ * @param crc   Seed for the CRC, 0 to start a new CRC or the result of a previous call to continue
+ *              one.
+ * @param data  Data to calculate the CRC over.
+ * @param len   Length of the data in bytes.
+ *
+ * @return      The CRC.
+ */
+uint16_t crc16_xmodem(uint16_t crc, const void *data, size_t len);
+
+/**
+ * @brief Compute the CRC-7 of a buffer (polynomial 0x09, not reflected), as used by SD/SDIO
+ *        commands.
+ *
+ * @param data  Data to calculate the CRC over.
+ * @param len   Length of the data in bytes.
+ *
+ * @return      The 7-bit CRC, in the low bits.
+ */
+uint8_t crc7_sd(const void *data, size_t len);
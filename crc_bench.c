@@ -0,0 +1,178 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro-benchmark of the CRC module, built with 'make crc_bench'.
+ *
+ * Times crc16_xmodem() over blocks the size of an SDIO data block and crc7_sd() over SD command
+ * sized buffers, alongside bitwise implementations of the same CRCs for comparison. The results
+ * of both are checked to agree before anything is timed.
+ *
+ *      crc_bench [<block size>] [<total MB>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "crc.h"
+
+#define CRC_BENCH_BLOCK_SIZE_DEFAULT    (512)
+#define CRC_BENCH_TOTAL_MB_DEFAULT      (256)
+/** Length of an SD command without its CRC */
+#define CRC_BENCH_CMD_LEN               (5)
+#define CRC_BENCH_CMD_COUNT             (10 * 1000 * 1000)
+
+static uint64_t crc_bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** CRC-16/XMODEM a bit at a time, as the SDIO over SPI transport used to compute it */
+static uint16_t crc16_bitwise(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (uint16_t)(crc << 1) ^ 0x1021 : (uint16_t)(crc << 1);
+    }
+
+    return crc;
+}
+
+/** CRC-7 a bit at a time, as the SDIO over SPI transport used to compute it */
+static uint8_t crc7_bitwise(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+
+    while (len--)
+    {
+        uint8_t octet = *data++;
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc <<= 1;
+            if ((octet ^ crc) & 0x80)
+                crc ^= 0x09;
+            octet <<= 1;
+        }
+        crc &= 0x7F;
+    }
+
+    return crc;
+}
+
+/** Time a CRC-16 over count blocks, returning the throughput in MB/s */
+static double crc_bench_crc16(uint16_t (*fn)(const uint8_t *, size_t), const uint8_t *buf,
+                              size_t block_size, size_t count, volatile uint16_t *sink)
+{
+    uint64_t start = crc_bench_now_ns();
+    uint64_t elapsed;
+
+    for (size_t i = 0; i < count; i++)
+        *sink ^= fn(buf, block_size);
+
+    elapsed = crc_bench_now_ns() - start;
+
+    return elapsed ? (double)block_size * count * 1000 / elapsed : 0;
+}
+
+/** Time a CRC-7 over count commands, returning the time per command in ns */
+static double crc_bench_crc7(uint8_t (*fn)(const uint8_t *, size_t), uint8_t *cmd,
+                             size_t count, volatile uint8_t *sink)
+{
+    uint64_t start = crc_bench_now_ns();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        cmd[1] = (uint8_t)i;
+        *sink ^= fn(cmd, CRC_BENCH_CMD_LEN);
+    }
+
+    return (double)(crc_bench_now_ns() - start) / count;
+}
+
+static uint16_t crc16_table(const uint8_t *data, size_t len)
+{
+    return crc16_xmodem(0, data, len);
+}
+
+static uint8_t crc7_table(const uint8_t *data, size_t len)
+{
+    return crc7_sd(data, len);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t block_size = (argc > 1) ? strtoul(argv[1], NULL, 0) : CRC_BENCH_BLOCK_SIZE_DEFAULT;
+    size_t total_mb = (argc > 2) ? strtoul(argv[2], NULL, 0) : CRC_BENCH_TOTAL_MB_DEFAULT;
+    uint8_t cmd[CRC_BENCH_CMD_LEN] = { 0x40 };
+    volatile uint16_t sink16 = 0;
+    volatile uint8_t sink7 = 0;
+    size_t count;
+    uint8_t *buf;
+
+    if (!block_size || !total_mb)
+    {
+        fprintf(stderr, "usage: %s [<block size>] [<total MB>]\n", argv[0]);
+        return 1;
+    }
+
+    buf = malloc(block_size);
+    if (!buf)
+        return 1;
+
+    srand(1);
+    for (size_t i = 0; i < block_size; i++)
+        buf[i] = rand();
+
+    for (size_t len = 0; len <= block_size; len++)
+    {
+        if (crc16_table(buf, len) != crc16_bitwise(buf, len) ||
+            crc7_table(buf, len) != crc7_bitwise(buf, len))
+        {
+            fprintf(stderr, "CRC mismatch at length %zu\n", len);
+            free(buf);
+            return 1;
+        }
+    }
+
+    count = (total_mb * 1024 * 1024) / block_size;
+
+    /* The bitwise CRC is much slower, so it is only timed over a sixteenth of the data */
+    printf("crc16 over %zu byte blocks, %zu MB\n", block_size, total_mb);
+    printf("  bitwise       %8.0f MB/s\n",
+           crc_bench_crc16(crc16_bitwise, buf, block_size, count / 16 + 1, &sink16));
+    printf("  crc16_xmodem  %8.0f MB/s\n",
+           crc_bench_crc16(crc16_table, buf, block_size, count, &sink16));
+
+    printf("crc7 over %d byte commands\n", CRC_BENCH_CMD_LEN);
+    printf("  bitwise       %8.1f ns/command\n",
+           crc_bench_crc7(crc7_bitwise, cmd, CRC_BENCH_CMD_COUNT, &sink7));
+    printf("  crc7_sd       %8.1f ns/command\n",
+           crc_bench_crc7(crc7_table, cmd, CRC_BENCH_CMD_COUNT, &sink7));
+
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,745 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Daemon mode keeps a single initialised transport open and serves sub-commands received over a
+ * UNIX domain socket. Clients pass their stdout and stderr file descriptors along with the
+ * request (SCM_RIGHTS), so command output is written straight to the client's terminal and only
+ * the return code travels back over the socket. The socket is only accessible to the user running
+ * the daemon.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "morsectrl.h"
+
+#define DAEMON_MAGIC                (0x4d434c49)
+#define DAEMON_FLAG_DEBUG           (1 << 0)
+/** Maximum size of the argument strings of a request */
+#define DAEMON_MAX_ARGS_LEN         (4096)
+/** Maximum number of arguments of a request */
+#define DAEMON_MAX_ARGC             (128)
+/** Number of file descriptors passed with a request (stdout and stderr) */
+#define DAEMON_NUM_FDS              (2)
+/** Time a client has to send its whole request after connecting */
+#define DAEMON_REQUEST_TIMEOUT_MS   (500)
+/** Number of clients whose requests are received at once, others wait in the listen backlog */
+#define DAEMON_MAX_CLIENTS          (16)
+#define DAEMON_LISTEN_BACKLOG       (8)
+
+struct daemon_request_hdr
+{
+    uint32_t magic;
+    uint32_t flags;
+    /** Number of arguments, the first being the sub-command name */
+    uint32_t argc;
+    /** Length of the null separated argument strings following the header */
+    uint32_t len;
+};
+
+struct daemon_response
+{
+    uint32_t magic;
+    int32_t ret;
+};
+
+/** A connected client whose request is being received */
+struct daemon_client
+{
+    /** Connection to the client, -1 for a free slot */
+    int fd;
+    /** Client's stdout and stderr, -1 until received */
+    int fds[DAEMON_NUM_FDS];
+    struct daemon_request_hdr hdr;
+    /** Number of octets of hdr received */
+    size_t hdr_len;
+    /** Argument strings, allocated once the header has been received */
+    char *args;
+    /** Number of octets of args received */
+    size_t args_len;
+    /** Time by which the request must have been received, from time_monotonic_us() */
+    uint64_t deadline_us;
+};
+
+static volatile sig_atomic_t daemon_stop;
+
+static void daemon_signal_handler(int sig)
+{
+    daemon_stop = 1;
+}
+
+static int daemon_socket_addr(struct sockaddr_un *addr, const char *socket_path)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    if (strlen(socket_path) >= sizeof(addr->sun_path))
+    {
+        mctrl_err("Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(addr->sun_path, socket_path);
+
+    return 0;
+}
+
+static int daemon_recv_all(int fd, void *buf, size_t len)
+{
+    uint8_t *ptr = buf;
+
+    while (len)
+    {
+        ssize_t ret = recv(fd, ptr, len, 0);
+
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+
+        ptr += ret;
+        len -= ret;
+    }
+
+    return 0;
+}
+
+static int daemon_send_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *ptr = buf;
+
+    while (len)
+    {
+        ssize_t ret = send(fd, ptr, len, MSG_NOSIGNAL);
+
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+
+        ptr += ret;
+        len -= ret;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Close the descriptors passed in an SCM_RIGHTS control message that is not used.
+ */
+static void daemon_close_cmsg_fds(struct cmsghdr *cmsg)
+{
+    size_t n_fds;
+
+    if (cmsg->cmsg_len < CMSG_LEN(0))
+        return;
+
+    n_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+    for (size_t i = 0; i < n_fds; i++)
+    {
+        int cmsg_fd;
+
+        memcpy(&cmsg_fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(cmsg_fd));
+        close(cmsg_fd);
+    }
+}
+
+/**
+ * @brief Take the client's stdout/stderr descriptors from the control data of a read, closing any
+ *        descriptors that are not wanted.
+ *
+ * @return 0 on success, or -1 if the control data was truncated
+ */
+static int daemon_client_take_fds(struct daemon_client *client, struct msghdr *msg)
+{
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        /* Take the descriptors of the first well formed message, closing any others */
+        if (client->fds[0] < 0 && cmsg->cmsg_len == CMSG_LEN(sizeof(int) * DAEMON_NUM_FDS))
+            memcpy(client->fds, CMSG_DATA(cmsg), sizeof(int) * DAEMON_NUM_FDS);
+        else
+            daemon_close_cmsg_fds(cmsg);
+    }
+
+    if (msg->msg_flags & MSG_CTRUNC)
+    {
+        mctrl_err("Daemon request with truncated control data\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Read whatever has arrived of a client's request, without blocking.
+ *
+ * The header comes first, along with the client's stdout/stderr descriptors (SCM_RIGHTS), then
+ * the argument strings.
+ *
+ * @return 1 once the whole request has been received, 0 if more is to come, or -1 if the request
+ *         is invalid or the client went away
+ */
+static int daemon_client_recv(struct daemon_client *client)
+{
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * DAEMON_NUM_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov;
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+    };
+    ssize_t ret;
+
+    if (client->hdr_len < sizeof(client->hdr))
+    {
+        iov.iov_base = (uint8_t *)&client->hdr + client->hdr_len;
+        iov.iov_len = sizeof(client->hdr) - client->hdr_len;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        ret = recvmsg(client->fd, &msg, MSG_DONTWAIT);
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return 0;
+        if (ret <= 0)
+            return -1;
+
+        if (daemon_client_take_fds(client, &msg))
+            return -1;
+
+        client->hdr_len += ret;
+        if (client->hdr_len < sizeof(client->hdr))
+            return 0;
+
+        if ((client->hdr.magic != DAEMON_MAGIC) ||
+            (client->hdr.argc == 0) || (client->hdr.argc > DAEMON_MAX_ARGC) ||
+            (client->hdr.len == 0) || (client->hdr.len > DAEMON_MAX_ARGS_LEN))
+        {
+            mctrl_err("Invalid daemon request\n");
+            return -1;
+        }
+
+        if ((client->fds[0] < 0) || (client->fds[1] < 0))
+        {
+            mctrl_err("Daemon request without output descriptors\n");
+            return -1;
+        }
+
+        client->args = malloc(client->hdr.len + 1);
+        if (!client->args)
+            return -1;
+    }
+
+    ret = recv(client->fd, client->args + client->args_len, client->hdr.len - client->args_len,
+               MSG_DONTWAIT);
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+    if (ret <= 0)
+    {
+        mctrl_err("Incomplete daemon request\n");
+        return -1;
+    }
+
+    client->args_len += ret;
+    if (client->args_len < client->hdr.len)
+        return 0;
+
+    client->args[client->hdr.len] = '\0';
+
+    return 1;
+}
+
+/**
+ * @brief Run a sub-command with stdout and stderr redirected to the client's descriptors.
+ */
+static int daemon_run_redirected(struct morsectrl *mors, int out_fd, int err_fd,
+                                 int argc, char *argv[])
+{
+    int saved_out;
+    int saved_err;
+    int ret;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    saved_out = dup(STDOUT_FILENO);
+    saved_err = dup(STDERR_FILENO);
+    if ((saved_out < 0) || (saved_err < 0) ||
+        (dup2(out_fd, STDOUT_FILENO) < 0) || (dup2(err_fd, STDERR_FILENO) < 0))
+    {
+        mctrl_err("Failed to redirect output - errno %d\n", errno);
+        ret = MORSE_CMD_ERR;
+        goto exit;
+    }
+
+    ret = morsectrl_run_command(mors, argc, argv, false);
+
+    fflush(stdout);
+    fflush(stderr);
+
+exit:
+    if (saved_out >= 0)
+    {
+        dup2(saved_out, STDOUT_FILENO);
+        close(saved_out);
+    }
+    if (saved_err >= 0)
+    {
+        dup2(saved_err, STDERR_FILENO);
+        close(saved_err);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Mark a client slot as free.
+ */
+static void daemon_client_init(struct daemon_client *client)
+{
+    memset(client, 0, sizeof(*client));
+    client->fd = -1;
+    client->fds[0] = -1;
+    client->fds[1] = -1;
+}
+
+/**
+ * @brief Release everything held for a client and free its slot.
+ */
+static void daemon_client_close(struct daemon_client *client)
+{
+    for (int i = 0; i < DAEMON_NUM_FDS; i++)
+    {
+        if (client->fds[i] >= 0)
+            close(client->fds[i]);
+    }
+
+    free(client->args);
+    close(client->fd);
+
+    daemon_client_init(client);
+}
+
+/**
+ * @brief Send a request's return code to the client and close it.
+ */
+static void daemon_client_respond(struct daemon_client *client, int ret)
+{
+    struct daemon_response resp = {
+        .magic = DAEMON_MAGIC,
+        .ret = ret,
+    };
+
+    daemon_send_all(client->fd, &resp, sizeof(resp));
+    daemon_client_close(client);
+}
+
+/**
+ * @brief Run a client's request once it has all been received.
+ *
+ * @return 0 on success, or -1 if the transport could not be initialised again after the command
+ *         reset the chip, so that no more commands can be served
+ */
+static int daemon_client_run(struct morsectrl *mors, struct daemon_client *client)
+{
+    char *argv[DAEMON_MAX_ARGC + 1];
+    char *arg = client->args;
+    bool debug = mors->debug;
+    int ret;
+    int i;
+
+    for (i = 0; i < client->hdr.argc; i++)
+    {
+        if (arg >= client->args + client->hdr.len)
+        {
+            mctrl_err("Malformed daemon request\n");
+            daemon_client_respond(client, MORSE_ARG_ERR);
+            return 0;
+        }
+        argv[i] = arg;
+        arg += strlen(arg) + 1;
+    }
+    argv[i] = NULL;
+
+    if (client->hdr.flags & DAEMON_FLAG_DEBUG)
+        mors->debug = true;
+
+    ret = daemon_run_redirected(mors, client->fds[0], client->fds[1], client->hdr.argc, argv);
+
+    mors->debug = debug;
+
+    /* The transport's view of the chip is stale once it has been reset, as at the next start */
+    if (morsectrl_command_resets_chip(mors, argv[0]))
+    {
+        if (morsectrl_transport_reinit(mors->transport))
+        {
+            mctrl_err("Transport init failed after reset\n");
+            daemon_client_respond(client, ret ? ret : MORSE_CMD_ERR);
+            return -1;
+        }
+    }
+
+    daemon_client_respond(client, ret);
+
+    return 0;
+}
+
+/**
+ * @brief Check whether a daemon is listening on a socket.
+ *
+ * @return 0 if a daemon accepted the connection, otherwise the errno of the failed connect
+ */
+static int daemon_socket_probe(const struct sockaddr_un *addr)
+{
+    int fd;
+    int ret = 0;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return errno;
+
+    if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)))
+        ret = errno;
+
+    close(fd);
+    return ret;
+}
+
+int morsectrl_daemon_serve(struct morsectrl *mors, const char *socket_path)
+{
+    struct daemon_client clients[DAEMON_MAX_CLIENTS];
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    struct stat st;
+    int listen_fd;
+    int ret;
+    int i;
+
+    if (daemon_socket_addr(&addr, socket_path))
+        return MORSE_ARG_ERR;
+
+    /* Clean up a socket left behind by a previous instance, but not one still in use */
+    if (!lstat(socket_path, &st) && S_ISSOCK(st.st_mode))
+    {
+        ret = daemon_socket_probe(&addr);
+        if (ret == 0)
+        {
+            mctrl_err("A daemon is already running on %s\n", socket_path);
+            return MORSE_CMD_ERR;
+        }
+
+        if (ret != ECONNREFUSED && ret != ENOENT)
+        {
+            mctrl_err("Failed to check for a daemon on %s - errno %d\n", socket_path, ret);
+            return MORSE_CMD_ERR;
+        }
+
+        unlink(socket_path);
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        mctrl_err("Failed to create socket - errno %d\n", errno);
+        return MORSE_CMD_ERR;
+    }
+
+    /* Only the user running the daemon may connect, whatever the umask */
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        chmod(socket_path, S_IRUSR | S_IWUSR) ||
+        listen(listen_fd, DAEMON_LISTEN_BACKLOG))
+    {
+        mctrl_err("Failed to listen on %s - errno %d\n", socket_path, errno);
+        close(listen_fd);
+        unlink(socket_path);
+        return MORSE_CMD_ERR;
+    }
+
+    ret = morsectrl_transport_init(mors->transport);
+    if (ret)
+    {
+        mctrl_err("Transport init failed\n");
+        goto exit;
+    }
+
+    for (i = 0; i < DAEMON_MAX_CLIENTS; i++)
+        daemon_client_init(&clients[i]);
+
+    /* Interrupt poll() on termination rather than restarting it */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = daemon_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (mors->debug)
+        mctrl_print("Serving commands on %s\n", socket_path);
+
+    /*
+     * Requests are received from all connected clients at once, so one that is slow to send its
+     * request does not hold up the others, and are run one at a time as they complete.
+     */
+    while (!daemon_stop)
+    {
+        struct pollfd pfds[DAEMON_MAX_CLIENTS + 1];
+        uint64_t deadline_us = UINT64_MAX;
+        uint64_t now_us = time_monotonic_us();
+        int timeout_ms = -1;
+        int n_clients = 0;
+
+        for (i = 0; i < DAEMON_MAX_CLIENTS; i++)
+        {
+            pfds[i].fd = clients[i].fd;
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+
+            if (clients[i].fd < 0)
+                continue;
+
+            n_clients++;
+            deadline_us = MIN(deadline_us, clients[i].deadline_us);
+        }
+
+        /* Wake up in time to drop the first client to run out of time */
+        if (n_clients)
+            timeout_ms = (deadline_us > now_us) ? (deadline_us - now_us + 999) / 1000 : 0;
+
+        /* Leave new connections in the backlog while every slot is in use */
+        pfds[DAEMON_MAX_CLIENTS].fd = (n_clients < DAEMON_MAX_CLIENTS) ? listen_fd : -1;
+        pfds[DAEMON_MAX_CLIENTS].events = POLLIN;
+        pfds[DAEMON_MAX_CLIENTS].revents = 0;
+
+        if (poll(pfds, MORSE_ARRAY_SIZE(pfds), timeout_ms) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            mctrl_err("Failed to wait for clients - errno %d\n", errno);
+            ret = MORSE_CMD_ERR;
+            break;
+        }
+
+        for (i = 0; i < DAEMON_MAX_CLIENTS; i++)
+        {
+            struct daemon_client *client = &clients[i];
+
+            if (client->fd < 0)
+                continue;
+
+            if (pfds[i].revents)
+            {
+                int complete = daemon_client_recv(client);
+
+                if (complete < 0)
+                {
+                    daemon_client_respond(client, MORSE_ARG_ERR);
+                    continue;
+                }
+
+                if (complete > 0)
+                {
+                    if (daemon_client_run(mors, client))
+                    {
+                        ret = MORSE_CMD_ERR;
+                        goto close_clients;
+                    }
+                    continue;
+                }
+            }
+
+            if (time_monotonic_us() >= client->deadline_us)
+            {
+                mctrl_err("Timed out receiving daemon request\n");
+                daemon_client_respond(client, MORSE_ARG_ERR);
+            }
+        }
+
+        if (pfds[DAEMON_MAX_CLIENTS].revents)
+        {
+            int client_fd = accept(listen_fd, NULL, NULL);
+
+            if (client_fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN)
+                    continue;
+
+                mctrl_err("Failed to accept connection - errno %d\n", errno);
+                ret = MORSE_CMD_ERR;
+                break;
+            }
+
+            for (i = 0; i < DAEMON_MAX_CLIENTS; i++)
+            {
+                if (clients[i].fd < 0)
+                {
+                    clients[i].fd = client_fd;
+                    clients[i].deadline_us = time_monotonic_us() +
+                                             DAEMON_REQUEST_TIMEOUT_MS * 1000ULL;
+                    break;
+                }
+            }
+        }
+    }
+
+    morsectrl_transport_deinit(mors->transport);
+
+close_clients:
+    for (i = 0; i < DAEMON_MAX_CLIENTS; i++)
+    {
+        if (clients[i].fd >= 0)
+            daemon_client_close(&clients[i]);
+    }
+
+exit:
+    close(listen_fd);
+    unlink(socket_path);
+
+    return ret;
+}
+
+int morsectrl_daemon_forward(const char *socket_path, bool debug, int argc, char *argv[])
+{
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * DAEMON_NUM_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct daemon_request_hdr hdr = {
+        .magic = DAEMON_MAGIC,
+        .flags = debug ? DAEMON_FLAG_DEBUG : 0,
+        .argc = argc,
+    };
+    struct daemon_response resp;
+    struct sockaddr_un addr;
+    struct iovec iov[2];
+    struct msghdr msg = {
+        .msg_iov = iov,
+        .msg_iovlen = MORSE_ARRAY_SIZE(iov),
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+    struct cmsghdr *cmsg;
+    int fds[DAEMON_NUM_FDS] = { STDOUT_FILENO, STDERR_FILENO };
+    char args[DAEMON_MAX_ARGS_LEN];
+    size_t sent;
+    ssize_t len;
+    int fd;
+    int i;
+
+    if (argc > DAEMON_MAX_ARGC)
+    {
+        mctrl_err("Too many arguments\n");
+        return MORSE_ARG_ERR;
+    }
+
+    for (i = 0; i < argc; i++)
+    {
+        size_t arg_len = strlen(argv[i]) + 1;
+
+        if (hdr.len + arg_len > sizeof(args))
+        {
+            mctrl_err("Arguments too long\n");
+            return MORSE_ARG_ERR;
+        }
+        memcpy(args + hdr.len, argv[i], arg_len);
+        hdr.len += arg_len;
+    }
+
+    if (daemon_socket_addr(&addr, socket_path))
+        return MORSE_ARG_ERR;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        mctrl_err("Failed to create socket - errno %d\n", errno);
+        return MORSE_CMD_ERR;
+    }
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+    {
+        mctrl_err("Failed to connect to daemon at %s - errno %d\n", socket_path, errno);
+        close(fd);
+        return MORSE_CMD_ERR;
+    }
+
+    memset(&control, 0, sizeof(control));
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = args;
+    iov[1].iov_len = hdr.len;
+
+    /* Make sure anything we have buffered is printed ahead of the command's output */
+    fflush(stdout);
+    fflush(stderr);
+
+    do
+    {
+        len = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (len < 0 && errno == EINTR);
+
+    if (len < 0)
+    {
+        mctrl_err("Failed to send command to daemon - errno %d\n", errno);
+        close(fd);
+        return MORSE_CMD_ERR;
+    }
+
+    /* The descriptors went with the first chunk, send whatever remains */
+    sent = len;
+    if ((sent < sizeof(hdr) &&
+         daemon_send_all(fd, (uint8_t *)&hdr + sent, sizeof(hdr) - sent)) ||
+        daemon_send_all(fd, args + (sent > sizeof(hdr) ? sent - sizeof(hdr) : 0),
+                        hdr.len - (sent > sizeof(hdr) ? sent - sizeof(hdr) : 0)))
+    {
+        mctrl_err("Failed to send command to daemon\n");
+        close(fd);
+        return MORSE_CMD_ERR;
+    }
+
+    if (daemon_recv_all(fd, &resp, sizeof(resp)) || (resp.magic != DAEMON_MAGIC))
+    {
+        mctrl_err("No response from daemon\n");
+        close(fd);
+        return MORSE_CMD_ERR;
+    }
+
+    close(fd);
+
+    return resp.ret;
+}
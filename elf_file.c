@@ -29,9 +29,13 @@
 #include <sys/stat.h>
 #include <libgen.h>
 #include <errno.h>
+#ifndef MORSE_WIN_BUILD
+#include <sys/mman.h>
+#endif
 
 #include "portable_endian.h"
 #include "elf_file.h"
+#include "stats_cache.h"
 #include "utilities.h"
 
 #define HOST_FLASH_BASE_MASK        (0xFFFF0000)
@@ -48,6 +52,83 @@ static struct
     struct arg_rex *country;
 } args;
 
+/** A read-only view of a whole ELF file */
+struct elf_file_view
+{
+    /** Contents of the file */
+    const uint8_t *data;
+    /** Size of the file */
+    size_t size;
+    /** Whether data is a mapping of the file, rather than a copy read into memory */
+    bool mapped;
+};
+
+/**
+ * @brief Open a view of an ELF file.
+ *
+ * The file is mapped where supported, so headers, string tables and sections are referenced in
+ * place without reading the whole file into memory. Otherwise the file is read into memory.
+ *
+ * @param infile    The ELF file.
+ * @param view      View to initialise, to be closed with elf_file_view_close().
+ * @return          0 on success otherwise relevant error.
+ */
+static int elf_file_view_open(FILE *infile, struct elf_file_view *view)
+{
+    struct stat file_stats;
+    uint8_t *buf;
+
+    memset(view, 0, sizeof(*view));
+
+    if (fstat(fileno(infile), &file_stats) != 0 || file_stats.st_size <= 0)
+        return -ENOENT;
+
+    view->size = file_stats.st_size;
+
+#ifndef MORSE_WIN_BUILD
+    {
+        void *map = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fileno(infile), 0);
+
+        if (map != MAP_FAILED)
+        {
+            view->data = map;
+            view->mapped = true;
+            return 0;
+        }
+    }
+#endif
+
+    load_file(infile, &buf);
+    if (!buf)
+        return -ENOENT;
+
+    view->data = buf;
+    return 0;
+}
+
+/**
+ * @brief Close a view opened by elf_file_view_open().
+ */
+static void elf_file_view_close(struct elf_file_view *view)
+{
+#ifndef MORSE_WIN_BUILD
+    if (view->mapped)
+        munmap((void *)view->data, view->size);
+    else
+#endif
+        free((void *)view->data);
+
+    memset(view, 0, sizeof(*view));
+}
+
+/**
+ * @brief Check that a region lies within the file.
+ */
+static inline bool elf_file_in_bounds(size_t file_size, size_t offset, size_t len)
+{
+    return offset <= file_size && len <= file_size - offset;
+}
+
 /**
  * @brief Get the ELF32 file header
  *
@@ -80,6 +161,7 @@ static int get_file_header(const uint8_t *data, Elf32_Ehdr *ehdr)
 
     memcpy(ehdr->e_ident, p->e_ident, sizeof(ehdr->e_ident));
 
+    ehdr->e_machine = le16toh(p->e_machine);
     ehdr->e_phoff     = le32toh(p->e_phoff);
     ehdr->e_phentsize = le16toh(p->e_phentsize);
     ehdr->e_phnum     = le16toh(p->e_phnum);
@@ -95,10 +177,16 @@ static int get_file_header(const uint8_t *data, Elf32_Ehdr *ehdr)
 /*
 * Get the ii-th section header and fill in the details in shdr
 */
-static int get_section_header(const uint8_t *data, const Elf32_Ehdr *ehdr, Elf32_Shdr *shdr, int ii)
+static int get_section_header(const uint8_t *data, size_t size, const Elf32_Ehdr *ehdr,
+                              Elf32_Shdr *shdr, int ii)
 {
-    Elf32_Shdr *p = (Elf32_Shdr *)(data + ehdr->e_shoff +
-                       (ii * ehdr->e_shentsize));
+    size_t offset = ehdr->e_shoff + ((size_t)ii * ehdr->e_shentsize);
+    Elf32_Shdr *p;
+
+    if (ehdr->e_shentsize < sizeof(*p) || !elf_file_in_bounds(size, offset, sizeof(*p)))
+        return -ENXIO;
+
+    p = (Elf32_Shdr *)(data + offset);
 
     shdr->sh_name = le32toh(p->sh_name);
     shdr->sh_type = le32toh(p->sh_type);
@@ -201,6 +289,7 @@ static Elf32_Phdr *elf_file_load_program_headers(FILE *infile, Elf32_Off offset,
         phdr[ii].p_paddr = le32toh(phdr[ii].p_paddr);
         phdr[ii].p_filesz = le32toh(phdr[ii].p_filesz);
         phdr[ii].p_memsz = le32toh(phdr[ii].p_memsz);
+        phdr[ii].p_flags = le32toh(phdr[ii].p_flags);
         phdr[ii].p_align = le32toh(phdr[ii].p_align);
     }
 
@@ -267,72 +356,128 @@ static int load_file_header(FILE *infile, Elf32_Ehdr *ehdr)
     return 0;
 }
 
+/**
+ * @brief Fix up the formats of the statistics metadata once at load time, so that decoding can
+ *        treat the metadata as read only.
+ *
+ * @param stats     Statistics metadata
+ * @param n_rec     Number of records in the metadata
+ */
+static void morse_stats_normalise(struct statistics_offchip_data *stats, size_t n_rec)
+{
+    size_t ii;
+
+    for (ii = 0; ii < n_rec; ii++)
+    {
+        if ((stats[ii].format == MORSE_STATS_FMT_DEC) &&
+            !strncmp(stats[ii].type_str, "uint", 4))
+        {
+            stats[ii].format = MORSE_STATS_FMT_U_DEC;
+        }
+
+        if (stats[ii].format > MORSE_STATS_FMT_LAST)
+        {
+            stats[ii].format = MORSE_STATS_FMT_LAST;
+        }
+    }
+}
+
+/**
+ * @brief Get the section name string table of an ELF file, checking it lies within the file and
+ *        is terminated.
+ *
+ * @return The string table, or NULL if it is missing or invalid.
+ */
+static const char *get_section_strings(const uint8_t *data, size_t size, const Elf32_Ehdr *ehdr,
+                                       size_t *strs_size)
+{
+    Elf32_Shdr sh_strtab;
+
+    if (get_section_header(data, size, ehdr, &sh_strtab, ehdr->e_shstrndx) != 0 ||
+        sh_strtab.sh_size == 0 ||
+        !elf_file_in_bounds(size, sh_strtab.sh_offset, sh_strtab.sh_size) ||
+        data[sh_strtab.sh_offset + sh_strtab.sh_size - 1] != '\0')
+        return NULL;
+
+    *strs_size = sh_strtab.sh_size;
+    return (const char *)data + sh_strtab.sh_offset;
+}
+
+/**
+ * @brief Check whether a section holds offchip statistics metadata, returning the number of
+ *        whole records it holds.
+ */
+static size_t offchip_section_records(const uint8_t *data, size_t size, const Elf32_Shdr *shdr,
+                                      const char *sh_strs, size_t strs_size)
+{
+    if (shdr->sh_name >= strs_size || !strstr(sh_strs + shdr->sh_name, "_offchip_") ||
+        !elf_file_in_bounds(size, shdr->sh_offset, shdr->sh_size))
+        return 0;
+
+    return shdr->sh_size / sizeof(struct statistics_offchip_data);
+}
+
 /*
- * Load the offchip statistics from an ELF data structure.
+ * Load the offchip statistics from an ELF file of the given size in memory.
  *
  * An array of n_rec struct statistics_offchip_data elements is allocated in the stats_handle.
  * It is the caller's responsibility to free the array.
  */
 int morse_stats_load(struct statistics_offchip_data **stats_handle, size_t *n_rec,
-                     const uint8_t *data)
+                     const uint8_t *data, size_t size)
 {
     int ii;
-    int ret = 0;
     Elf32_Ehdr ehdr;
     Elf32_Shdr shdr;
-    Elf32_Shdr sh_strtab;
     const char *sh_strs;
+    size_t strs_size;
+    size_t total_recs = 0;
+    struct statistics_offchip_data *blob;
+
+    *stats_handle = NULL;
+    *n_rec = 0;
 
-    if (get_file_header((const uint8_t *)data, &ehdr) != 0) {
+    if (size < sizeof(ehdr) || get_file_header(data, &ehdr) != 0) {
         mctrl_err("Wrong file format\n");
         return -ENOENT;
     }
 
-    if (get_section_header(data, &ehdr, &sh_strtab, ehdr.e_shstrndx) != 0) {
+    sh_strs = get_section_strings(data, size, &ehdr, &strs_size);
+    if (!sh_strs) {
         mctrl_err("Invalid firmware - missing string table\n");
         return -ENXIO;
     }
 
-    sh_strs = (const char *)data + sh_strtab.sh_offset;
-
-    /* first run through the ELF file to get the total size of the stats */
-    size_t total_stats_size = 0;
+    /* First run through the section headers to get the total number of records... */
     for (ii = 0; ii < ehdr.e_shnum; ii++)
     {
-        if (get_section_header(data, &ehdr, &shdr, ii) != 0)
+        if (get_section_header(data, size, &ehdr, &shdr, ii) != 0)
             continue;
 
-        if (strstr(sh_strs + shdr.sh_name, "_offchip_"))
-        {
-            total_stats_size += shdr.sh_size;
-        }
+        total_recs += offchip_section_records(data, size, &shdr, sh_strs, strs_size);
     }
-    void *blob = malloc(total_stats_size);
-    memset(blob, 0, total_stats_size);
-    *n_rec = 0;
-    if (blob)
-    {
-        int offset = 0;
-        for (ii = 0; ii < ehdr.e_shnum; ii++)
-        {
-            if (get_section_header(data, &ehdr, &shdr, ii) != 0)
-                continue;
 
-            if (strstr(sh_strs + shdr.sh_name, "_offchip_"))
-            {
-                memcpy(blob + offset, data + shdr.sh_offset, shdr.sh_size);
-                offset += shdr.sh_size;
-                *n_rec += shdr.sh_size / sizeof(struct statistics_offchip_data);
-            }
-        }
-        *stats_handle = blob;
-    }
-    else
+    blob = calloc(total_recs + 1, sizeof(*blob));
+    if (!blob)
+        return -ENXIO;
+
+    /* ...then copy them out of the file in place into a single table */
+    for (ii = 0; ii < ehdr.e_shnum; ii++)
     {
-        *stats_handle = 0;
-        ret = -ENXIO;
+        size_t recs;
+
+        if (get_section_header(data, size, &ehdr, &shdr, ii) != 0)
+            continue;
+
+        recs = offchip_section_records(data, size, &shdr, sh_strs, strs_size);
+        memcpy(blob + *n_rec, data + shdr.sh_offset, recs * sizeof(*blob));
+        *n_rec += recs;
     }
-    return ret;
+
+    *stats_handle = blob;
+    morse_stats_normalise(*stats_handle, *n_rec);
+
+    return 0;
 }
 
 static void print_ehdr(Elf32_Ehdr *ehdr)
@@ -381,6 +526,61 @@ void print_shdr(Elf32_Shdr *shdr)
     mctrl_print("\tsh_entsize:   0x%08x\n", shdr->sh_entsize);
 }
 
+void morse_stats_free(struct morsectrl *mors)
+{
+    morse_stats_index_free(mors);
+
+    if (!morse_stats_cache_unmap(mors))
+        free(mors->stats);
+
+    mors->stats = NULL;
+    mors->n_stats = 0;
+}
+
+int morse_stats_load_file(struct morsectrl *mors, const char *filename)
+{
+    FILE *infile;
+    struct elf_file_view view;
+    struct stat st;
+    bool have_stat;
+    int ret;
+
+    infile = fopen(filename, "rb");
+    if (!infile)
+    {
+        mctrl_err("Error - could not open %s to read stats metadata\n", filename);
+        return -ENOENT;
+    }
+
+    /* Taken before reading so that the cache can never describe a newer file than was read */
+    have_stat = (fstat(fileno(infile), &st) == 0);
+    if (have_stat && morse_stats_cache_load(mors, filename, &st) == 0)
+    {
+        fclose(infile);
+        morse_stats_index_build(mors);
+        return 0;
+    }
+
+    ret = elf_file_view_open(infile, &view);
+    fclose(infile);
+    if (ret)
+        return -ENOENT;
+
+    /* Metadata may be left over from a previous load */
+    morse_stats_free(mors);
+
+    ret = morse_stats_load(&mors->stats, &mors->n_stats, view.data, view.size);
+    elf_file_view_close(&view);
+
+    if (!ret)
+        morse_stats_index_build(mors);
+
+    if (!ret && have_stat)
+        morse_stats_cache_store(mors, filename, &st);
+
+    return ret;
+}
+
 int load_elf_blob(FILE *firmware, struct morsectrl_transport *transport,
     int idx, Elf32_Off offset, Elf32_Word size, Elf32_Addr addr)
 {
@@ -429,29 +629,27 @@ static int load_bcf_sections(struct morsectrl *mors, FILE *firmware, Elf32_Ehdr
     Elf32_Off sh_offset[LOAD_BCF_SECTION_TOT] = { 0 };
     Elf32_Word sh_size[LOAD_BCF_SECTION_TOT] = { 0 };
     Elf32_Addr addr = 0;
-    Elf32_Shdr sh_strtab;
+    struct elf_file_view view;
     const char *sh_strs;
-    uint8_t *data;
+    size_t strs_size;
     int ii;
     int ret = 0;
 
     mctrl_print("Trying to load BCF file using country %s\n", country);
 
-    load_file(firmware, &data);
-    if (data == NULL)
+    if (elf_file_view_open(firmware, &view))
     {
         mctrl_err("Load file failed\n");
         return -ENOENT;
     }
 
-    if (get_section_header(data, ehdr, &sh_strtab, ehdr->e_shstrndx) != 0) {
+    sh_strs = get_section_strings(view.data, view.size, ehdr, &strs_size);
+    if (!sh_strs) {
         mctrl_err("Invalid firmware - missing string table\n");
         ret = -ENXIO;
         goto exit;
     }
 
-    sh_strs = (const char *)data + sh_strtab.sh_offset;
-
     /* Sanitise the loop bound with a reasonable number for the section headers */
     if (ehdr->e_shnum > MAX_NUM_SECTION_HEADERS)
     {
@@ -465,7 +663,8 @@ static int load_bcf_sections(struct morsectrl *mors, FILE *firmware, Elf32_Ehdr
     {
         Elf32_Shdr shdr;
 
-        if (get_section_header(data, ehdr, &shdr, ii) != 0)
+        if (get_section_header(view.data, view.size, ehdr, &shdr, ii) != 0 ||
+            shdr.sh_name >= strs_size)
             continue;
 
         if (strcmp(sh_strs + shdr.sh_name, ".board_config") == 0)
@@ -520,7 +719,78 @@ static int load_bcf_sections(struct morsectrl *mors, FILE *firmware, Elf32_Ehdr
     }
 
 exit:
-    free(data);
+    elf_file_view_close(&view);
+    return ret;
+}
+
+/**
+ * @brief Check whether a program header describes a blob to load into chip memory.
+ *
+ * @param phdr  The program header.
+ * @return      true if the blob is loaded, false if it is empty, unloadable or in external flash.
+ */
+static bool elf_file_phdr_is_loadable(const Elf32_Phdr *phdr)
+{
+    return (phdr->p_type == PT_LOAD) &&
+           (phdr->p_memsz != 0) &&
+           (phdr->p_flags & (PF_X | PF_W | PF_R)) &&
+           ((phdr->p_paddr & HOST_FLASH_BASE_MASK) != HOST_IFLASH_BASE_ADDR) &&
+           ((phdr->p_paddr & HOST_FLASH_BASE_MASK) != HOST_DFLASH_BASE_ADDR);
+}
+
+int elf_file_get_load_regions(const char *filename, struct elf_file_region **regions,
+                              size_t *n_regions, uint16_t *machine)
+{
+    struct elf_file_region *result = NULL;
+    Elf32_Phdr *phdr = NULL;
+    Elf32_Ehdr ehdr;
+    FILE *infile;
+    size_t n = 0;
+    int ret = 0;
+
+    infile = fopen(filename, "rb");
+    if (!infile)
+        return -ENOENT;
+
+    if (load_file_header(infile, &ehdr))
+    {
+        ret = -ENXIO;
+        goto exit;
+    }
+
+    if (ehdr.e_phnum)
+    {
+        phdr = elf_file_load_program_headers(infile, ehdr.e_phoff, ehdr.e_phnum);
+        result = calloc(ehdr.e_phnum, sizeof(*result));
+        if (!phdr || !result)
+        {
+            ret = -ENXIO;
+            goto exit;
+        }
+    }
+
+    for (int ii = 0; ii < ehdr.e_phnum; ii++)
+    {
+        if (!elf_file_phdr_is_loadable(&phdr[ii]))
+            continue;
+
+        result[n].addr = phdr[ii].p_paddr;
+        result[n].size = align_size(phdr[ii].p_memsz, sizeof(uint32_t));
+        result[n].flags = phdr[ii].p_flags;
+        n++;
+    }
+
+    if (machine)
+        *machine = ehdr.e_machine;
+
+    *regions = result;
+    *n_regions = n;
+    result = NULL;
+
+exit:
+    free(result);
+    free(phdr);
+    fclose(infile);
     return ret;
 }
 
@@ -548,11 +818,7 @@ static int load_blobs(struct morsectrl *mors, FILE *firmware, Elf32_Ehdr *ehdr)
             print_phdr(&phdr[ii]);
 
         /* Skip empty or unloadable blobs. Filter out external flash. */
-        if ((phdr[ii].p_type != PT_LOAD) ||
-            (phdr[ii].p_memsz == 0) ||
-            !(phdr[ii].p_flags & (PF_X | PF_W | PF_R)) ||
-            ((phdr[ii].p_paddr & HOST_FLASH_BASE_MASK) == HOST_IFLASH_BASE_ADDR) ||
-            ((phdr[ii].p_paddr & HOST_FLASH_BASE_MASK) == HOST_DFLASH_BASE_ADDR))
+        if (!elf_file_phdr_is_loadable(&phdr[ii]))
         {
             mctrl_print("Loading ELF blob %d - unloadable, skipping\n", ii);
             continue;
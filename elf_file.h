@@ -26,6 +26,53 @@
 
 int morse_stats_load(struct statistics_offchip_data **stats_handle,
                      size_t *n_rec,
-                     const uint8_t *data);
+                     const uint8_t *data,
+                     size_t size);
+
+/**
+ * @brief Load the statistics metadata from a firmware file into the morsectrl context, replacing
+ *        any metadata loaded previously.
+ *
+ * The metadata is taken from the statistics metadata cache when it is valid for the file, and
+ * written to the cache otherwise (see stats_cache.h).
+ *
+ * @param mors      Morsectrl context
+ * @param filename  Path to the firmware ELF file
+ *
+ * @return          0 on success otherwise a negative error code
+ */
+int morse_stats_load_file(struct morsectrl *mors, const char *filename);
+
+/**
+ * @brief Free the statistics metadata of the morsectrl context, however it was loaded.
+ *
+ * @param mors      Morsectrl context
+ */
+void morse_stats_free(struct morsectrl *mors);
+
+/** A region of chip memory that a firmware ELF file is loaded into */
+struct elf_file_region
+{
+    /** Chip address of the region */
+    uint32_t addr;
+    /** Size of the region in octets, word aligned */
+    uint32_t size;
+    /** ELF segment flags of the region (PF_*) */
+    uint32_t flags;
+};
+
+/**
+ * @brief Get the regions of chip memory that a firmware ELF file is loaded into, i.e. the same
+ *        regions that load_elf writes.
+ *
+ * @param filename      Path to the firmware ELF file
+ * @param[out] regions  Dynamically allocated array of regions, to be freed with free()
+ * @param[out] n_regions Number of entries in regions
+ * @param[out] machine  ELF machine of the firmware, may be NULL
+ *
+ * @return              0 on success otherwise a negative error code
+ */
+int elf_file_get_load_regions(const char *filename, struct elf_file_region **regions,
+                              size_t *n_regions, uint16_t *machine);
 
 int load_elf(struct morsectrl *mors, int argc, char *argv[]);
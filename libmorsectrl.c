@@ -0,0 +1,280 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmorsectrl.h"
+#include "morsectrl.h"
+#include "command.h"
+#include "elf_file.h"
+#include "offchip_statistics.h"
+#include "stats_format.h"
+
+static const int stats_core_commands[] = {
+    [MORSECTRL_STATS_CORE_APP] = MORSE_COMMAND_APP_STATS_LOG,
+    [MORSECTRL_STATS_CORE_MAC] = MORSE_COMMAND_MAC_STATS_LOG,
+    [MORSECTRL_STATS_CORE_UPHY] = MORSE_COMMAND_UPHY_STATS_LOG,
+};
+
+struct morsectrl *morsectrl_open(const char *trans_opts, const char *iface_opts,
+                                 const char *cfg_opts, bool debug, int *error)
+{
+    struct morsectrl *mors;
+    int ret;
+
+    mors = calloc(1, sizeof(*mors));
+    if (!mors)
+    {
+        ret = -ETRANSNOMEM;
+        goto exit;
+    }
+    mors->debug = debug;
+
+    ret = morsectrl_transport_parse(&mors->transport, debug, trans_opts, iface_opts, cfg_opts);
+    if (ret)
+        goto exit;
+
+    ret = morsectrl_transport_init(mors->transport);
+
+exit:
+    if (ret && mors)
+    {
+        morsectrl_transport_free(mors->transport);
+        free(mors);
+        mors = NULL;
+    }
+
+    if (error)
+        *error = ret;
+
+    return mors;
+}
+
+void morsectrl_close(struct morsectrl *mors)
+{
+    if (!mors)
+        return;
+
+    morsectrl_transport_deinit(mors->transport);
+    morsectrl_transport_free(mors->transport);
+    morse_stats_free(mors);
+    free(mors);
+}
+
+struct morsectrl_transport *morsectrl_get_transport(struct morsectrl *mors)
+{
+    return mors->transport;
+}
+
+int morsectrl_command(struct morsectrl *mors, uint16_t message_id,
+                      const void *cmd, size_t cmd_len, void *resp, size_t *resp_len)
+{
+    struct morsectrl_transport_buff *cmd_tbuff;
+    struct morsectrl_transport_buff *rsp_tbuff;
+    size_t resp_size = (resp && resp_len) ? *resp_len : 0;
+    int ret;
+
+    cmd_tbuff = morsectrl_transport_cmd_alloc(mors->transport, cmd_len);
+    rsp_tbuff = morsectrl_transport_resp_alloc(mors->transport, resp_size);
+
+    if (!cmd_tbuff || !rsp_tbuff)
+    {
+        ret = -ETRANSNOMEM;
+        goto exit;
+    }
+
+    if (cmd_len)
+        memcpy(((struct command *)cmd_tbuff->data)->data, cmd, cmd_len);
+
+    ret = morsectrl_send_command(mors->transport, message_id, cmd_tbuff, rsp_tbuff);
+
+    if (!ret && resp_size)
+    {
+        size_t len = 0;
+
+        if (rsp_tbuff->data_len > sizeof(struct response))
+            len = MIN(rsp_tbuff->data_len - sizeof(struct response), resp_size);
+
+        memcpy(resp, ((struct response *)rsp_tbuff->data)->data, len);
+        *resp_len = len;
+    }
+
+exit:
+    morsectrl_transport_buff_free(cmd_tbuff);
+    morsectrl_transport_buff_free(rsp_tbuff);
+    return ret;
+}
+
+int morsectrl_stats_load_metadata(struct morsectrl *mors, const char *firmware_path)
+{
+    return morse_stats_load_file(mors, firmware_path);
+}
+
+static void stats_add_stat(void *arg, stats_tlv_tag_t tag,
+                           const struct statistics_offchip_data *offchip,
+                           const uint8_t *buf, uint32_t len)
+{
+    struct morsectrl_stats *stats = arg;
+    struct morsectrl_stat *stat = &stats->stats[stats->n_stats++];
+
+    stat->tag = tag;
+    stat->key = offchip ? offchip->key : NULL;
+    stat->name = offchip ? offchip->name : NULL;
+    stat->type = offchip ? offchip->type_str : NULL;
+    stat->format = offchip ? (int)offchip->format : -1;
+    stat->value = buf;
+    stat->len = len;
+}
+
+/**
+ * @brief Send the stats command of a core.
+ *
+ * @param mors          Handle
+ * @param core          Core to read statistics from
+ * @param reset         Reset the statistics instead of reading them
+ * @param[out] rsp      The response, to be freed with morsectrl_transport_buff_free(). Set even
+ *                      on failure.
+ *
+ * @return              0 on success, otherwise the transport error or firmware status
+ */
+static int stats_send(struct morsectrl *mors, enum morsectrl_stats_core core, bool reset,
+                      struct morsectrl_transport_buff **rsp)
+{
+    struct morsectrl_transport_buff *cmd_tbuff;
+    int cmd;
+    int ret;
+
+    *rsp = NULL;
+
+    if (core >= MORSE_ARRAY_SIZE(stats_core_commands))
+        return -ETRANSERR;
+
+    cmd = stats_core_commands[core];
+    if (reset)
+        cmd += 1;
+
+    cmd_tbuff = morsectrl_transport_cmd_alloc(mors->transport, 0);
+    *rsp = morsectrl_transport_resp_alloc(mors->transport, sizeof(struct stats_response));
+
+    if (!cmd_tbuff || !*rsp)
+        ret = -ETRANSNOMEM;
+    else
+        ret = morsectrl_send_command(mors->transport, cmd, cmd_tbuff, *rsp);
+
+    morsectrl_transport_buff_free(cmd_tbuff);
+    return ret;
+}
+
+int morsectrl_stats_read(struct morsectrl *mors, enum morsectrl_stats_core core, bool reset,
+                         struct morsectrl_stats **stats)
+{
+    struct morsectrl_transport_buff *rsp_tbuff;
+    struct morsectrl_stats *result = NULL;
+    int ret;
+
+    *stats = NULL;
+
+    ret = stats_send(mors, core, reset, &rsp_tbuff);
+    if (ret || reset)
+        goto exit;
+
+    result = calloc(1, sizeof(*result));
+    if (!result)
+    {
+        ret = -ETRANSNOMEM;
+        goto exit;
+    }
+
+    if (rsp_tbuff->data_len > sizeof(struct response))
+        result->raw_len = rsp_tbuff->data_len - sizeof(struct response);
+
+    /* Every TLV has a value of at least one byte, which bounds the number of statistics */
+    result->raw = malloc(result->raw_len + 1);
+    result->stats = calloc(result->raw_len / (STATS_TLV_OVERHEAD + 1) + 1,
+                           sizeof(*result->stats));
+    if (!result->raw || !result->stats)
+    {
+        ret = -ETRANSNOMEM;
+        goto exit;
+    }
+
+    memcpy(result->raw, ((struct response *)rsp_tbuff->data)->data, result->raw_len);
+
+    if (morse_stats_decode(mors, result->raw, result->raw_len, stats_add_stat, result))
+    {
+        ret = -ETRANSERR;
+        goto exit;
+    }
+
+    *stats = result;
+    result = NULL;
+
+exit:
+    morsectrl_stats_free(result);
+    morsectrl_transport_buff_free(rsp_tbuff);
+    return ret;
+}
+
+uint64_t morsectrl_stats_schema_id(struct morsectrl *mors)
+{
+    return morse_stats_schema_id(mors);
+}
+
+int morsectrl_stats_write_binary(struct morsectrl *mors, enum morsectrl_stats_core core, FILE *out)
+{
+    struct morsectrl_transport_buff *rsp_tbuff;
+    size_t len = 0;
+    int ret;
+
+    ret = stats_send(mors, core, false, &rsp_tbuff);
+    if (ret)
+        goto exit;
+
+    if (rsp_tbuff->data_len > sizeof(struct response))
+        len = rsp_tbuff->data_len - sizeof(struct response);
+
+    ret = stats_format_binary_write(out, core, time_realtime_us(), morse_stats_schema_id(mors),
+                                    ((struct response *)rsp_tbuff->data)->data, len);
+
+exit:
+    morsectrl_transport_buff_free(rsp_tbuff);
+    return ret;
+}
+
+void morsectrl_stats_free(struct morsectrl_stats *stats)
+{
+    if (!stats)
+        return;
+
+    free(stats->stats);
+    free(stats->raw);
+    free(stats);
+}
+
+int64_t morsectrl_stat_as_int64(const struct morsectrl_stat *stat)
+{
+    return get_signed_value_as_int64(stat->value, stat->len);
+}
+
+uint64_t morsectrl_stat_as_uint64(const struct morsectrl_stat *stat)
+{
+    return get_unsigned_value_as_uint64(stat->value, stat->len);
+}
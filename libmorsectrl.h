@@ -0,0 +1,204 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Public API of libmorsectrl.
+ *
+ * Each handle returned by morsectrl_open() owns its own transport and statistics metadata, and
+ * the library keeps no global state of its own, so separate handles may be used concurrently from
+ * different threads. A single handle must not be used from more than one thread at a time.
+ *
+ * Lower level access is available by passing the transport returned by morsectrl_get_transport()
+ * to the functions declared in command.h and transport/transport.h, e.g. morsectrl_send_command().
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct morsectrl;
+struct morsectrl_transport;
+
+/** Cores that statistics can be read from */
+enum morsectrl_stats_core
+{
+    MORSECTRL_STATS_CORE_APP,
+    MORSECTRL_STATS_CORE_MAC,
+    MORSECTRL_STATS_CORE_UPHY,
+};
+
+/** A single decoded statistic */
+struct morsectrl_stat
+{
+    /** Tag identifying the statistic */
+    uint16_t tag;
+    /** Key of the statistic from the firmware metadata, NULL if the tag is unknown */
+    const char *key;
+    /** Human readable name of the statistic, NULL if the tag is unknown */
+    const char *name;
+    /** Firmware type of the statistic, NULL if the tag is unknown */
+    const char *type;
+    /** Format of the value (enum morse_statistics_format), -1 if the tag is unknown */
+    int format;
+    /** Raw little endian value of the statistic */
+    const uint8_t *value;
+    /** Length of the value in bytes */
+    uint32_t len;
+};
+
+/** A set of statistics read from one core */
+struct morsectrl_stats
+{
+    /** Number of entries in stats */
+    size_t n_stats;
+    /** The decoded statistics */
+    struct morsectrl_stat *stats;
+    /** Raw stats response the values point into */
+    uint8_t *raw;
+    /** Length of the raw stats response */
+    size_t raw_len;
+};
+
+/**
+ * @brief Open and initialise a transport.
+ *
+ * @param trans_opts    Transport name (e.g. "nl80211"), NULL for the default transport
+ * @param iface_opts    Interface for the transport, NULL for the default
+ * @param cfg_opts      Transport configuration string, may be NULL
+ * @param debug         Whether to print debug messages
+ * @param[out] error    Set to the error code on failure, may be NULL
+ *
+ * @return              A new handle, or NULL on failure
+ */
+struct morsectrl *morsectrl_open(const char *trans_opts, const char *iface_opts,
+                                 const char *cfg_opts, bool debug, int *error);
+
+/**
+ * @brief Deinitialise the transport and free a handle along with any loaded metadata.
+ *
+ * @param mors  Handle returned by morsectrl_open(), may be NULL
+ */
+void morsectrl_close(struct morsectrl *mors);
+
+/**
+ * @brief Get the transport of a handle, for use with the lower level command and transport APIs.
+ *
+ * @param mors  Handle returned by morsectrl_open()
+ *
+ * @return      The transport
+ */
+struct morsectrl_transport *morsectrl_get_transport(struct morsectrl *mors);
+
+/**
+ * @brief Send a command and wait for its response.
+ *
+ * @param mors          Handle returned by morsectrl_open()
+ * @param message_id    Command message ID (enum morse_commands_id)
+ * @param cmd           Command payload, excluding the command header, may be NULL if cmd_len is 0
+ * @param cmd_len       Length of the command payload
+ * @param resp          Buffer for the response payload, excluding the response header, may be
+ *                      NULL if no payload is expected
+ * @param[in,out] resp_len  Size of resp on input, length of the received payload on output. May
+ *                          be NULL if resp is NULL.
+ *
+ * @return              0 on success, otherwise the transport error or firmware status
+ */
+int morsectrl_command(struct morsectrl *mors, uint16_t message_id,
+                      const void *cmd, size_t cmd_len, void *resp, size_t *resp_len);
+
+/**
+ * @brief Load the statistics metadata used to decode statistics from a firmware ELF file.
+ *
+ * @param mors          Handle returned by morsectrl_open()
+ * @param firmware_path Path to the firmware ELF file running on the chip
+ *
+ * @return              0 on success otherwise a negative error code
+ */
+int morsectrl_stats_load_metadata(struct morsectrl *mors, const char *firmware_path);
+
+/**
+ * @brief Read (and optionally reset) the statistics of a core.
+ *
+ * Statistics are decoded using the metadata loaded by morsectrl_stats_load_metadata(). Statistics
+ * whose tag is not found in the metadata are still returned, with a NULL key.
+ *
+ * @param mors          Handle returned by morsectrl_open()
+ * @param core          Core to read statistics from
+ * @param reset         Reset the statistics instead of reading them; no statistics are returned
+ * @param[out] stats    Decoded statistics, to be freed with morsectrl_stats_free()
+ *
+ * @return              0 on success, otherwise the transport error or firmware status, or
+ *                      a negative error code if the statistics are malformed
+ */
+int morsectrl_stats_read(struct morsectrl *mors, enum morsectrl_stats_core core, bool reset,
+                         struct morsectrl_stats **stats);
+
+/**
+ * @brief Get the schema id of the loaded statistics metadata.
+ *
+ * Binary statistics records can be decoded with any metadata that has the same schema id.
+ *
+ * @param mors  Handle returned by morsectrl_open()
+ *
+ * @return      The schema id
+ */
+uint64_t morsectrl_stats_schema_id(struct morsectrl *mors);
+
+/**
+ * @brief Read the statistics of a core and write them undecoded as a binary record.
+ *
+ * The record is a struct stats_binary_record (see stats_format.h) followed by the raw TLV payload,
+ * which is much cheaper than decoding the statistics when they are to be stored or forwarded.
+ *
+ * @param mors  Handle returned by morsectrl_open(), with metadata loaded by
+ *              morsectrl_stats_load_metadata()
+ * @param core  Core to read statistics from
+ * @param out   Stream to write the record to, which must be in binary mode
+ *
+ * @return      0 on success, -1 if the record could not be written, otherwise the transport error
+ *              or firmware status
+ */
+int morsectrl_stats_write_binary(struct morsectrl *mors, enum morsectrl_stats_core core, FILE *out);
+
+/**
+ * @brief Free statistics returned by morsectrl_stats_read().
+ *
+ * @param stats Statistics to free, may be NULL
+ */
+void morsectrl_stats_free(struct morsectrl_stats *stats);
+
+/**
+ * @brief Interpret the value of an integer statistic as signed.
+ *
+ * @param stat  Statistic of 1, 2, 4 or 8 bytes
+ *
+ * @return      The value, or 0 if the length is not supported
+ */
+int64_t morsectrl_stat_as_int64(const struct morsectrl_stat *stat);
+
+/**
+ * @brief Interpret the value of an integer statistic as unsigned.
+ *
+ * @param stat  Statistic of 1, 2, 4 or 8 bytes
+ *
+ * @return      The value, or 0 if the length is not supported
+ */
+uint64_t morsectrl_stat_as_uint64(const struct morsectrl_stat *stat);
@@ -46,6 +46,12 @@ static struct
     struct arg_str *cfg_opts;
     struct arg_str *file_opts;
     struct arg_lit *version;
+    struct arg_str *batch;
+    struct arg_str *daemon;
+    struct arg_str *connect;
+    struct arg_lit *timing;
+    struct arg_str *timing_format;
+    struct arg_str *trace;
     struct arg_str *command;
 } args;
 
@@ -121,11 +127,139 @@ int cmdname_cmp(const void * a, const void * b) {
     return strcmp(((struct command_handler *)a)->name, ((struct command_handler *)b)->name);
 }
 
+static struct command_handler *find_command_handler(const char *name)
+{
+    struct command_handler *handler;
+
+    for (handler = __start_cli_handlers;
+         handler < __stop_cli_handlers;
+         handler++)
+    {
+        if (!strcmp(name, handler->name))
+            return handler;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Check whether a command handler resets the chip over the transport.
+ */
+static bool command_resets_chip(struct morsectrl *mors, const struct command_handler *handler)
+{
+    return !strncmp(handler->name, "reset", strlen(handler->name)) &&
+           morsectrl_transport_has_reset(mors->transport);
+}
+
+/**
+ * @brief Check whether a command only works on files, so runs without a transport.
+ *
+ * Reset is not registered as needing the interface, but still resets the chip over the transport.
+ */
+static bool command_is_offline(const char *command)
+{
+    struct command_handler *handler = find_command_handler(command);
+
+    return handler && handler->is_intf_cmd == MM_INTF_NOT_REQUIRED &&
+           strcmp(handler->name, "reset");
+}
+
+bool morsectrl_command_resets_chip(struct morsectrl *mors, const char *command)
+{
+    struct command_handler *handler = find_command_handler(command);
+
+    return handler && command_resets_chip(mors, handler);
+}
+
+int morsectrl_run_command(struct morsectrl *mors, int argc, char *argv[], bool init_transport)
+{
+    struct command_handler *handler;
+    int ret;
+
+    handler = find_command_handler(argv[0]);
+    if (!handler)
+    {
+        mctrl_err("Invalid command '%s'\n", argv[0]);
+        mctrl_err("Try %s --help for more information\n", TOOL_NAME);
+        return MORSE_CMD_ERR;
+    }
+
+    if (mors->debug)
+    {
+        mctrl_print("Calling: %s ", handler->name);
+        for (int j = 1; j < argc; j++)
+        {
+            mctrl_print("%s ", argv[j]);
+        }
+        mctrl_print("\n");
+    }
+
+    if (handler->init)
+    {
+        if (handler->init(mors, &handler->args))
+            return MORSE_ARG_ERR;
+
+        if ((ret = mm_parse_argtable(handler->name, &handler->args, argc, argv)) != 0)
+        {
+            mm_free_argtable(&handler->args);
+            if (ret > 0)
+                return MORSE_ARG_ERR;
+
+            return 0;
+        }
+    }
+    else
+    {
+        /*
+         * Legacy handlers use getopt, so its state needs to be reset. Setting optind to 0 rather
+         * than 1 also clears any state left over from a previous command that was parsed only
+         * part way through a group of short options.
+         */
+        optind = 0;
+    }
+
+    if (handler->direct_chip_supported_cmd != MM_DIRECT_CHIP_SUPPORTED &&
+        !morsectrl_transport_has_driver(mors->transport))
+    {
+        mctrl_err("Command '%s' cannot be used with transport %s\n", handler->name,
+                  morsectrl_transport_name(mors->transport));
+        mctrl_err("To check valid commands run 'morsectrl -t %s -h'\n",
+                  morsectrl_transport_name(mors->transport));
+        ret = ETRANSFTDISPIERR;
+        goto exit;
+    }
+
+    if (!strcmp(handler->name, "version"))
+        print_version();
+
+    if (init_transport &&
+        (handler->is_intf_cmd == MM_INTF_REQUIRED || command_resets_chip(mors, handler)))
+    {
+        ret = morsectrl_transport_init(mors->transport);
+        if (ret)
+        {
+            mctrl_err("Transport init failed\n");
+            goto exit;
+        }
+    }
+
+    ret = handler->handler(mors, argc, argv);
+
+    if (init_transport && handler->is_intf_cmd == MM_INTF_REQUIRED)
+        morsectrl_transport_deinit(mors->transport);
+
+exit:
+    if (handler->init)
+        mm_free_argtable(&handler->args);
+
+    return ret;
+}
 
 int main(int argc, char *argv[])
 {
-    struct command_handler *handler = NULL;
+    uint64_t start_us = time_monotonic_us();
     int ret = MORSE_OK;
+    bool timing_json = false;
     char *trans_opts = NULL;
     char *iface_opts = NULL;
     char *cfg_opts = NULL;
@@ -160,7 +294,27 @@ int main(int argc, char *argv[])
                      args.cfg_opts = arg_str0("c", "config", NULL,
                                               "specify the config for the transport"),
                      args.version = arg_lit0("v", NULL, "print the version"),
-                     args.command = arg_str1(NULL, NULL, "command", "sub-command to run"));
+                     args.batch = arg_str0("b", "batch", "<file>",
+                                           "run the sub-commands listed in the given file, one "
+                                           "per line, over a single transport session "
+                                           "('-' for stdin)"),
+                     args.daemon = arg_str0(NULL, "daemon", "<socket>",
+                                            "keep the transport open and serve commands on the "
+                                            "given UNIX socket"),
+                     args.connect = arg_str0(NULL, "connect", "<socket>",
+                                             "forward the command to a daemon listening on the "
+                                             "given UNIX socket"),
+                     args.timing = arg_lit0(NULL, "timing",
+                                            "print the latency of the transport calls made, "
+                                            "per operation and per command, to stderr on exit"),
+                     args.timing_format = arg_str0(NULL, "timing-format", "<text|json>",
+                                                   "format of the --timing output, implies "
+                                                   "--timing (default text)"),
+                     args.trace = arg_str0(NULL, "trace", "<file>",
+                                           "record the commands, responses and chip accesses "
+                                           "made over the transport, with their timestamps, to "
+                                           "the given file for trace_report"),
+                     args.command = arg_str0(NULL, NULL, "command", "sub-command to run"));
 
     args.iface->sval[0] = DEFAULT_INTERFACE_NAME;
 
@@ -214,6 +368,64 @@ int main(int argc, char *argv[])
         goto exit;
     }
 
+    if (args.timing_format->count)
+    {
+        const char *format = args.timing_format->sval[0];
+
+        if (!strcmp(format, "json"))
+        {
+            timing_json = true;
+        }
+        else if (strcmp(format, "text"))
+        {
+            mctrl_err("Invalid timing format %s\n", format);
+            ret = MORSE_ARG_ERR;
+            goto exit;
+        }
+    }
+
+    if (args.batch->count + args.daemon->count + args.connect->count > 1)
+    {
+        mctrl_err("Only one of -b, --daemon and --connect can be given\n");
+        ret = MORSE_ARG_ERR;
+        goto exit;
+    }
+
+    if (args.command->count && (args.batch->count || args.daemon->count))
+    {
+        mctrl_err("A command cannot be given with %s\n", args.batch->count ? "-b" : "--daemon");
+        ret = MORSE_ARG_ERR;
+        goto exit;
+    }
+
+    if (!args.command->count &&
+        (args.connect->count || (!args.daemon->count && !args.batch->count)))
+    {
+        if (args.version->count)
+        {
+            print_version();
+            goto exit;
+        }
+
+        mctrl_err("%s: missing option <command>\n", TOOL_NAME);
+        mctrl_err("Try %s --help for more information\n", TOOL_NAME);
+        ret = MORSE_ARG_ERR;
+        goto exit;
+    }
+
+    if (args.connect->count)
+    {
+#ifndef MORSE_WIN_BUILD
+        ret = morsectrl_daemon_forward(args.connect->sval[0], mors.debug,
+                                       argc - args.command->hdr.idx,
+                                       argv + args.command->hdr.idx);
+#else
+        mctrl_err("Daemon mode is not supported on this platform\n");
+        ret = MORSE_ARG_ERR;
+#endif
+        goto exit;
+    }
+
     if (file_opts)
     {
         ret = morsectrl_config_file_parse(file_opts,
@@ -226,94 +438,56 @@ int main(int argc, char *argv[])
             goto exit;
     }
 
+    if (!args.daemon->count && !args.batch->count &&
+        command_is_offline(argv[args.command->hdr.idx]))
+    {
+        /* Don't fail on missing transport options for a command that never uses the transport */
+        ret = morsectrl_run_command(&mors, argc - args.command->hdr.idx,
+                                    argv + args.command->hdr.idx, false);
+        goto exit;
+    }
+
     ret = morsectrl_transport_parse(&mors.transport, mors.debug, trans_opts, iface_opts, cfg_opts);
     if (ret)
         goto exit;
 
-    for (handler = __start_cli_handlers;
-         handler < __stop_cli_handlers;
-         handler++)
-    {
-        if (!strcmp(args.command->sval[0], handler->name))
-        {
-            if (mors.debug)
-            {
-                mctrl_print("Calling: %s ", handler->name);
-                for (int j = 1; j < argc; j++)
-                {
-                    mctrl_print("%s ", argv[j]);
-                }
-                mctrl_print("\n");
-            }
-
-            if (handler->init)
-            {
-                if (handler->init(&mors, &handler->args))
-                {
-                    ret = MORSE_ARG_ERR;
-                    goto exit;
-                }
-
-                if ((ret = mm_parse_argtable(handler->name, &handler->args,
-                                             argc - args.command->hdr.idx,
-                                             argv + args.command->hdr.idx)) != 0)
-                {
-                    mm_free_argtable(&handler->args);
-                    if (ret > 0)
-                        ret = MORSE_ARG_ERR;
-                    else
-                        ret = 0;
-
-                    goto exit;
-                }
-            }
-            else
-            {
-                /* Legacy handlers need argc and argv updated, and also optind resset */
-                argc -= args.command->hdr.idx;
-                argv += args.command->hdr.idx;
-                optind = 1;
-            }
+    if (args.timing->count || args.timing_format->count)
+        morsectrl_transport_timing_enable(mors.transport, start_us);
 
-            if (handler->direct_chip_supported_cmd != MM_DIRECT_CHIP_SUPPORTED &&
-                !morsectrl_transport_has_driver(mors.transport))
-            {
-                mctrl_err("Command '%s' cannot be used with transport %s\n", handler->name,
-                          trans_opts);
-                mctrl_err("To check valid commands run 'morsectrl -t %s -h'\n", trans_opts);
-                ret = ETRANSFTDISPIERR;
-                goto exit;
-            }
-
-            if (!strcmp(handler->name, "version"))
-                print_version();
+    if (args.trace->count)
+    {
+        ret = morsectrl_transport_trace_open(mors.transport, args.trace->sval[0]);
+        if (ret)
+            goto exit;
+    }
 
-            if (handler->is_intf_cmd == MM_INTF_REQUIRED ||
-                (!strncmp(handler->name, "reset", strlen(handler->name)) &&
-                 morsectrl_transport_has_reset(mors.transport)))
-            {
-                ret = morsectrl_transport_init(mors.transport);
-                if (ret)
-                {
-                    mctrl_err("Transport init failed\n");
-                    goto exit;
-                }
-            }
+    if (args.daemon->count)
+    {
+#ifndef MORSE_WIN_BUILD
+        ret = morsectrl_daemon_serve(&mors, args.daemon->sval[0]);
+#else
+        mctrl_err("Daemon mode is not supported on this platform\n");
+        ret = MORSE_ARG_ERR;
+#endif
+        goto exit;
+    }
 
-            ret = handler->handler(&mors, argc, argv);
-            goto transport_exit;
-        }
+    if (args.batch->count)
+    {
+        ret = morsectrl_batch_run(&mors, args.batch->sval[0]);
+        goto exit;
     }
 
-    ret = MORSE_CMD_ERR;
-    mctrl_err("Invalid command '%s'\n", args.command->sval[0]);
-    mctrl_err("Try %s --help for more information\n", TOOL_NAME);
+    ret = morsectrl_run_command(&mors, argc - args.command->hdr.idx,
+                                argv + args.command->hdr.idx, true);
 
-transport_exit:
-    if (handler != NULL && (handler < __stop_cli_handlers) &&
-        handler->is_intf_cmd == MM_INTF_REQUIRED)
-        morsectrl_transport_deinit(mors.transport);
 exit:
+    if (args.timing->count || args.timing_format->count)
+        morsectrl_transport_timing_print(mors.transport, stderr, timing_json);
+
+    if (args.trace->count && morsectrl_transport_trace_close(mors.transport))
+        mctrl_err("Failed to write trace file %s\n", args.trace->sval[0]);
+
     /**
      * For return codes less than 0, or greater than 255 (i.e. the nix return code error range)
      * remap error to MORSE_CMD_ERR. The return code 255 (-1) is avoided as ssh uses this to
@@ -36,6 +36,12 @@ struct morsectrl {
     struct morsectrl_transport *transport;
     offchip_stats_t *stats;
     size_t n_stats;
+    /* Statistics metadata indexed by tag, for tags up to n_stats_by_tag - 1 */
+    offchip_stats_t **stats_by_tag;
+    size_t n_stats_by_tag;
+    /* Mapping of the statistics metadata cache that stats points into, if any */
+    void *stats_map;
+    size_t stats_map_len;
 };
 
 enum mm_intr_requirements {
@@ -71,6 +77,69 @@ int morsectrl_config_file_parse(const char *file_opts,
                                 char **cfg_opts,
                                 bool debug);
 
+/**
+ * @brief Run a single sub-command.
+ *
+ * @param mors              Morsectrl context, with the transport already parsed
+ * @param argc              Number of arguments, including the sub-command name
+ * @param argv              Arguments, starting with the sub-command name
+ * @param init_transport    Whether to initialise (and deinitialise) the transport around the
+ *                          command if it requires an interface. When false the caller is expected
+ *                          to have initialised the transport already.
+ *
+ * @return                  0 on success otherwise the command's error code
+ */
+int morsectrl_run_command(struct morsectrl *mors, int argc, char *argv[], bool init_transport);
+
+/**
+ * @brief Check whether a sub-command resets the chip through the transport, after which the
+ *        transport must be initialised again before it is used.
+ *
+ * @param mors      Morsectrl context, with the transport already parsed
+ * @param command   Name of the sub-command
+ *
+ * @return          true if the sub-command resets the chip
+ */
+bool morsectrl_command_resets_chip(struct morsectrl *mors, const char *command);
+
+/**
+ * @brief Run the sub-commands listed in a file, one per line, over a single transport session.
+ *
+ * Arguments are whitespace separated and may be quoted. Blank lines and lines starting with '#'
+ * are ignored. Execution stops at the first command that fails.
+ *
+ * @param mors      Morsectrl context, with the transport already parsed
+ * @param filename  File to read commands from, or "-" for stdin
+ *
+ * @return          0 on success otherwise the error code of the failing command
+ */
+int morsectrl_batch_run(struct morsectrl *mors, const char *filename);
+
+/**
+ * @brief Initialise the transport once and serve commands received on a UNIX socket until
+ *        terminated by SIGINT or SIGTERM.
+ *
+ * @param mors          Morsectrl context, with the transport already parsed
+ * @param socket_path   Path of the UNIX socket to listen on
+ *
+ * @return              0 on success otherwise an error code
+ */
+int morsectrl_daemon_serve(struct morsectrl *mors, const char *socket_path);
+
+/**
+ * @brief Forward a command to a daemon started with morsectrl_daemon_serve().
+ *
+ * The command's output is written by the daemon directly to this process' stdout and stderr.
+ *
+ * @param socket_path   Path of the UNIX socket the daemon is listening on
+ * @param debug         Whether the daemon should print debug information for the command
+ * @param argc          Number of arguments, including the sub-command name
+ * @param argv          Arguments, starting with the sub-command name
+ *
+ * @return              The return code of the command
+ */
+int morsectrl_daemon_forward(const char *socket_path, bool debug, int argc, char *argv[]);
+
 /* Our command link handlers need to be aligned to 8 byte boundaries (for up to 64-bit platforms) */
 #define MM_CLI_HANDLER_ALIGN __attribute__((aligned(8)))
 
@@ -16,36 +16,121 @@
  * <https://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
 #include "offchip_statistics.h"
 #include "command.h"
+#include "utilities.h"
 
 
+int morse_stats_index_build(struct morsectrl *mors)
+{
+    size_t max_tag = 0;
+
+    morse_stats_index_free(mors);
+
+    if (!mors->n_stats)
+        return 0;
+
+    for (size_t i = 0; i < mors->n_stats; i++)
+        max_tag = MAX(max_tag, (size_t)mors->stats[i].tag);
+
+    mors->stats_by_tag = calloc(max_tag + 1, sizeof(*mors->stats_by_tag));
+    if (!mors->stats_by_tag)
+        return -ENOMEM;
+
+    mors->n_stats_by_tag = max_tag + 1;
+
+    /* Fill backwards so that the first of any duplicate tags wins, as with a linear search */
+    for (size_t i = mors->n_stats; i > 0; i--)
+        mors->stats_by_tag[mors->stats[i - 1].tag] = &mors->stats[i - 1];
+
+    return 0;
+}
+
+void morse_stats_index_free(struct morsectrl *mors)
+{
+    free(mors->stats_by_tag);
+    mors->stats_by_tag = NULL;
+    mors->n_stats_by_tag = 0;
+}
+
+uint64_t morse_stats_schema_id(const struct morsectrl *mors)
+{
+    uint64_t hash = FNV1A_64_INIT;
+
+    /* Only hash what affects decoding, so that rebuilding the firmware keeps the same id */
+    for (size_t i = 0; i < mors->n_stats; i++)
+    {
+        const struct statistics_offchip_data *stat = &mors->stats[i];
+        uint32_t format = htole32(stat->format);
+        uint16_t tag = htole16(stat->tag);
+
+        hash = hash_fnv1a_64(hash, &tag, sizeof(tag));
+        hash = hash_fnv1a_64(hash, &format, sizeof(format));
+        hash = hash_fnv1a_64(hash, stat->key, strnlen(stat->key, sizeof(stat->key)));
+        hash = hash_fnv1a_64(hash, "", 1);
+        hash = hash_fnv1a_64(hash, stat->type_str, strnlen(stat->type_str, sizeof(stat->type_str)));
+        hash = hash_fnv1a_64(hash, "", 1);
+    }
+
+    return hash;
+}
+
 /*
 * Get the offchip data for this tag,
 * or NULL if none can be found.
 */
 struct statistics_offchip_data *get_stats_offchip(const struct morsectrl *mors, stats_tlv_tag_t tag)
 {
-#ifdef ENABLE_TRANS_NL80211
-    struct statistics_offchip_data *res = NULL;
-    for (int i = 0; i < mors->n_stats; i++)
+    if (mors->stats_by_tag)
+        return (tag < mors->n_stats_by_tag) ? mors->stats_by_tag[tag] : NULL;
+
+    for (size_t i = 0; i < mors->n_stats; i++)
     {
         if (mors->stats[i].tag == tag)
-        {
-            res = mors->stats + i;
-            break;
-        }
+            return mors->stats + i;
     }
-    return res;
-#else
+
     return NULL;
-#endif
 }
 
 
+int morse_stats_decode(const struct morsectrl *mors, const uint8_t *buf, size_t size,
+                       morse_stats_decode_cb_t cb, void *arg)
+{
+    while (size > STATS_TLV_OVERHEAD)
+    {
+        stats_tlv_tag_t tag;
+        stats_tlv_len_t len;
+
+        memcpy(&tag, buf, sizeof(tag));
+        buf += sizeof(tag);
+
+        memcpy(&len, buf, sizeof(len));
+        buf += sizeof(len);
+
+        size -= STATS_TLV_OVERHEAD;
+
+        if ((len > size) || (len == 0))
+        {
+            mctrl_err("error: malformed TLV (tag %d/0x%x, len %u/0x%x, size %zu)\n",
+                      tag, tag, len, len, size);
+            return -1;
+        }
+
+        cb(arg, tag, get_stats_offchip(mors, tag), buf, len);
+
+        buf += len;
+        size -= len;
+    }
+
+    return 0;
+}
+
 int64_t get_signed_value_as_int64(const uint8_t *buf, uint32_t size)
 {
     int64_t n = 0;
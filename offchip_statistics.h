@@ -63,7 +63,75 @@ struct __attribute__((packed)) statistics_offchip_data {
 
 #define OLD_STATS_COMMAND_MASK 0xDF
 
+/**
+ * @brief Build the table get_stats_offchip() uses to look up metadata by tag.
+ *
+ * Must be called whenever the statistics metadata of the context changes. Where a tag appears
+ * more than once the first entry is used.
+ *
+ * @param mors  Morsectrl context holding the statistics metadata
+ *
+ * @return      0 on success, -ENOMEM if the table could not be allocated (lookups then fall back
+ *              to a linear search)
+ */
+int morse_stats_index_build(struct morsectrl *mors);
+
+/**
+ * @brief Free the table built by morse_stats_index_build().
+ *
+ * @param mors  Morsectrl context
+ */
+void morse_stats_index_free(struct morsectrl *mors);
+
+/**
+ * @brief Get an identifier of the loaded statistics metadata.
+ *
+ * Statistics captured with one set of metadata can only be decoded with metadata of the same
+ * schema id.
+ *
+ * @param mors  Morsectrl context holding the statistics metadata
+ *
+ * @return      The schema id
+ */
+uint64_t morse_stats_schema_id(const struct morsectrl *mors);
+
+/**
+ * @brief Get the metadata for a statistic.
+ *
+ * @param mors  Morsectrl context holding the statistics metadata
+ * @param tag   Tag of the statistic
+ *
+ * @return      The metadata, or NULL if the tag is unknown
+ */
 struct statistics_offchip_data *get_stats_offchip(const struct morsectrl *mors,
                                                     stats_tlv_tag_t tag);
+/**
+ * @brief Called for each statistic found in a stats response.
+ *
+ * @param arg       Opaque argument given to morse_stats_decode()
+ * @param tag       Tag of the statistic
+ * @param offchip   Metadata for the statistic, or NULL if the tag is unknown
+ * @param buf       Value of the statistic
+ * @param len       Length of the value
+ */
+typedef void (*morse_stats_decode_cb_t)(void *arg, stats_tlv_tag_t tag,
+                                        const struct statistics_offchip_data *offchip,
+                                        const uint8_t *buf, uint32_t len);
+
+/**
+ * @brief Walk the TLVs of a stats response, looking up the metadata for each one.
+ *
+ * @param mors  Morsectrl context holding the statistics metadata
+ * @param buf   Stats response payload
+ * @param size  Size of the stats response payload
+ * @param cb    Function to call for each statistic
+ * @param arg   Opaque argument passed to cb
+ *
+ * @return      0 on success, -1 if a malformed TLV was found (statistics preceding it will have
+ *              been passed to cb)
+ */
+int morse_stats_decode(const struct morsectrl *mors, const uint8_t *buf, size_t size,
+                       morse_stats_decode_cb_t cb, void *arg);
+
 int64_t get_signed_value_as_int64(const uint8_t *buf, uint32_t size);
 uint64_t get_unsigned_value_as_uint64(const uint8_t *buf, uint32_t size);
@@ -26,6 +26,7 @@
 #endif
 
 #include "portable_endian.h"
+#include "libmorsectrl.h"
 #include "command.h"
 #include "elf_file.h"
 #include "offchip_statistics.h"
@@ -38,6 +39,15 @@
 #define MAX_PATH 1024
 #endif
 
+/** Number of cores statistics can be read from (APP, MAC and UPHY) */
+#define STATS_MAX_CORES (3)
+
+/** Maximum number of filters that can be given */
+#define STATS_MAX_FILTERS (64)
+
+/** Number of mismatching metadata IDs stats_decode warns about, each only once */
+#define STATS_MAX_WARNED_SCHEMAS (16)
+
 static struct
 {
     struct arg_lit *apps_core;
@@ -46,10 +56,30 @@ static struct
     struct arg_lit *reset;
     struct arg_lit *json_format;
     struct arg_lit *pprint_format;
+    struct arg_str *format;
     struct arg_str *filter_str;
     struct arg_str *firmware_path;
+    struct arg_int *watch;
+    struct arg_int *count;
+    struct arg_str *record;
 } args;
 
+static struct
+{
+    struct arg_str *capture;
+    struct arg_str *firmware_path;
+    struct arg_lit *json_format;
+    struct arg_lit *pprint_format;
+    struct arg_str *filter_str;
+} decode_args;
+
+/** Names of the cores, indexed by enum morsectrl_stats_core */
+static const char *const stats_core_names[] = {
+    [MORSECTRL_STATS_CORE_APP] = "app",
+    [MORSECTRL_STATS_CORE_MAC] = "mac",
+    [MORSECTRL_STATS_CORE_UPHY] = "uphy",
+};
+
 /* Read and return a single word from a file.
  * The result is always null terminated.
  */
@@ -111,7 +141,6 @@ static void get_override_firmware_path(struct morsectrl *mors, char *firmware_fu
 
 static int load_offchip_statistics(struct morsectrl *mors, const char *filename)
 {
-    FILE *infile;
     char firmware_path[MAX_PATH] = "/lib/firmware/morse/mm6108.bin";
 
     if (!filename)
@@ -120,103 +149,320 @@ static int load_offchip_statistics(struct morsectrl *mors, const char *filename)
         get_override_firmware_path(mors, firmware_path, sizeof(firmware_path));
     }
 
-    infile = fopen(filename, "rb");
-    if (infile)
+    return morse_stats_load_file(mors, filename);
+}
+
+
+#ifndef MORSE_WIN_BUILD
+struct stats_filter
+{
+    regex_t re[STATS_MAX_FILTERS];
+    int n_re;
+};
+
+static void filter_deinit(struct stats_filter *filter);
+
+static int filter_init(struct stats_filter *filter, const char *const *filter_strings, int n)
+{
+    int ret = 0;
+
+    filter->n_re = 0;
+
+    for (int ii = 0; ii < n; ii++)
     {
-        uint8_t *buf = NULL;
+        ret = regcomp(&filter->re[ii], filter_strings[ii], 0);
 
-        load_file(infile, &buf);
-        if (buf)
+        if (ret)
         {
-            morse_stats_load(&mors->stats, &mors->n_stats, buf);
-            free(buf);
+            size_t len = regerror(ret, &filter->re[ii], NULL, 0);
+            char *re_err_buf = malloc(len);
+            regerror(ret, &filter->re[ii], re_err_buf, len);
+            mctrl_err("Invalid filter string %s: %s\n", filter_strings[ii], re_err_buf);
+            free(re_err_buf);
+            filter_deinit(filter);
+            break;
         }
-        fclose(infile);
+
+        filter->n_re++;
     }
-    else
+
+    return ret;
+}
+
+/* Returns 0 if the key matches any of the filters */
+static int filter_stat(const struct stats_filter *filter, const char *key)
+{
+    for (int ii = 0; ii < filter->n_re; ii++)
     {
-        mctrl_err("Error - could not open %s to read stats metadata\n", filename);
-        return -1;
+        if (!regexec(&filter->re[ii], key, 0, NULL, 0))
+            return 0;
     }
-    return 0;
+
+    return REG_NOMATCH;
 }
 
+static void filter_deinit(struct stats_filter *filter)
+{
+    for (int ii = 0; ii < filter->n_re; ii++)
+        regfree(&filter->re[ii]);
 
-#ifndef MORSE_WIN_BUILD
-static regex_t *filter_re = NULL;
+    filter->n_re = 0;
+}
 
-static int filter_init(const char *filter_string)
+static const char *filter_help(void)
 {
-    int ret = 0;
+    return "uses a regular expression, may be given more than once to select the statistics "
+           "matching any of them";
+}
+#else
+struct stats_filter
+{
+    const char *const *str;
+    int n_str;
+};
+
+static int filter_init(struct stats_filter *filter, const char *const *filter_strings, int n)
+{
+    filter->str = filter_strings;
+    filter->n_str = n;
 
-    filter_re = malloc(sizeof(*filter_re));
-    ret = regcomp(filter_re, filter_string, 0);
+    return 0;
+}
 
-    if (ret)
+/* Returns 0 if the key matches any of the filters */
+static int filter_stat(const struct stats_filter *filter, const char *key)
+{
+    for (int ii = 0; ii < filter->n_str; ii++)
     {
-        size_t len = regerror(ret, filter_re, NULL, 0);
-        char *re_err_buf = malloc(len);
-        regerror(ret, filter_re, re_err_buf, len);
-        mctrl_err("Invalid filter string: %s\n", re_err_buf);
-        free(re_err_buf);
-        free(filter_re);
-        filter_re = NULL;
+        if (!strcmp(key, filter->str[ii]))
+            return 0;
     }
 
-    return ret;
+    return 1;
 }
 
-static int filter_stat(const char *key)
+static void filter_deinit(struct stats_filter *filter)
 {
-    return regexec(filter_re, key, 0, NULL, 0);
+    filter->str = NULL;
+    filter->n_str = 0;
 }
 
-static void filter_deinit(void)
+static const char *filter_help(void)
+{
+    return "case sensitive, match from start of key, may be given more than once";
+}
+#endif
+
+/**
+ * @brief Evaluate a filter against the statistics metadata, producing a bitmap of the selected
+ *        tags.
+ *
+ * @param mors          Morsectrl context holding the statistics metadata.
+ * @param filter        Compiled filter.
+ * @param[out] n_tags   Number of tags covered by the bitmap.
+ *
+ * @return The bitmap, to be freed by the caller, or NULL on allocation failure.
+ */
+static uint32_t *filter_select_tags(const struct morsectrl *mors,
+                                    const struct stats_filter *filter, size_t *n_tags)
 {
-    if (filter_re)
+    size_t max_tag = 0;
+    uint32_t *selected;
+
+    for (size_t ii = 0; ii < mors->n_stats; ii++)
+        max_tag = MAX(max_tag, (size_t)mors->stats[ii].tag);
+
+    selected = calloc(max_tag / 32 + 1, sizeof(*selected));
+    if (!selected)
+        return NULL;
+
+    for (size_t ii = 0; ii < mors->n_stats; ii++)
     {
-        regfree(filter_re);
-        free(filter_re);
+        stats_tlv_tag_t tag = mors->stats[ii].tag;
+
+        /* The first entry of a duplicated tag is the one used when decoding */
+        if (get_stats_offchip(mors, tag) == &mors->stats[ii] &&
+            !filter_stat(filter, mors->stats[ii].key))
+            selected[tag / 32] |= BIT(tag % 32);
     }
-    filter_re = NULL;
+
+    *n_tags = max_tag + 1;
+    return selected;
 }
 
-static const char *filter_help(void)
+/**
+ * @brief Compile the given filters and select the matching tags in the print context.
+ *
+ * @param mors          Morsectrl context holding the statistics metadata.
+ * @param filter_str    Filter arguments.
+ * @param[out] selected Bitmap of the selected tags, to be freed by the caller. Left NULL if no
+ *                      filter was given.
+ * @param[out] n_tags   Number of tags covered by the bitmap.
+ *
+ * @return 0 on success otherwise -1.
+ */
+static int filter_select(const struct morsectrl *mors, const struct arg_str *filter_str,
+                         uint32_t **selected, size_t *n_tags)
 {
-    return "uses a regular expression";
+    struct stats_filter filter;
+
+    *selected = NULL;
+
+    if (filter_str->count == 0)
+        return 0;
+
+    /* Evaluate the filter against the metadata once, decoding then only tests a bit */
+    if (filter_init(&filter, filter_str->sval, filter_str->count))
+        return -1;
+
+    *selected = filter_select_tags(mors, &filter, n_tags);
+    filter_deinit(&filter);
+
+    return *selected ? 0 : -1;
 }
-#else
-static const char *filter_str = NULL;
 
-static int filter_init(const char *filter_string)
+/**
+ * Samples of the counter statistics taken by --watch. The arrays are indexed like mors->stats, so
+ * taking the difference between two samples does not need any lookups.
+ */
+struct stats_watch
 {
-    filter_str = filter_string;
+    /** Statistics metadata the arrays are indexed by */
+    const struct statistics_offchip_data *stats;
+    /** Number of entries in each array */
+    size_t n_stats;
+    /** Counter values of the two most recent samples */
+    uint64_t *values[2];
+    /** Width in bytes of each counter in the two most recent samples, 0 if it was not present */
+    uint8_t *width[2];
+    /** Index of the sample currently being taken */
+    int cur;
+};
 
-    return 0;
+/** State used while printing the statistics of a stats command */
+struct stats_print_ctx
+{
+    /** Formatter functions for the selected output format */
+    const struct format_table *table;
+    /** Formatter state */
+    struct format_ctx fmt;
+    /** Selected output format */
+    enum format_type format;
+    /** Bitmap of the tags selected by the filter, or NULL to print everything */
+    const uint32_t *selected;
+    /** Number of tags covered by the bitmap */
+    size_t n_selected;
+    /** Samples being collected by --watch instead of printing, or NULL */
+    struct stats_watch *watch;
+    /** Schema id of the statistics metadata, written in binary records */
+    uint64_t schema_id;
+    /** Stream binary records are written to */
+    FILE *out;
+};
+
+/** Get the core (enum morsectrl_stats_core) a stats command reads from */
+static uint16_t stats_cmd_core(int cmd)
+{
+    switch (cmd)
+    {
+        case MORSE_COMMAND_MAC_STATS_LOG:
+            return MORSECTRL_STATS_CORE_MAC;
+        case MORSE_COMMAND_UPHY_STATS_LOG:
+            return MORSECTRL_STATS_CORE_UPHY;
+        case MORSE_COMMAND_APP_STATS_LOG:
+        default:
+            return MORSECTRL_STATS_CORE_APP;
+    }
 }
 
-static int filter_stat(const char *key)
+/** Check whether a tag is selected by the filter */
+static inline bool stats_tag_selected(const struct stats_print_ctx *print, stats_tlv_tag_t tag)
 {
-    return strcmp(key, filter_str);
+    if (!print->selected)
+        return true;
+
+    return tag < print->n_selected && (print->selected[tag / 32] & BIT(tag % 32));
 }
 
-static void filter_deinit(void)
+/** Record a statistic in the current sample if it is a counter */
+static void stats_watch_record(struct stats_watch *watch,
+                               const struct statistics_offchip_data *offchip,
+                               const uint8_t *buf, uint32_t len)
 {
-    filter_str = NULL;
+    size_t idx;
+
+    if (!offchip || offchip->format != MORSE_STATS_FMT_U_DEC ||
+        (len != 1 && len != 2 && len != 4 && len != 8))
+        return;
+
+    idx = offchip - watch->stats;
+    watch->values[watch->cur][idx] = get_unsigned_value_as_uint64(buf, len);
+    watch->width[watch->cur][idx] = len;
 }
 
-static const char *filter_help(void)
+static void stats_print_stat(void *arg, stats_tlv_tag_t tag,
+                             const struct statistics_offchip_data *offchip,
+                             const uint8_t *buf, uint32_t len)
 {
-    return "case sensitive, match from start of key";
+    struct stats_print_ctx *print = arg;
+
+    if (print->watch)
+    {
+        if (stats_tag_selected(print, tag))
+            stats_watch_record(print->watch, offchip, buf, len);
+        return;
+    }
+
+    if (!offchip)
+    {
+        mctrl_err("UNKOWN KEY for tag %d: ", tag);
+        hexdump(buf, len);
+        mctrl_err("\n");
+        return;
+    }
+
+    if (!stats_tag_selected(print, tag))
+        return;
+
+    if (print->format == FORMAT_JSON || print->format == FORMAT_JSON_PPRINT)
+    {
+        stats_format_json_init(&print->fmt);
+    }
+
+    print->table->format_func[offchip->format](&print->fmt, (const char *)offchip->key,
+                                               buf, len);
 }
-#endif
 
-int morsectrl_stats_cmd(struct morsectrl *mors, int cmd, int reset,
-                            const char *filter_string, enum format_type format_val)
+static int morsectrl_stats_print_resp(struct morsectrl *mors, int cmd,
+                                      struct morsectrl_transport_buff *rsp_tbuff,
+                                      bool reset, struct stats_print_ctx *print)
+{
+    struct stats_response *resp = TBUFF_TO_RSP(rsp_tbuff, struct stats_response);
+    int resp_sz = rsp_tbuff->data_len - sizeof(struct response);
+
+    if (reset)
+        return 0;
+
+    if (print->format == FORMAT_BINARY)
+    {
+        /* Leave the TLVs undecoded, they are decoded by whatever reads the records */
+        return stats_format_binary_write(print->out, stats_cmd_core(cmd), time_realtime_us(),
+                                         print->schema_id, resp->stats, MAX(resp_sz, 0));
+    }
+
+    if (resp_sz > 0)
+    {
+        /* A malformed TLV stops decoding but is not treated as a command failure */
+        morse_stats_decode(mors, resp->stats, resp_sz, stats_print_stat, print);
+    }
+
+    return 0;
+}
+
+static int morsectrl_stats_cmd(struct morsectrl *mors, int cmd, bool reset,
+                               struct stats_print_ctx *print)
 {
     int ret = -1;
-    int resp_sz;
-    const struct format_table *table;
     struct stats_response *resp;
     struct morsectrl_transport_buff *cmd_tbuff =
         morsectrl_transport_cmd_alloc(mors->transport, 0);
@@ -226,116 +472,246 @@ int morsectrl_stats_cmd(struct morsectrl *mors, int cmd, int reset,
     if (!cmd_tbuff || !rsp_tbuff)
         goto exit;
 
-    if (filter_string)
-    {
-        ret = filter_init(filter_string);
-
-        if (ret)
-            goto exit;
-    }
-
     resp = TBUFF_TO_RSP(rsp_tbuff, struct stats_response);
 
-    if (reset)
-        cmd += 1;
-
-    ret = morsectrl_send_command(mors->transport, cmd, cmd_tbuff, rsp_tbuff);
-    resp_sz = rsp_tbuff->data_len - sizeof(struct response);
+    ret = morsectrl_send_command(mors->transport, reset ? cmd + 1 : cmd, cmd_tbuff, rsp_tbuff);
 
     if (ret)
     {
         /* Try the deprecated command */
-        ret = morsectrl_send_command(mors->transport, OLD_STATS_COMMAND_MASK & cmd,
+        ret = morsectrl_send_command(mors->transport,
+                                     OLD_STATS_COMMAND_MASK & (reset ? cmd + 1 : cmd),
                                      cmd_tbuff, rsp_tbuff);
-        resp_sz = rsp_tbuff->data_len - sizeof(struct response);
         if (!reset && !ret)
         {
-            mctrl_print("%s", resp->stats);
+            /*
+             * The deprecated commands respond with text, which has no binary representation and
+             * cannot be differenced by --watch
+             */
+            if (print->format == FORMAT_BINARY)
+            {
+                mctrl_err("Firmware only supports text statistics, skipping core %u\n",
+                          stats_cmd_core(cmd));
+            }
+            else if (print->watch)
+            {
+                mctrl_err("Firmware only supports text statistics, which cannot be watched\n");
+                ret = -1;
+            }
+            else
+            {
+                mctrl_print("%s", resp->stats);
+            }
         }
         goto exit;
     }
 
-    if (!reset && !ret)
+    ret = morsectrl_stats_print_resp(mors, cmd, rsp_tbuff, reset, print);
+exit:
+    morsectrl_transport_buff_free(cmd_tbuff);
+    morsectrl_transport_buff_free(rsp_tbuff);
+    return ret;
+}
+
+/**
+ * @brief Read (or reset) the statistics of several cores, printing them in order.
+ *
+ * If the transport supports it, the commands for all cores are in flight at once. Any that fail
+ * (e.g. firmware only supporting the deprecated commands) are retried one at a time.
+ */
+static int morsectrl_stats_cmds(struct morsectrl *mors, const int *cmds, size_t n_cmds,
+                                bool reset, struct stats_print_ctx *print)
+{
+    int ret = 0;
+    int wait_ret;
+    size_t ii;
+    size_t n_sent = 0;
+    struct morsectrl_async_command async[STATS_MAX_CORES];
+    struct morsectrl_transport_buff *rsp_tbuffs[STATS_MAX_CORES] = { NULL };
+    struct morsectrl_transport_buff *cmd_tbuff = NULL;
+
+    if (n_cmds < 2 || n_cmds > STATS_MAX_CORES ||
+        !morsectrl_transport_has_async(mors->transport))
     {
-        uint8_t *buf = (uint8_t *)resp->stats;
+        for (ii = 0; ii < n_cmds && !ret; ii++)
+            ret = morsectrl_stats_cmd(mors, cmds[ii], reset, print);
+
+        return ret;
+    }
+
+    cmd_tbuff = morsectrl_transport_cmd_alloc(mors->transport, 0);
+    if (!cmd_tbuff)
+        return -1;
 
-        switch (format_val)
+    for (ii = 0; ii < n_cmds && !ret; ii++)
+    {
+        rsp_tbuffs[ii] = morsectrl_transport_resp_alloc(mors->transport,
+                                                        sizeof(struct stats_response));
+        if (!rsp_tbuffs[ii])
         {
-            case FORMAT_REGULAR:
-            {
-                table = stats_format_regular_get_formatter_table();
-                break;
-            }
-            case FORMAT_JSON_PPRINT:
-            {
-                stats_format_json_set_pprint(true);
-                /* fall through */
-            }
-            case FORMAT_JSON:
-            {
-                table = stats_format_json_get_formatter_table();
-                break;
-            }
-            default:
-                ret = -1;
-                goto exit;
+            ret = -1;
+            break;
         }
 
-        while (resp_sz > STATS_TLV_OVERHEAD )
+        ret = morsectrl_send_command_async(mors->transport, reset ? cmds[ii] + 1 : cmds[ii],
+                                           cmd_tbuff, rsp_tbuffs[ii], &async[ii]);
+        if (!ret)
+            n_sent++;
+    }
+
+    /* Always collect whatever was sent, so no responses are left behind */
+    wait_ret = morsectrl_wait_commands(mors->transport, async, n_sent);
+    if (!ret)
+        ret = wait_ret;
+    if (ret)
+        goto exit;
+
+    for (ii = 0; ii < n_cmds && !ret; ii++)
+    {
+        if (async[ii].ret)
+            ret = morsectrl_stats_cmd(mors, cmds[ii], reset, print);
+        else
+            ret = morsectrl_stats_print_resp(mors, cmds[ii], rsp_tbuffs[ii], reset, print);
+    }
+
+exit:
+    morsectrl_transport_buff_free(cmd_tbuff);
+    for (ii = 0; ii < n_cmds; ii++)
+        morsectrl_transport_buff_free(rsp_tbuffs[ii]);
+    return ret;
+}
+
+/**
+ * @brief Print the change in each counter between the previous and current sample.
+ *
+ * @param watch         Samples to compare.
+ * @param format        Output format.
+ * @param interval      Sample number of the current sample.
+ * @param elapsed_us    Time between the two samples.
+ */
+static void stats_watch_print(const struct stats_watch *watch, enum format_type format,
+                              int interval, uint64_t elapsed_us)
+{
+    const int cur = watch->cur;
+    const int prev = !cur;
+    const bool json = (format != FORMAT_REGULAR);
+    const char *nl = (format == FORMAT_JSON_PPRINT) ? "\n    " : "";
+    const char *sep = "";
+    double secs = elapsed_us / 1e6;
+
+    if (json)
+        mctrl_print("{\"interval\": %d, \"interval_ms\": %" PRIu64 ", \"stats\": {",
+                    interval, elapsed_us / 1000);
+    else
+        mctrl_print("interval %d: %" PRIu64 " ms\n", interval, elapsed_us / 1000);
+
+    for (size_t ii = 0; ii < watch->n_stats; ii++)
+    {
+        uint8_t width = watch->width[cur][ii];
+        uint64_t delta;
+
+        if (!width || width != watch->width[prev][ii])
+            continue;
+
+        delta = watch->values[cur][ii] - watch->values[prev][ii];
+        /* Allow for the counter wrapping */
+        if (width < sizeof(delta))
+            delta &= (1ULL << (width * 8)) - 1;
+
+        if (json)
+            mctrl_print("%s%s\"%s\": {\"delta\": %" PRIu64 ", \"rate\": %.3f}", sep, nl,
+                        watch->stats[ii].key, delta, secs > 0 ? delta / secs : 0.0);
+        else
+            mctrl_print("%s: %" PRIu64 " (%.3f/s)\n", watch->stats[ii].key, delta,
+                        secs > 0 ? delta / secs : 0.0);
+        sep = ",";
+    }
+
+    if (json)
+        mctrl_print("%s}}\n", (format == FORMAT_JSON_PPRINT) ? "\n" : "");
+}
+
+/**
+ * @brief Repeatedly read the statistics and print the per interval change in each counter. With
+ *        binary output every sample is written as is instead.
+ *
+ * @param mors          Morsectrl context.
+ * @param cmds          Stats commands to send each interval.
+ * @param n_cmds        Number of stats commands.
+ * @param print         Print context, for the output format and selected tags.
+ * @param interval_ms   Time between samples.
+ * @param count         Number of intervals to print, or 0 to continue until interrupted.
+ *
+ * @return 0 on success otherwise the error from the stats commands.
+ */
+static int stats_watch(struct morsectrl *mors, const int *cmds, size_t n_cmds,
+                       struct stats_print_ctx *print, uint32_t interval_ms, int count)
+{
+    struct stats_watch watch = {
+        .stats = mors->stats,
+        .n_stats = mors->n_stats,
+    };
+    const bool binary = (print->format == FORMAT_BINARY);
+    uint64_t start_us = 0;
+    uint64_t prev_us = 0;
+    int ret = 0;
+
+    if (!binary)
+    {
+        watch.values[0] = calloc(watch.n_stats + 1, sizeof(*watch.values[0]));
+        watch.values[1] = calloc(watch.n_stats + 1, sizeof(*watch.values[1]));
+        watch.width[0] = calloc(watch.n_stats + 1, sizeof(*watch.width[0]));
+        watch.width[1] = calloc(watch.n_stats + 1, sizeof(*watch.width[1]));
+        if (!watch.values[0] || !watch.values[1] || !watch.width[0] || !watch.width[1])
         {
-            stats_tlv_tag_t tag =  *((stats_tlv_tag_t *)buf);
-            buf += sizeof(stats_tlv_tag_t);
+            mctrl_err("Failed to allocate memory for --watch\n");
+            ret = -1;
+            goto exit;
+        }
 
-            stats_tlv_len_t len =  *((stats_tlv_len_t *)buf);
-            buf += sizeof(stats_tlv_len_t);
+        print->watch = &watch;
+    }
 
-            if ((len > resp_sz) || (len == 0))
-            {
-                mctrl_err("error: malformed TLV (tag %d/0x%x, len %u/0x%x, size %u)\n",
-                        tag, tag, len, len, resp_sz);
-                break;
-            }
+    /* Deltas need one more sample than the number of intervals, binary output does not */
+    for (int interval = 0; count <= 0 || interval < count + !binary; interval++)
+    {
+        uint64_t now_us;
 
-            struct statistics_offchip_data *offchip = get_stats_offchip(mors, tag);
-            if (offchip)
-            {
-                if ((offchip->format == MORSE_STATS_FMT_DEC) &&
-                        !strncmp(offchip->type_str, "uint", 4))
-                {
-                    offchip->format = MORSE_STATS_FMT_U_DEC;
-                }
-
-                if (!filter_string || !filter_stat(offchip->key))
-                {
-                    if (format_val == FORMAT_JSON || format_val == FORMAT_JSON_PPRINT)
-                    {
-                        stats_format_json_init();
-                    }
-
-                    if (offchip->format > MORSE_STATS_FMT_LAST)
-                    {
-                        offchip->format = MORSE_STATS_FMT_LAST;
-                    }
-
-                    table->format_func[offchip->format]((const char *) offchip->key,
-                                                                (const uint8_t *)buf, len);
-                }
-            }
-            else
-            {
-                mctrl_err("UNKOWN KEY for tag %d: ", tag);
-                hexdump(buf, len);
-                mctrl_err("\n");
-            }
-            buf += len;
+        if (interval)
+        {
+            /* Sleep until the next interval is due so that the period does not drift */
+            uint64_t due_us = start_us + (uint64_t)interval * interval_ms * 1000;
 
-            resp_sz -= (STATS_TLV_OVERHEAD + len);
+            now_us = time_monotonic_us();
+            if (due_us > now_us)
+                sleep_ms((due_us - now_us + 999) / 1000);
         }
+
+        if (!binary)
+            memset(watch.width[watch.cur], 0, watch.n_stats);
+        now_us = time_monotonic_us();
+        if (!interval)
+            start_us = now_us;
+
+        ret = morsectrl_stats_cmds(mors, cmds, n_cmds, false, print);
+        if (ret)
+            break;
+
+        if (interval && !binary)
+            stats_watch_print(&watch, print->format, interval, now_us - prev_us);
+
+        fflush(binary ? print->out : stdout);
+        prev_us = now_us;
+        watch.cur = !watch.cur;
     }
+
+    print->watch = NULL;
+
 exit:
-    filter_deinit();
-    morsectrl_transport_buff_free(cmd_tbuff);
-    morsectrl_transport_buff_free(rsp_tbuff);
+    free(watch.values[0]);
+    free(watch.values[1]);
+    free(watch.width[0]);
+    free(watch.width[1]);
     return ret;
 }
 
@@ -361,11 +737,24 @@ int stats_init(struct morsectrl *mors, struct mm_argtable *mm_args)
                      args.reset = arg_lit0("r", NULL, "reset the statistics"),
                      args.json_format = arg_lit0("j", "json", "Format the statistics in JSON"),
                      args.pprint_format = arg_lit0("p", NULL, "Format the statistics in pprint"),
-                     args.filter_str = arg_str0("f", "filter", "<filter>", filter_help()),
+                     args.format = arg_str0(NULL, "format", "<regular|json|pprint|binary>",
+                                            "Output format. binary writes a length prefixed "
+                                            "record of the raw statistics per core"),
+                     args.filter_str = arg_strn("f", "filter", "<filter>", 0, STATS_MAX_FILTERS,
+                                                 filter_help()),
                      args.firmware_path =
                          arg_str0("s", "firmware",
                                   "<firmware>",
-                                  "Path to the firmware used to process the statistics"));
+                                  "Path to the firmware used to process the statistics"),
+                     args.watch = arg_int0(NULL, "watch", "<interval_ms>",
+                                           "Repeatedly read the statistics, printing the change "
+                                           "and rate of each counter every interval"),
+                     args.count = arg_int0(NULL, "count", "<n>",
+                                           "Number of --watch intervals to print "
+                                           "(default: until interrupted)"),
+                     args.record = arg_str0(NULL, "record", "<file>",
+                                            "Append the raw statistics to a capture file instead "
+                                            "of printing them, see stats_decode"));
     return 0;
 }
 
@@ -373,7 +762,13 @@ int stats(struct morsectrl *mors, int argc, char *argv[])
 {
     int ret = 0;
     bool reset = false, app_c = false, mac_c = false, uph_c = false;
-    enum format_type format = FORMAT_REGULAR;
+    int cmds[STATS_MAX_CORES];
+    size_t n_cmds = 0;
+    uint32_t *selected = NULL;
+    FILE *record = NULL;
+    struct stats_print_ctx print = {
+        .format = FORMAT_REGULAR,
+    };
 
     ret = load_offchip_statistics(mors, args.firmware_path->count >
                                   0 ? args.firmware_path->sval[0] : NULL);
@@ -399,49 +794,142 @@ int stats(struct morsectrl *mors, int argc, char *argv[])
     }
 
     if (args.json_format->count > 0)
-        format = FORMAT_JSON;
+        print.format = FORMAT_JSON;
     else if (args.pprint_format->count > 0)
-        format = FORMAT_JSON_PPRINT;
+        print.format = FORMAT_JSON_PPRINT;
 
-    if (format == FORMAT_JSON)
+    if (args.format->count > 0)
     {
-        mctrl_print("{");
+        const char *format = args.format->sval[0];
+
+        if (!strcmp(format, "regular"))
+            print.format = FORMAT_REGULAR;
+        else if (!strcmp(format, "json"))
+            print.format = FORMAT_JSON;
+        else if (!strcmp(format, "pprint"))
+            print.format = FORMAT_JSON_PPRINT;
+        else if (!strcmp(format, "binary"))
+            print.format = FORMAT_BINARY;
+        else
+        {
+            mctrl_err("Invalid format %s\n", format);
+            ret = -1;
+            goto exit_stats;
+        }
     }
-    else if (format == FORMAT_JSON_PPRINT)
+
+    reset = !!(args.reset->count);
+
+    if (args.record->count > 0)
     {
-        mctrl_print("{\n");
+        if (reset || args.json_format->count > 0 || args.pprint_format->count > 0 ||
+            args.format->count > 0)
+        {
+            mctrl_err("--record cannot be used with --reset or an output format\n");
+            ret = -1;
+            goto exit_stats;
+        }
+
+        print.format = FORMAT_BINARY;
     }
 
-    reset = !!(args.reset->count);
+    if (print.format == FORMAT_BINARY)
+    {
+        /* Binary records carry the whole response, filtering is left to the decoder */
+        if (args.filter_str->count > 0)
+        {
+            mctrl_err("Binary statistics cannot be filtered\n");
+            ret = -1;
+            goto exit_stats;
+        }
+
+        print.schema_id = morse_stats_schema_id(mors);
+
+        if (args.record->count > 0)
+        {
+            record = fopen(args.record->sval[0], "ab");
+            if (!record)
+            {
+                mctrl_err("Could not open capture file %s\n", args.record->sval[0]);
+                ret = -1;
+                goto exit_stats;
+            }
+            print.out = record;
+        }
+        else
+        {
+            print.out = stdout;
+            stats_format_binary_init(stdout);
+        }
+    }
+
+    ret = filter_select(mors, args.filter_str, &selected, &print.n_selected);
+    if (ret)
+        goto exit_stats;
+
+    print.selected = selected;
 
     if (app_c)
+        cmds[n_cmds++] = MORSE_COMMAND_APP_STATS_LOG;
+    if (mac_c)
+        cmds[n_cmds++] = MORSE_COMMAND_MAC_STATS_LOG;
+    if (uph_c)
+        cmds[n_cmds++] = MORSE_COMMAND_UPHY_STATS_LOG;
+
+    if (args.watch->count > 0)
     {
-        ret = morsectrl_stats_cmd(mors, MORSE_COMMAND_APP_STATS_LOG, reset,
-            args.filter_str->sval[0], format);
-        if (ret) goto exit_stats;
+        if (reset || args.watch->ival[0] <= 0)
+        {
+            mctrl_err("--watch requires a positive interval and cannot be used with --reset\n");
+            ret = -1;
+            goto exit_filter;
+        }
+
+        ret = stats_watch(mors, cmds, n_cmds, &print, args.watch->ival[0],
+                          args.count->count > 0 ? args.count->ival[0] : 0);
+        goto exit_filter;
     }
-    if (mac_c)
+
+    if (print.format == FORMAT_REGULAR)
     {
-        ret = morsectrl_stats_cmd(mors, MORSE_COMMAND_MAC_STATS_LOG, reset,
-            args.filter_str->sval[0], format);
-        if (ret) goto exit_stats;
+        print.table = stats_format_regular_get_formatter_table();
     }
-    if (uph_c)
+    else if (print.format != FORMAT_BINARY)
     {
-        ret = morsectrl_stats_cmd(mors, MORSE_COMMAND_UPHY_STATS_LOG, reset,
-            args.filter_str->sval[0], format);
-        if (ret) goto exit_stats;
+        print.table = stats_format_json_get_formatter_table();
+        stats_format_json_reset(&print.fmt, print.format == FORMAT_JSON_PPRINT);
     }
 
-    if (format == FORMAT_JSON)
+    if (print.format == FORMAT_JSON)
+    {
+        mctrl_print("{");
+    }
+    else if (print.format == FORMAT_JSON_PPRINT)
+    {
+        mctrl_print("{\n");
+    }
+
+    ret = morsectrl_stats_cmds(mors, cmds, n_cmds, reset, &print);
+    if (ret) goto exit_filter;
+
+    if (print.format == FORMAT_JSON)
     {
         mctrl_print("}\n");
     }
-    else if (format == FORMAT_JSON_PPRINT)
+    else if (print.format == FORMAT_JSON_PPRINT)
     {
         mctrl_print("\n}\n");
     }
 
+exit_filter:
+    free(selected);
+
+    if (record && fclose(record) && !ret)
+    {
+        mctrl_err("Could not write capture file %s\n", args.record->sval[0]);
+        ret = -1;
+    }
+
 exit_stats:
     if (ret < 0)
     {
@@ -452,3 +940,137 @@ exit_stats:
 }
 
 MM_CLI_HANDLER(stats, MM_INTF_REQUIRED, MM_DIRECT_CHIP_SUPPORTED);
+
+int stats_decode_init(struct morsectrl *mors, struct mm_argtable *mm_args)
+{
+    MM_INIT_ARGTABLE(mm_args, "Decode statistics captured by stats --record",
+                     decode_args.capture = arg_str1(NULL, NULL, "<capture>",
+                                                    "Capture file to decode, - for stdin"),
+                     decode_args.firmware_path =
+                         arg_str0("s", "firmware", "<firmware>",
+                                  "Path to the firmware the statistics were captured from"),
+                     decode_args.json_format = arg_lit0("j", "json",
+                                                        "Format the statistics in JSON"),
+                     decode_args.pprint_format = arg_lit0("p", NULL,
+                                                          "Format the statistics in pprint"),
+                     decode_args.filter_str = arg_strn("f", "filter", "<filter>", 0,
+                                                       STATS_MAX_FILTERS, filter_help()));
+    return 0;
+}
+
+int stats_decode(struct morsectrl *mors, int argc, char *argv[])
+{
+    const char *path = decode_args.capture->sval[0];
+    bool use_stdin = !strcmp(path, "-");
+    struct stats_binary_record rec;
+    struct stats_response resp;
+    uint64_t schema_id;
+    uint64_t warned_schema_ids[STATS_MAX_WARNED_SCHEMAS];
+    size_t n_warned_schemas = 0;
+    uint32_t *selected = NULL;
+    uint32_t len;
+    int n_records = 0;
+    FILE *in = NULL;
+    int ret;
+    struct stats_print_ctx print = {
+        .format = FORMAT_REGULAR,
+    };
+
+    ret = load_offchip_statistics(mors, decode_args.firmware_path->count > 0 ?
+                                  decode_args.firmware_path->sval[0] : NULL);
+    if (ret)
+        goto exit;
+
+    if (decode_args.json_format->count > 0)
+        print.format = FORMAT_JSON;
+    else if (decode_args.pprint_format->count > 0)
+        print.format = FORMAT_JSON_PPRINT;
+
+    if (print.format == FORMAT_REGULAR)
+        print.table = stats_format_regular_get_formatter_table();
+    else
+        print.table = stats_format_json_get_formatter_table();
+
+    ret = filter_select(mors, decode_args.filter_str, &selected, &print.n_selected);
+    if (ret)
+        goto exit;
+
+    print.selected = selected;
+
+    in = use_stdin ? stdin : fopen(path, "rb");
+    if (!in)
+    {
+        mctrl_err("Could not open capture file %s\n", path);
+        ret = -1;
+        goto exit;
+    }
+    stats_format_binary_init(in);
+
+    schema_id = morse_stats_schema_id(mors);
+
+    while ((ret = stats_format_binary_read(in, &rec, resp.stats, sizeof(resp.stats), &len)) > 0)
+    {
+        const char *core = (rec.core < MORSE_ARRAY_SIZE(stats_core_names)) ?
+                           stats_core_names[rec.core] : "unknown";
+
+        /* Only warn once for each mismatching metadata rather than for every record */
+        if (rec.schema_id != schema_id &&
+            n_warned_schemas < MORSE_ARRAY_SIZE(warned_schema_ids))
+        {
+            size_t ii;
+
+            for (ii = 0; ii < n_warned_schemas; ii++)
+            {
+                if (warned_schema_ids[ii] == rec.schema_id)
+                    break;
+            }
+
+            if (ii == n_warned_schemas)
+            {
+                mctrl_err("warning: statistics captured with metadata %016" PRIx64 " are being "
+                          "decoded with %016" PRIx64 "\n", rec.schema_id, schema_id);
+                warned_schema_ids[n_warned_schemas++] = rec.schema_id;
+            }
+        }
+
+        if (print.format == FORMAT_REGULAR)
+        {
+            mctrl_print("%stimestamp_us: %" PRIu64 "\ncore: %s\n", n_records ? "\n" : "",
+                        rec.timestamp_us, core);
+        }
+        else
+        {
+            bool pprint = (print.format == FORMAT_JSON_PPRINT);
+
+            stats_format_json_reset(&print.fmt, pprint);
+            mctrl_print(pprint ? "{\n    \"timestamp_us\": %" PRIu64 ",\n    \"core\": \"%s\"" :
+                                 "{\"timestamp_us\": %" PRIu64 ",\"core\": \"%s\"",
+                        rec.timestamp_us, core);
+            print.fmt.first = false;
+        }
+
+        morse_stats_decode(mors, resp.stats, len, stats_print_stat, &print);
+
+        if (print.format == FORMAT_JSON)
+            mctrl_print("}\n");
+        else if (print.format == FORMAT_JSON_PPRINT)
+            mctrl_print("\n}\n");
+
+        n_records++;
+    }
+
+    if (ret < 0)
+        mctrl_err("Malformed record in %s after %d records\n", path, n_records);
+
+exit:
+    if (in && !use_stdin)
+        fclose(in);
+    free(selected);
+
+    if (ret < 0)
+        mctrl_err("Command stats_decode error (%d)\n", ret);
+
+    return ret;
+}
+
+MM_CLI_HANDLER(stats_decode, MM_INTF_NOT_REQUIRED, MM_DIRECT_CHIP_SUPPORTED);
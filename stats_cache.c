@@ -0,0 +1,268 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef MORSE_WIN_BUILD
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#endif
+
+#include "stats_cache.h"
+#include "elf_file.h"
+#include "offchip_statistics.h"
+#include "utilities.h"
+
+#ifndef MORSE_WIN_BUILD
+
+/** Magic at the start of a cache file ("MSTC") */
+#define STATS_CACHE_MAGIC           (0x4354534d)
+/** Version of the cache file layout, bump on any change */
+#define STATS_CACHE_VERSION         (1)
+
+/** Header of a cache file, followed by n_stats statistics_offchip_data records */
+struct __attribute__((packed)) stats_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    /** sizeof(struct statistics_offchip_data) when the cache was written */
+    uint32_t record_size;
+    uint32_t n_stats;
+    /** Hash of the canonical firmware path */
+    uint64_t path_hash;
+    /** Firmware file size, modification time and inode the metadata was extracted from */
+    uint64_t fw_size;
+    int64_t fw_mtime_sec;
+    int64_t fw_mtime_nsec;
+    uint64_t fw_dev;
+    uint64_t fw_ino;
+};
+
+/**
+ * @brief Build the expected header for a firmware file.
+ *
+ * @return 0 on success, otherwise -ENOENT if the firmware path cannot be resolved.
+ */
+static int stats_cache_header_init(struct stats_cache_header *hdr, const char *firmware_path,
+                                   const struct stat *st)
+{
+    char real_path[PATH_MAX];
+
+    if (!realpath(firmware_path, real_path))
+        return -ENOENT;
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = STATS_CACHE_MAGIC;
+    hdr->version = STATS_CACHE_VERSION;
+    hdr->record_size = sizeof(struct statistics_offchip_data);
+    hdr->path_hash = hash_fnv1a_64(FNV1A_64_INIT, real_path, strlen(real_path));
+    hdr->fw_size = st->st_size;
+    hdr->fw_mtime_sec = st->st_mtim.tv_sec;
+    hdr->fw_mtime_nsec = st->st_mtim.tv_nsec;
+    hdr->fw_dev = st->st_dev;
+    hdr->fw_ino = st->st_ino;
+
+    return 0;
+}
+
+/**
+ * @brief Get the path of the cache file for a firmware file.
+ *
+ * @return 0 on success, otherwise -ENOENT if the cache is disabled.
+ */
+static int stats_cache_path(const struct stats_cache_header *hdr, char *path, size_t len)
+{
+    const char *dir = getenv(STATS_CACHE_DIR_ENV);
+
+    if (!dir)
+        dir = STATS_CACHE_DEFAULT_DIR;
+
+    if (!strlen(dir))
+        return -ENOENT;
+
+    snprintf(path, len, "%s/stats-%016llx.cache", dir, (unsigned long long)hdr->path_hash);
+    return 0;
+}
+
+/**
+ * @brief Check that the cached records are safe to use in place.
+ *
+ * A cache that was truncated or tampered with must not be able to make the string fields run
+ * past the end of their arrays, or give a format outside the formatting tables.
+ *
+ * @return true if all the strings are terminated and all the formats are known, otherwise false.
+ */
+static bool stats_cache_records_valid(const offchip_stats_t *stats, size_t n_stats)
+{
+    for (size_t ii = 0; ii < n_stats; ii++)
+    {
+        if (!memchr(stats[ii].type_str, '\0', sizeof(stats[ii].type_str)) ||
+            !memchr(stats[ii].name, '\0', sizeof(stats[ii].name)) ||
+            !memchr(stats[ii].key, '\0', sizeof(stats[ii].key)) ||
+            (uint32_t)stats[ii].format > MORSE_STATS_FMT_LAST)
+            return false;
+    }
+
+    return true;
+}
+
+int morse_stats_cache_load(struct morsectrl *mors, const char *firmware_path,
+                           const struct stat *st)
+{
+    struct stats_cache_header expected;
+    struct stats_cache_header *hdr;
+    char path[PATH_MAX];
+    struct stat cache_st;
+    void *map;
+    int fd;
+
+    if (stats_cache_header_init(&expected, firmware_path, st) ||
+        stats_cache_path(&expected, path, sizeof(path)))
+        return -ENOENT;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -ENOENT;
+
+    if (fstat(fd, &cache_st) || cache_st.st_size < (off_t)sizeof(*hdr))
+    {
+        close(fd);
+        return -ENOENT;
+    }
+
+    /* Private and writable, so the table can be used just like one that was extracted */
+    map = mmap(NULL, cache_st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -ENOENT;
+
+    hdr = map;
+    expected.n_stats = hdr->n_stats;
+    if (memcmp(hdr, &expected, sizeof(expected)) ||
+        (uint64_t)cache_st.st_size !=
+            sizeof(*hdr) + (uint64_t)hdr->n_stats * sizeof(struct statistics_offchip_data))
+    {
+        if (mors->debug)
+            mctrl_print("Stale statistics metadata cache %s\n", path);
+        munmap(map, cache_st.st_size);
+        return -ENOENT;
+    }
+
+    if (!stats_cache_records_valid((offchip_stats_t *)(hdr + 1), hdr->n_stats))
+    {
+        if (mors->debug)
+            mctrl_print("Corrupt statistics metadata cache %s\n", path);
+        munmap(map, cache_st.st_size);
+        return -ENOENT;
+    }
+
+    morse_stats_free(mors);
+    mors->stats = (offchip_stats_t *)(hdr + 1);
+    mors->n_stats = hdr->n_stats;
+    mors->stats_map = map;
+    mors->stats_map_len = cache_st.st_size;
+
+    if (mors->debug)
+        mctrl_print("Loaded %zu statistics from cache %s\n", mors->n_stats, path);
+
+    return 0;
+}
+
+void morse_stats_cache_store(const struct morsectrl *mors, const char *firmware_path,
+                             const struct stat *st)
+{
+    struct stats_cache_header hdr;
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX + 16];
+    FILE *outfile;
+    bool ok;
+
+    if (stats_cache_header_init(&hdr, firmware_path, st) ||
+        stats_cache_path(&hdr, path, sizeof(path)))
+        return;
+
+    hdr.n_stats = mors->n_stats;
+
+    /* Write to a temporary file and rename, so a reader never sees a partial cache */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+    outfile = fopen(tmp_path, "wb");
+    if (!outfile)
+    {
+        const char *dir = getenv(STATS_CACHE_DIR_ENV);
+
+        /* The directory may not exist yet */
+        if (mkdir_path(dir ? dir : STATS_CACHE_DEFAULT_DIR) == 0)
+            outfile = fopen(tmp_path, "wb");
+    }
+
+    if (!outfile)
+    {
+        if (mors->debug)
+            mctrl_print("Could not write statistics metadata cache %s\n", path);
+        return;
+    }
+
+    ok = (fwrite(&hdr, sizeof(hdr), 1, outfile) == 1);
+    if (ok && mors->n_stats)
+        ok = (fwrite(mors->stats, sizeof(*mors->stats), mors->n_stats, outfile) == mors->n_stats);
+    ok = (fclose(outfile) == 0) && ok;
+
+    if (!ok || rename(tmp_path, path))
+    {
+        if (mors->debug)
+            mctrl_print("Could not write statistics metadata cache %s\n", path);
+        remove(tmp_path);
+    }
+}
+
+bool morse_stats_cache_unmap(struct morsectrl *mors)
+{
+    if (!mors->stats_map)
+        return false;
+
+    munmap(mors->stats_map, mors->stats_map_len);
+    mors->stats_map = NULL;
+    mors->stats_map_len = 0;
+    mors->stats = NULL;
+    mors->n_stats = 0;
+
+    return true;
+}
+
+#else
+
+int morse_stats_cache_load(struct morsectrl *mors, const char *firmware_path,
+                           const struct stat *st)
+{
+    return -ENOENT;
+}
+
+void morse_stats_cache_store(const struct morsectrl *mors, const char *firmware_path,
+                             const struct stat *st)
+{
+}
+
+bool morse_stats_cache_unmap(struct morsectrl *mors)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Cache of the statistics metadata extracted from firmware ELF files.
+ *
+ * Extracting the metadata means reading and walking the whole firmware image, so the extracted
+ * table is written to a cache file keyed by the firmware path, size, modification time and inode.
+ * Later loads of the same firmware map the cache file directly.
+ *
+ * The cache directory is STATS_CACHE_DEFAULT_DIR unless overridden by the STATS_CACHE_DIR_ENV
+ * environment variable. Setting the variable to an empty string disables the cache. The cache is
+ * not supported on Windows.
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+#include "morsectrl.h"
+
+/** Default directory for the statistics metadata cache */
+#define STATS_CACHE_DEFAULT_DIR     "/var/cache/morse_cli"
+
+/** Environment variable overriding the statistics metadata cache directory */
+#define STATS_CACHE_DIR_ENV         "MORSE_CLI_STATS_CACHE_DIR"
+
+/**
+ * @brief Map the cached statistics metadata of a firmware file, if the cache is valid.
+ *
+ * On success mors->stats points into the mapping, which must be released with
+ * morse_stats_cache_unmap().
+ *
+ * @param mors          Morsectrl context to load the metadata into.
+ * @param firmware_path Path of the firmware file.
+ * @param st            Status of the firmware file.
+ *
+ * @return 0 if the metadata was loaded from the cache, otherwise a negative error code.
+ */
+int morse_stats_cache_load(struct morsectrl *mors, const char *firmware_path,
+                           const struct stat *st);
+
+/**
+ * @brief Write the statistics metadata of a firmware file to the cache.
+ *
+ * Failure to write the cache is not an error; the metadata is extracted again next time.
+ *
+ * @param mors          Morsectrl context holding the metadata.
+ * @param firmware_path Path of the firmware file the metadata was extracted from.
+ * @param st            Status of the firmware file, taken before it was read.
+ */
+void morse_stats_cache_store(const struct morsectrl *mors, const char *firmware_path,
+                             const struct stat *st);
+
+/**
+ * @brief Release metadata loaded by morse_stats_cache_load().
+ *
+ * @param mors  Morsectrl context.
+ *
+ * @return true if the metadata was mapped from the cache and has been released, false if it
+ *         was not loaded from the cache.
+ */
+bool morse_stats_cache_unmap(struct morsectrl *mors);
@@ -21,6 +21,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include "offchip_statistics.h"
 
 /**
@@ -150,11 +151,23 @@ enum format_type
     FORMAT_REGULAR,
     FORMAT_JSON,
     FORMAT_JSON_PPRINT,
+    FORMAT_BINARY,
     /* Add additional formats here  */
 };
 
 
-typedef void (*format_func_t)(const char *key, const uint8_t *buf, uint32_t len);
+/** Formatter state for a single stats invocation, so that the formatters need no global state */
+struct format_ctx {
+    /** Current JSON indentation level */
+    int indent_level;
+    /** Whether JSON output is pretty printed */
+    bool pretty;
+    /** Whether the next statistic is the first in the JSON object */
+    bool first;
+};
+
+typedef void (*format_func_t)(struct format_ctx *ctx, const char *key, const uint8_t *buf,
+                              uint32_t len);
 
 struct format_table {
     format_func_t format_func[MORSE_STATS_FMT_LAST + 1];
@@ -166,5 +179,63 @@ void hexdump(const uint8_t *buf, uint32_t len);
 
 /** JSON format functions  */
 const struct format_table* stats_format_json_get_formatter_table();
-void stats_format_json_init();
-void stats_format_json_set_pprint(bool pprint);
+void stats_format_json_init(struct format_ctx *ctx);
+/** Reset the JSON formatter state ready to print a new object */
+void stats_format_json_reset(struct format_ctx *ctx, bool pprint);
+
+/** Version of the binary statistics record format */
+#define STATS_BINARY_VERSION    (1)
+
+/**
+ * Header of a binary statistics record, all fields little endian. A stream of binary statistics
+ * is a sequence of these, each followed by the raw TLV payload of one stats response.
+ */
+struct PACKED stats_binary_record
+{
+    /** Number of bytes in the record following this field, including the payload */
+    uint32_t len;
+    /** Record format version (STATS_BINARY_VERSION) */
+    uint16_t version;
+    /** Core the statistics were read from (enum morsectrl_stats_core) */
+    uint16_t core;
+    /** Time the statistics were read, in us since the Unix epoch */
+    uint64_t timestamp_us;
+    /** Schema id of the metadata needed to decode the payload, see morse_stats_schema_id() */
+    uint64_t schema_id;
+    /** TLV payload of the stats response */
+    uint8_t payload[];
+};
+
+/** Binary format functions  */
+/** Prepare a stream for binary statistics records */
+void stats_format_binary_init(FILE *out);
+
+/**
+ * @brief Write a binary statistics record.
+ *
+ * @param out           Stream to write to
+ * @param core          Core the statistics were read from (enum morsectrl_stats_core)
+ * @param timestamp_us  Time the statistics were read, in us since the Unix epoch
+ * @param schema_id     Schema id of the statistics metadata
+ * @param payload       TLV payload of the stats response
+ * @param len           Length of the payload
+ *
+ * @return              0 on success, -1 if the stream could not be written
+ */
+int stats_format_binary_write(FILE *out, uint16_t core, uint64_t timestamp_us,
+                              uint64_t schema_id, const uint8_t *payload, uint32_t len);
+
+/**
+ * @brief Read a binary statistics record written by stats_format_binary_write().
+ *
+ * @param in            Stream to read from
+ * @param[out] rec      Header of the record, converted to host byte order
+ * @param[out] payload  Buffer for the TLV payload
+ * @param size          Size of the payload buffer
+ * @param[out] len      Length of the payload
+ *
+ * @return              1 if a record was read, 0 at the end of the stream, or -1 if the record is
+ *                      truncated, of an unsupported version or too large for the buffer
+ */
+int stats_format_binary_read(FILE *in, struct stats_binary_record *rec, uint8_t *payload,
+                             size_t size, uint32_t *len);
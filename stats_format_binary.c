@@ -0,0 +1,88 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#ifdef MORSE_WIN_BUILD
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "portable_endian.h"
+#include "command.h"
+#include "stats_format.h"
+
+void stats_format_binary_init(FILE *out)
+{
+#ifdef MORSE_WIN_BUILD
+    /* Stop the C runtime translating newline bytes in the records */
+    _setmode(_fileno(out), _O_BINARY);
+#else
+    (void)out;
+#endif
+}
+
+int stats_format_binary_write(FILE *out, uint16_t core, uint64_t timestamp_us,
+                              uint64_t schema_id, const uint8_t *payload, uint32_t len)
+{
+    struct stats_binary_record rec = {
+        .len = htole32(sizeof(rec) - sizeof(rec.len) + len),
+        .version = htole16(STATS_BINARY_VERSION),
+        .core = htole16(core),
+        .timestamp_us = htole64(timestamp_us),
+        .schema_id = htole64(schema_id),
+    };
+
+    if (fwrite(&rec, sizeof(rec), 1, out) != 1)
+        return -1;
+
+    if (len && fwrite(payload, len, 1, out) != 1)
+        return -1;
+
+    return 0;
+}
+
+int stats_format_binary_read(FILE *in, struct stats_binary_record *rec, uint8_t *payload,
+                             size_t size, uint32_t *len)
+{
+    size_t n = fread(rec, 1, sizeof(*rec), in);
+
+    if (n == 0 && feof(in))
+        return 0;
+
+    if (n != sizeof(*rec))
+        return -1;
+
+    rec->len = le32toh(rec->len);
+    rec->version = le16toh(rec->version);
+    rec->core = le16toh(rec->core);
+    rec->timestamp_us = le64toh(rec->timestamp_us);
+    rec->schema_id = le64toh(rec->schema_id);
+
+    if (rec->version != STATS_BINARY_VERSION || rec->len < sizeof(*rec) - sizeof(rec->len))
+        return -1;
+
+    *len = rec->len - (sizeof(*rec) - sizeof(rec->len));
+    if (*len > size)
+        return -1;
+
+    if (*len && fread(payload, *len, 1, in) != 1)
+        return -1;
+
+    return 1;
+}
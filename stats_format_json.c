@@ -34,15 +34,12 @@
 #define SPACES_PER_INDENT 4
 #define INDENT_FIRST_LEVEL 1
 
-static int indent_level;
-static bool pretty;
-
 /** Print wrapper function to prepend additional indentation*/
-static void printf_indent(char* format, ...)
+static void printf_indent(struct format_ctx *ctx, char* format, ...)
 {
-    if (pretty)
+    if (ctx->pretty)
     {
-        mctrl_print("%*s", indent_level * SPACES_PER_INDENT, "");
+        mctrl_print("%*s", ctx->indent_level * SPACES_PER_INDENT, "");
     }
 
     va_list args;
@@ -53,24 +50,24 @@ static void printf_indent(char* format, ...)
 
 
 /** JSON formatting functions for morsectrl statistics */
-static void print_dec(const char *key, const uint8_t *buf, uint32_t len)
+static void print_dec(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     int64_t n = get_signed_value_as_int64(buf, len);
-    printf_indent("\"%s\": %lld", key, n);
+    printf_indent(ctx, "\"%s\": %lld", key, n);
 }
 
 
-static void print_udec(const char *key, const uint8_t *buf, uint32_t len)
+static void print_udec(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     uint64_t n = get_unsigned_value_as_uint64(buf, len);
-    printf_indent("\"%s\": %llu", key, n);
+    printf_indent(ctx, "\"%s\": %llu", key, n);
 }
 
 
-static void print_ampdu_aggregates(const char *key, const uint8_t *buf, uint32_t len)
+static void print_ampdu_aggregates(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     ampdu_count_t *count = (ampdu_count_t *)buf;
-    printf_indent("\"%s\": ", key);
+    printf_indent(ctx, "\"%s\": ", key);
     mctrl_print("\"");
     for (int i = 0; i < MORSE_ARRAY_SIZE(count->count); i++)
     {
@@ -80,10 +77,10 @@ static void print_ampdu_aggregates(const char *key, const uint8_t *buf, uint32_t
 }
 
 
-static void print_ampdu_bitmap(const char *key, const uint8_t *buf, uint32_t len)
+static void print_ampdu_bitmap(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     ampdu_bitmap_t *bitmap = (ampdu_bitmap_t *)buf;
-    printf_indent("\"%s\": ", key);
+    printf_indent(ctx, "\"%s\": ", key);
     mctrl_print("\"");
     for (int i = 0; i < MORSE_ARRAY_SIZE(bitmap->bitmap); i++)
     {
@@ -93,7 +90,7 @@ static void print_ampdu_bitmap(const char *key, const uint8_t *buf, uint32_t len
 }
 
 
-static void print_txop(const char *key, const uint8_t *buf, uint32_t len)
+static void print_txop(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     struct txop_statistics *txop_stats = (struct txop_statistics *)buf;
     uint32_t duration_avg = 0, packets_avg = 0;
@@ -103,102 +100,102 @@ static void print_txop(const char *key, const uint8_t *buf, uint32_t len)
         packets_avg = (uint32_t)(txop_stats->pkts / txop_stats->count);
         duration_avg = (uint32_t)(txop_stats->duration / txop_stats->count);
     }
-    char* terminator = pretty ? "\n" : "";
+    char* terminator = ctx->pretty ? "\n" : "";
 
-    printf_indent("\"%s\": ", key);
+    printf_indent(ctx, "\"%s\": ", key);
     mctrl_print("%s", terminator);
-    printf_indent("{%s", terminator);
-    indent_level++;
+    printf_indent(ctx, "{%s", terminator);
+    ctx->indent_level++;
 
-    printf_indent("\"TXOP count\": %lu,%s", txop_stats->count, terminator);
-    printf_indent("\"Total TXOP time\": %llu,%s", txop_stats->duration, terminator);
-    printf_indent("\"Average TXOP time\": %lu,%s", duration_avg, terminator);
-    printf_indent("\"Total TXOP Tx packets\": %lu,%s", txop_stats->pkts, terminator);
-    printf_indent("\"Average TXOP Tx packets\": %lu%s", packets_avg, terminator);
+    printf_indent(ctx, "\"TXOP count\": %lu,%s", txop_stats->count, terminator);
+    printf_indent(ctx, "\"Total TXOP time\": %llu,%s", txop_stats->duration, terminator);
+    printf_indent(ctx, "\"Average TXOP time\": %lu,%s", duration_avg, terminator);
+    printf_indent(ctx, "\"Total TXOP Tx packets\": %lu,%s", txop_stats->pkts, terminator);
+    printf_indent(ctx, "\"Average TXOP Tx packets\": %lu%s", packets_avg, terminator);
 
     mctrl_print("%s", terminator);
-    indent_level--;
-    printf_indent("}");
+    ctx->indent_level--;
+    printf_indent(ctx, "}");
 }
 
 
-static void print_pageset(const char *key, const uint8_t *buf, uint32_t len)
+static void print_pageset(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     struct pageset_stats *pageset = (struct pageset_stats *)buf;
-    char* terminator = pretty ? "\n" : "";
+    char* terminator = ctx->pretty ? "\n" : "";
 
-    printf_indent("\"%s\": ", key);
+    printf_indent(ctx, "\"%s\": ", key);
     mctrl_print("%s", terminator);
-    printf_indent("[%s", terminator);
-    indent_level++;
+    printf_indent(ctx, "[%s", terminator);
+    ctx->indent_level++;
 
     for (int i = 0; i < NUM_PAGESETS; i++)
     {
         if (i) mctrl_print(",%s", terminator);
 
-        printf_indent("{%s", terminator);
-        indent_level++;
+        printf_indent(ctx, "{%s", terminator);
+        ctx->indent_level++;
 
-        printf_indent("\"Pageset\": %d,%s", i, terminator);
-        printf_indent("\"allocated\": %d,%s", pageset->pages_allocated[i], terminator);
-        printf_indent("\"total\": %d%s", pageset->pages_to_allocate[i], terminator);
+        printf_indent(ctx, "\"Pageset\": %d,%s", i, terminator);
+        printf_indent(ctx, "\"allocated\": %d,%s", pageset->pages_allocated[i], terminator);
+        printf_indent(ctx, "\"total\": %d%s", pageset->pages_to_allocate[i], terminator);
 
-        indent_level--;
-        printf_indent("}");
+        ctx->indent_level--;
+        printf_indent(ctx, "}");
     }
 
-    indent_level--;
+    ctx->indent_level--;
     mctrl_print("%s", terminator);
-    printf_indent("]");
+    printf_indent(ctx, "]");
 }
 
 
-static void print_retries(const char *key, const uint8_t *buf, uint32_t len)
+static void print_retries(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     struct retry_stats *retries = (struct retry_stats *)buf;
-    char *terminator = pretty ? "\n" : "";
+    char *terminator = ctx->pretty ? "\n" : "";
 
-    printf_indent("\"%s\": ", key);
+    printf_indent(ctx, "\"%s\": ", key);
     mctrl_print("%s", terminator);
-    printf_indent("[%s", terminator);
-    indent_level++;
+    printf_indent(ctx, "[%s", terminator);
+    ctx->indent_level++;
 
     for (int i = 0; i < APP_STATS_COUNT; i++)
     {
         if (i) mctrl_print(",%s", terminator);
-        printf_indent("{%s", terminator);
-        indent_level++;
+        printf_indent(ctx, "{%s", terminator);
+        ctx->indent_level++;
         uint32_t count = retries->count[i];
         uint32_t avg_time = retries->count[i] ?
             (uint32_t)(retries->sum[i]/retries->count[i]) : 0;
 
-        printf_indent("\"Retry\": %d,%s", i, terminator);
-        printf_indent("\"Count\": %lu,%s", count, terminator);
-        printf_indent("\"Avg Time\": %lu%s", avg_time, terminator);
-        indent_level--;
-        printf_indent("}");
+        printf_indent(ctx, "\"Retry\": %d,%s", i, terminator);
+        printf_indent(ctx, "\"Count\": %lu,%s", count, terminator);
+        printf_indent(ctx, "\"Avg Time\": %lu%s", avg_time, terminator);
+        ctx->indent_level--;
+        printf_indent(ctx, "}");
     }
-    indent_level--;
+    ctx->indent_level--;
     mctrl_print("%s", terminator);
-    printf_indent("]");
+    printf_indent(ctx, "]");
 }
 
 
-static void print_raw(const char *key, const uint8_t *buf, uint32_t len)
+static void print_raw(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     raw_stats_t *raw_stats = (raw_stats_t *)buf;
-    char* terminator = pretty ? "\n" : "";
+    char* terminator = ctx->pretty ? "\n" : "";
 
-    printf_indent("\"%s\": ", key);
+    printf_indent(ctx, "\"%s\": ", key);
     mctrl_print("%s", terminator);
-    printf_indent("{%s", terminator);
-    indent_level++;
+    printf_indent(ctx, "{%s", terminator);
+    ctx->indent_level++;
 
-    printf_indent("\"RAW Assignments\": %s", terminator);
-    printf_indent("{%s", terminator);
-    indent_level++;
+    printf_indent(ctx, "\"RAW Assignments\": %s", terminator);
+    printf_indent(ctx, "{%s", terminator);
+    ctx->indent_level++;
 
-    printf_indent("\"Valid\": \"");
+    printf_indent(ctx, "\"Valid\": \"");
 
     for (uint8_t i = 0; i < MORSE_ARRAY_SIZE(raw_stats->assignments); i++)
     {
@@ -206,141 +203,141 @@ static void print_raw(const char *key, const uint8_t *buf, uint32_t len)
     }
     mctrl_print("\",%s", terminator);
 
-    printf_indent("\"Truncated by tbtt\": %ld,%s",
+    printf_indent(ctx, "\"Truncated by tbtt\": %ld,%s",
         raw_stats->assignments_truncated_from_tbtt, terminator);
-    printf_indent("\"Invalid\": %ld,%s", raw_stats->invalid_assignments, terminator);
-    printf_indent("\"Already past\": %ld%s", raw_stats->already_past_assignment, terminator);
-
-    indent_level--;
-    printf_indent("},%s", terminator);
-    printf_indent("\"Delayed due to RAW\": %s", terminator);
-    printf_indent("{%s", terminator);
-    indent_level++;
-
-    printf_indent("\"From aci queue\": %ld,%s", raw_stats->aci_frames_delayed, terminator);
-    printf_indent("\"From bc/mc queue\": %ld,%s", raw_stats->bc_mc_frames_delayed, terminator);
-    printf_indent("\"From abs time queue\": %ld,%s",
+    printf_indent(ctx, "\"Invalid\": %ld,%s", raw_stats->invalid_assignments, terminator);
+    printf_indent(ctx, "\"Already past\": %ld%s", raw_stats->already_past_assignment, terminator);
+
+    ctx->indent_level--;
+    printf_indent(ctx, "},%s", terminator);
+    printf_indent(ctx, "\"Delayed due to RAW\": %s", terminator);
+    printf_indent(ctx, "{%s", terminator);
+    ctx->indent_level++;
+
+    printf_indent(ctx, "\"From aci queue\": %ld,%s", raw_stats->aci_frames_delayed, terminator);
+    printf_indent(ctx, "\"From bc/mc queue\": %ld,%s", raw_stats->bc_mc_frames_delayed, terminator);
+    printf_indent(ctx, "\"From abs time queue\": %ld,%s",
         raw_stats->abs_frames_delayed, terminator);
-    printf_indent("\"Frame crosses slot\": %ld%s",
+    printf_indent(ctx, "\"Frame crosses slot\": %ld%s",
         raw_stats->frame_crosses_slot_delayed, terminator);
 
-    indent_level--;
-    printf_indent("}%s", terminator);
+    ctx->indent_level--;
+    printf_indent(ctx, "}%s", terminator);
 
-    indent_level--;
-    printf_indent("}");
+    ctx->indent_level--;
+    printf_indent(ctx, "}");
 }
 
 
-static void print_calibration(const char *key, const uint8_t *buf, uint32_t len)
+static void print_calibration(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     managed_calibration_stats_t *calib_stats = (managed_calibration_stats_t *)buf;
-    char* terminator = pretty ? "\n" : "";
+    char* terminator = ctx->pretty ? "\n" : "";
 
-    printf_indent("\"%s\": ", key);
+    printf_indent(ctx, "\"%s\": ", key);
     mctrl_print("%s", terminator);
-    printf_indent("{%s", terminator);
-    indent_level++;
+    printf_indent(ctx, "{%s", terminator);
+    ctx->indent_level++;
 
-    printf_indent("\"Manged Calibration\": %s", terminator);
-    printf_indent("{%s", terminator);
-    indent_level++;
+    printf_indent(ctx, "\"Manged Calibration\": %s", terminator);
+    printf_indent(ctx, "{%s", terminator);
+    ctx->indent_level++;
 
-    printf_indent("\"Quiet calibration granted\": %ld,%s",
+    printf_indent(ctx, "\"Quiet calibration granted\": %ld,%s",
             calib_stats->quiet_calibration_granted, terminator);
-    printf_indent("\"Quiet calibration rejected\": %ld,%s",
+    printf_indent(ctx, "\"Quiet calibration rejected\": %ld,%s",
             calib_stats->quiet_calibration_rejected, terminator);
-    printf_indent("\"Quiet calibration cancelled\": %ld,%s",
+    printf_indent(ctx, "\"Quiet calibration cancelled\": %ld,%s",
             calib_stats->quiet_calibration_cancelled, terminator);
-    printf_indent("\"Non-Quiet calibration granted\": %ld,%s",
+    printf_indent(ctx, "\"Non-Quiet calibration granted\": %ld,%s",
             calib_stats->non_quiet_calibration_granted, terminator);
-    printf_indent("\"Calibration complete\": %ld%s", calib_stats->calibration_complete,
+    printf_indent(ctx, "\"Calibration complete\": %ld%s", calib_stats->calibration_complete,
             terminator);
 
-    indent_level--;
-    printf_indent("}%s", terminator);
-    indent_level--;
-    printf_indent("}");
+    ctx->indent_level--;
+    printf_indent(ctx, "}%s", terminator);
+    ctx->indent_level--;
+    printf_indent(ctx, "}");
 }
 
 
-static void print_duty_cycle(const char *key, const uint8_t *buf, uint32_t len)
+static void print_duty_cycle(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     duty_cycle_stats_t *duty_cycle_stats = (duty_cycle_stats_t*)buf;
-    char* terminator = pretty ? "\n" : "";
+    char* terminator = ctx->pretty ? "\n" : "";
 
-    printf_indent("\"%s\": ", key);
+    printf_indent(ctx, "\"%s\": ", key);
     mctrl_print("%s", terminator);
-    printf_indent("{%s", terminator);
-    indent_level++;
+    printf_indent(ctx, "{%s", terminator);
+    ctx->indent_level++;
 
     /* Duty Cycle Body*/
-    printf_indent("\"Duty Cycle Target (%%)\": %d.%02d,%s",
+    printf_indent(ctx, "\"Duty Cycle Target (%%)\": %d.%02d,%s",
                   duty_cycle_stats->target_duty_cycle / 100,
                   duty_cycle_stats->target_duty_cycle % 100,
                   terminator);
-    printf_indent("\"Duty Cycle TX On (us)\": %llu,%s",
+    printf_indent(ctx, "\"Duty Cycle TX On (us)\": %llu,%s",
                   duty_cycle_stats->total_t_air,
                   terminator);
-    printf_indent("\"Duty Cycle TX Off (Blocked) (us)\": %llu,%s",
+    printf_indent(ctx, "\"Duty Cycle TX Off (Blocked) (us)\": %llu,%s",
                   duty_cycle_stats->total_t_off,
                   terminator);
-    printf_indent("\"Duty Cycle Max toff (us)\": %llu,%s",
+    printf_indent(ctx, "\"Duty Cycle Max toff (us)\": %llu,%s",
                   duty_cycle_stats->max_t_off,
                   terminator);
-    printf_indent("\"Duty Cycle Early Frames\": %u%s",
+    printf_indent(ctx, "\"Duty Cycle Early Frames\": %u%s",
                   duty_cycle_stats->num_early,
                   terminator);
 
-    indent_level--;
-    printf_indent("}");
+    ctx->indent_level--;
+    printf_indent(ctx, "}");
 }
 
 
-static void print_mac_state(const char *key, const uint8_t *buf, uint32_t len)
+static void print_mac_state(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     uint64_t mac_state;
     memcpy(&mac_state, buf, sizeof(mac_state));
-    char* terminator = pretty ? "\n" : "";
+    char* terminator = ctx->pretty ? "\n" : "";
 
-    printf_indent("\"%s\": ", key);
+    printf_indent(ctx, "\"%s\": ", key);
     mctrl_print("%s", terminator);
-    printf_indent("{%s", terminator);
-    indent_level++;
+    printf_indent(ctx, "{%s", terminator);
+    ctx->indent_level++;
 
-    printf_indent("\"%s\": %lld,%s", "RX state",
+    printf_indent(ctx, "\"%s\": %lld,%s", "RX state",
         BMGET(mac_state, ENCODE_MAC_STATE_RX_STATE), terminator);
-    printf_indent("\"%s\": %lld,%s", "TX state",
+    printf_indent(ctx, "\"%s\": %lld,%s", "TX state",
         BMGET(mac_state, ENCODE_MAC_STATE_TX_STATE), terminator);
-    printf_indent("\"%s\": %lld,%s", "Channel config",
+    printf_indent(ctx, "\"%s\": %lld,%s", "Channel config",
         BMGET(mac_state, ENCODE_MAC_STATE_CHANNEL_CONFIG), terminator);
-    printf_indent("\"%s\": %lld,%s", "Managed calibration state",
+    printf_indent(ctx, "\"%s\": %lld,%s", "Managed calibration state",
         BMGET(mac_state, ENCODE_MAC_STATE_MGD_CALIB_STATE), terminator);
-    printf_indent("\"%s\": %lld,%s", "Powersave enabled",
+    printf_indent(ctx, "\"%s\": %lld,%s", "Powersave enabled",
         BMGET(mac_state, ENCODE_MAC_STATE_PS_EN), terminator);
-    printf_indent("\"%s\": %lld,%s", "Dynamic powersave offload enabled",
+    printf_indent(ctx, "\"%s\": %lld,%s", "Dynamic powersave offload enabled",
         BMGET(mac_state, ENCODE_MAC_STATE_DYN_PS_OFFLOAD_EN), terminator);
-    printf_indent("\"%s\": %lld,%s", "STA PS state",
+    printf_indent(ctx, "\"%s\": %lld,%s", "STA PS state",
         BMGET(mac_state, ENCODE_MAC_STATE_STA_PS_STATE), terminator);
-    printf_indent("\"%s\": %lld,%s", "Is waiting on dynamic powersave timeout",
+    printf_indent(ctx, "\"%s\": %lld,%s", "Is waiting on dynamic powersave timeout",
         BMGET(mac_state, ENCODE_MAC_STATE_WAITING_ON_DYN_PS), terminator);
-    printf_indent("\"%s\": %lld,%s", "TX blocked by host cmd",
+    printf_indent(ctx, "\"%s\": %lld,%s", "TX blocked by host cmd",
         BMGET(mac_state, ENCODE_MAC_STATE_TX_BLOCKED), terminator);
-    printf_indent("\"%s\": %lld,%s", "Is waiting for medium sync",
+    printf_indent(ctx, "\"%s\": %lld,%s", "Is waiting for medium sync",
         BMGET(mac_state, ENCODE_MAC_STATE_WAITING_MED_SYNC), terminator);
-    printf_indent("\"%s\": %lld%s", "N packets in QoS queues",
+    printf_indent(ctx, "\"%s\": %lld%s", "N packets in QoS queues",
         BMGET(mac_state, ENCODE_MAC_STATE_N_PKTS_IN_QUEUES), terminator);
 
-    indent_level--;
-    printf_indent("}");
+    ctx->indent_level--;
+    printf_indent(ctx, "}");
 }
 
 
 
 
-static void print_default(const char *key, const uint8_t *buf, uint32_t len)
+static void print_default(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
-    printf_indent("\"%s\": ", key);
+    printf_indent(ctx, "\"%s\": ", key);
     mctrl_print("\"");
     for (int i = 0; i < len; i++)
     {
@@ -385,23 +382,24 @@ const struct format_table* stats_format_json_get_formatter_table()
 }
 
 
-void stats_format_json_init()
+void stats_format_json_init(struct format_ctx *ctx)
 {
-    indent_level = INDENT_FIRST_LEVEL;
+    ctx->indent_level = INDENT_FIRST_LEVEL;
 
-    static bool first = true;
-    if (first)
+    if (ctx->first)
     {
-        first = false;
+        ctx->first = false;
     }
     else
     {
-        pretty ? mctrl_print(",\n") : mctrl_print(",");
+        ctx->pretty ? mctrl_print(",\n") : mctrl_print(",");
     }
 }
 
 
-void stats_format_json_set_pprint(bool pprint)
+void stats_format_json_reset(struct format_ctx *ctx, bool pprint)
 {
-    pretty = pprint;
+    ctx->indent_level = INDENT_FIRST_LEVEL;
+    ctx->pretty = pprint;
+    ctx->first = true;
 }
@@ -31,31 +31,31 @@
 
 /** Regular formatting functions for morsectrl statistics */
 
-static void print_dec(const char *key, const uint8_t *buf, uint32_t len)
+static void print_dec(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     mctrl_print("%s:%" PRId64 "\n", key, get_signed_value_as_int64(buf, len));
 }
 
 
-static void print_udec(const char *key, const uint8_t *buf, uint32_t len)
+static void print_udec(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     mctrl_print("%s: %" PRIu64 "\n", key, get_unsigned_value_as_uint64(buf, len));
 }
 
 
-static void print_hex(const char *key, const uint8_t *buf, uint32_t len)
+static void print_hex(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     mctrl_print("%s: 0x%" PRIx64 "\n", key, get_unsigned_value_as_uint64(buf, len));
 }
 
 
-static void print_0hex(const char *key, const uint8_t *buf, uint32_t len)
+static void print_0hex(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     mctrl_print("%s: 0x%0*" PRIx64 "\n", key, len * 2, get_unsigned_value_as_uint64(buf, len));
 }
 
 
-static void print_ampdu_aggregates(const char *key, const uint8_t *buf, uint32_t len)
+static void print_ampdu_aggregates(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     ampdu_count_t *count = (ampdu_count_t *)buf;
     mctrl_print("%s: ", key);
@@ -67,7 +67,7 @@ static void print_ampdu_aggregates(const char *key, const uint8_t *buf, uint32_t
 }
 
 
-static void print_ampdu_bitmap(const char *key, const uint8_t *buf, uint32_t len)
+static void print_ampdu_bitmap(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     ampdu_bitmap_t *bitmap = (ampdu_bitmap_t *)buf;
     mctrl_print("%s: ", key);
@@ -79,7 +79,7 @@ static void print_ampdu_bitmap(const char *key, const uint8_t *buf, uint32_t len
 }
 
 
-static void print_txop(const char *key, const uint8_t *buf, uint32_t len)
+static void print_txop(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     struct txop_statistics *txop_stats = (struct txop_statistics *)buf;
     uint32_t duration_avg = 0, packets_avg = 0;
@@ -99,7 +99,7 @@ static void print_txop(const char *key, const uint8_t *buf, uint32_t len)
 }
 
 
-static void print_pageset(const char *key, const uint8_t *buf, uint32_t len)
+static void print_pageset(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     struct pageset_stats *pageset = (struct pageset_stats *)buf;
 
@@ -113,7 +113,7 @@ static void print_pageset(const char *key, const uint8_t *buf, uint32_t len)
 }
 
 
-static void print_retries(const char *key, const uint8_t *buf, uint32_t len)
+static void print_retries(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     struct retry_stats *retries = (struct retry_stats *)buf;
     mctrl_print("%s: \n", key);
@@ -128,7 +128,7 @@ static void print_retries(const char *key, const uint8_t *buf, uint32_t len)
 }
 
 
-static void print_raw(const char *key, const uint8_t *buf, uint32_t len)
+static void print_raw(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     raw_stats_t *raw_stats = (raw_stats_t *)buf;
     mctrl_print("%s: \n", key);
@@ -150,7 +150,7 @@ static void print_raw(const char *key, const uint8_t *buf, uint32_t len)
 }
 
 
-static void print_calibration(const char *key, const uint8_t *buf, uint32_t len)
+static void print_calibration(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     managed_calibration_stats_t *calib_stats = (managed_calibration_stats_t *)buf;
     mctrl_print("%s: \n", key);
@@ -167,7 +167,7 @@ static void print_calibration(const char *key, const uint8_t *buf, uint32_t len)
 }
 
 
-static void print_duty_cycle(const char *key, const uint8_t *buf, uint32_t len)
+static void print_duty_cycle(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     duty_cycle_stats_t *duty_cycle_stats = (duty_cycle_stats_t *)buf;
     mctrl_print("%s: \n", key);
@@ -181,7 +181,7 @@ static void print_duty_cycle(const char *key, const uint8_t *buf, uint32_t len)
 }
 
 
-static void print_mac_state(const char *key, const uint8_t *buf, uint32_t len)
+static void print_mac_state(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     uint64_t mac_state;
     const uint8_t desc_len = 39;
@@ -214,7 +214,7 @@ static void print_mac_state(const char *key, const uint8_t *buf, uint32_t len)
 
 
 
-static void print_default(const char *key, const uint8_t *buf, uint32_t len)
+static void print_default(struct format_ctx *ctx, const char *key, const uint8_t *buf, uint32_t len)
 {
     /* Not implemented prior, use default hexdump in previous switch statement */
     mctrl_print("%s :", key);
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command.h"
+#include "utilities.h"
+
+/** Default number of frames to exchange */
+#define THROUGHPUT_DEFAULT_COUNT        (1000)
+/** Default padding added to each command */
+#define THROUGHPUT_DEFAULT_SIZE         (256)
+/** Largest padding that may be added to a command */
+#define THROUGHPUT_MAX_SIZE             (1500)
+
+static struct
+{
+    struct arg_int *count;
+    struct arg_int *size;
+} args;
+
+int throughput_init(struct morsectrl *mors, struct mm_argtable *mm_args)
+{
+    MM_INIT_ARGTABLE(mm_args,
+                     "Measure the command throughput of the transport by exchanging health check "
+                     "frames with the firmware",
+                     args.count = arg_int0("n", "count", "<frames>",
+                                           "number of frames to send (default 1000)"),
+                     args.size = arg_int0("s", "size", "<octets>",
+                                          "octets of padding added to each command, "
+                                          "up to 1500 (default 256)"));
+    return 0;
+}
+
+int throughput(struct morsectrl *mors, int argc, char *argv[])
+{
+    int count = args.count->count ? args.count->ival[0] : THROUGHPUT_DEFAULT_COUNT;
+    int size = args.size->count ? args.size->ival[0] : THROUGHPUT_DEFAULT_SIZE;
+    struct morsectrl_transport_buff *cmd_tbuff;
+    struct morsectrl_transport_buff *rsp_tbuff;
+    uint64_t octets = 0;
+    uint64_t start_us;
+    uint64_t elapsed_us;
+    int ret = -1;
+    int ii;
+
+    if (count <= 0)
+    {
+        mctrl_err("Invalid frame count %d\n", count);
+        return -1;
+    }
+
+    if (size < 0 || size > THROUGHPUT_MAX_SIZE)
+    {
+        mctrl_err("Invalid size %d, must be 0 - %d\n", size, THROUGHPUT_MAX_SIZE);
+        return -1;
+    }
+
+    cmd_tbuff = morsectrl_transport_cmd_alloc(mors->transport, size);
+    rsp_tbuff = morsectrl_transport_resp_alloc(mors->transport, 0);
+
+    if (!cmd_tbuff || !rsp_tbuff)
+        goto exit;
+
+    start_us = time_monotonic_us();
+
+    for (ii = 0; ii < count; ii++)
+    {
+        ret = morsectrl_send_command(mors->transport, MORSE_COMMAND_HEALTH_CHECK,
+                                     cmd_tbuff, rsp_tbuff);
+        if (ret)
+        {
+            mctrl_err("Frame %d failed\n", ii);
+            goto exit;
+        }
+
+        octets += cmd_tbuff->data_len + rsp_tbuff->data_len;
+    }
+
+    elapsed_us = MAX(time_monotonic_us() - start_us, (uint64_t)1);
+
+    mctrl_print("%d frames of %zu octets in %.3f s\n", count, cmd_tbuff->data_len,
+                elapsed_us / 1000000.0);
+    mctrl_print("%.1f frames/s, %.0f octets/s (commands and responses)\n",
+                (count * 1000000.0) / elapsed_us, (octets * 1000000.0) / elapsed_us);
+
+exit:
+    if (ret < 0)
+        mctrl_err("Command throughput error (%d)\n", ret);
+
+    morsectrl_transport_buff_free(cmd_tbuff);
+    morsectrl_transport_buff_free(rsp_tbuff);
+    return ret;
+}
+
+MM_CLI_HANDLER(throughput, MM_INTF_REQUIRED, MM_DIRECT_CHIP_SUPPORTED);
@@ -0,0 +1,641 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command.h"
+#include "utilities.h"
+#include "transport/trace.h"
+
+/** Default number of slowest calls listed by trace_report */
+#define TRACE_REPORT_DEFAULT_SLOWEST    (10)
+/** Largest number of slowest calls that trace_report can list */
+#define TRACE_REPORT_MAX_SLOWEST        (1000)
+/** Size of the response buffer when replaying a command whose traced response is unknown */
+#define TRACE_REPLAY_RESP_SIZE          (2048)
+/** Number of submitted commands that can wait for their response to be seen while replaying */
+#define TRACE_REPLAY_MAX_PENDING        (64)
+
+static struct
+{
+    struct arg_str *trace;
+    struct arg_int *slowest;
+} report_args;
+
+static struct
+{
+    struct arg_str *trace;
+} replay_args;
+
+/** Latencies of the calls of one kind in a trace */
+struct trace_report_row
+{
+    /** Record type, TRACE_RECORD_COMMAND for commands whether submitted or sent */
+    uint16_t type;
+    /** Message ID of commands, otherwise 0 */
+    uint16_t message_id;
+    /** Number of calls that failed */
+    uint32_t errors;
+    /** Octets transferred by the calls */
+    uint64_t octets;
+    /** Time taken by each call */
+    uint64_t *latencies;
+    /** Number of entries in latencies */
+    size_t n_latencies;
+    /** Number of entries allocated for latencies */
+    size_t capacity;
+};
+
+/** A call listed amongst the slowest in a trace */
+struct trace_report_call
+{
+    /** Time the call started, in us since the trace started */
+    uint64_t start_us;
+    /** Time taken by the call */
+    uint64_t latency_us;
+    /** Record type */
+    uint16_t type;
+    /** Message ID of commands, otherwise 0 */
+    uint16_t message_id;
+    /** Address of register and memory accesses, otherwise 0 */
+    uint32_t addr;
+    /** Result of the call */
+    int32_t status;
+};
+
+/** Calls seen in a trace, grouped into rows */
+struct trace_report
+{
+    /** One row for each kind of call */
+    struct trace_report_row *rows;
+    /** Number of entries in rows */
+    size_t n_rows;
+    /** The slowest calls, slowest first */
+    struct trace_report_call *slowest;
+    /** Number of entries in slowest */
+    size_t n_slowest;
+    /** Maximum number of entries in slowest */
+    size_t max_slowest;
+    /** Time the last call returned */
+    uint64_t end_us;
+};
+
+/** A submitted command waiting for its response to be seen while replaying */
+struct trace_replay_pending
+{
+    /** Tag the command was submitted with */
+    uint16_t tag;
+    /** Message ID of the command */
+    uint16_t message_id;
+    /** Payload of the command, excluding its header */
+    uint8_t *payload;
+    /** Length of the payload */
+    size_t len;
+};
+
+int trace_report_init(struct morsectrl *mors, struct mm_argtable *mm_args)
+{
+    MM_INIT_ARGTABLE(mm_args,
+                     "Summarise the latency of each command and chip access in a trace recorded "
+                     "with --trace",
+                     report_args.trace = arg_str1(NULL, NULL, "<trace>", "trace file to read"),
+                     report_args.slowest = arg_int0("n", "slowest", "<calls>",
+                                                    "number of slowest calls to list "
+                                                    "(default 10)"));
+    return 0;
+}
+
+int trace_replay_init(struct morsectrl *mors, struct mm_argtable *mm_args)
+{
+    MM_INIT_ARGTABLE(mm_args,
+                     "Send the commands in a trace recorded with --trace again and compare their "
+                     "latency and status with the trace. Chip accesses are not replayed.",
+                     replay_args.trace = arg_str1(NULL, NULL, "<trace>", "trace file to replay"));
+    return 0;
+}
+
+/**
+ * @brief Get the row of a trace report for a kind of call, adding it if needed.
+ *
+ * @param report        The report.
+ * @param type          Record type of the call.
+ * @param message_id    Message ID of a command, otherwise 0.
+ *
+ * @return              The row, or NULL if it could not be added.
+ */
+static struct trace_report_row *trace_report_row(struct trace_report *report, uint16_t type,
+                                                 uint16_t message_id)
+{
+    struct trace_report_row *rows;
+
+    for (size_t i = 0; i < report->n_rows; i++)
+    {
+        if (report->rows[i].type == type && report->rows[i].message_id == message_id)
+            return &report->rows[i];
+    }
+
+    rows = realloc(report->rows, (report->n_rows + 1) * sizeof(*rows));
+    if (!rows)
+        return NULL;
+
+    report->rows = rows;
+    memset(&rows[report->n_rows], 0, sizeof(*rows));
+    rows[report->n_rows].type = type;
+    rows[report->n_rows].message_id = message_id;
+
+    return &rows[report->n_rows++];
+}
+
+/**
+ * @brief Add a call to a trace report.
+ *
+ * @param report    The report.
+ * @param rec       Record of the call. Responses are counted as commands.
+ *
+ * @return          0 on success, -1 if memory could not be allocated.
+ */
+static int trace_report_add(struct trace_report *report, const struct trace_record *rec)
+{
+    uint16_t type = (rec->type == TRACE_RECORD_RESPONSE) ? TRACE_RECORD_COMMAND : rec->type;
+    uint64_t latency = rec->end_us - MIN(rec->start_us, rec->end_us);
+    struct trace_report_row *row;
+    size_t pos;
+
+    row = trace_report_row(report, type, rec->message_id);
+    if (!row)
+        return -1;
+
+    if (row->n_latencies == row->capacity)
+    {
+        size_t capacity = row->capacity ? row->capacity * 2 : 64;
+        uint64_t *latencies = realloc(row->latencies, capacity * sizeof(*latencies));
+
+        if (!latencies)
+            return -1;
+
+        row->latencies = latencies;
+        row->capacity = capacity;
+    }
+
+    row->latencies[row->n_latencies++] = latency;
+    report->end_us = MAX(report->end_us, rec->end_us);
+    row->errors += (rec->status != 0);
+    row->octets += (uint64_t)rec->out_len + rec->in_len;
+
+    /* Submitting a command does not wait for it, so only its response counts as slow */
+    if (rec->type == TRACE_RECORD_SUBMIT)
+        return 0;
+
+    for (pos = report->n_slowest; pos > 0; pos--)
+    {
+        if (report->slowest[pos - 1].latency_us >= latency)
+            break;
+    }
+
+    if (pos == report->max_slowest)
+        return 0;
+
+    if (report->n_slowest < report->max_slowest)
+        report->n_slowest++;
+
+    memmove(&report->slowest[pos + 1], &report->slowest[pos],
+            (report->n_slowest - pos - 1) * sizeof(*report->slowest));
+
+    report->slowest[pos].start_us = rec->start_us;
+    report->slowest[pos].latency_us = latency;
+    report->slowest[pos].type = type;
+    report->slowest[pos].message_id = rec->message_id;
+    report->slowest[pos].addr = rec->addr;
+    report->slowest[pos].status = rec->status;
+
+    return 0;
+}
+
+static void trace_report_free(struct trace_report *report)
+{
+    for (size_t i = 0; i < report->n_rows; i++)
+        free(report->rows[i].latencies);
+
+    free(report->rows);
+    free(report->slowest);
+}
+
+static int trace_report_cmp_latency(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Get a percentile of the latencies of a row, which must be sorted.
+ *
+ * @param row       The row.
+ * @param percent   Percentile to get.
+ *
+ * @return          The latency in us.
+ */
+static uint64_t trace_report_percentile(const struct trace_report_row *row, unsigned int percent)
+{
+    size_t rank = (row->n_latencies * percent + 99) / 100;
+
+    if (!row->n_latencies)
+        return 0;
+
+    return row->latencies[rank ? rank - 1 : 0];
+}
+
+/**
+ * @brief Format the name of a kind of call.
+ *
+ * @param buf           Buffer for the name.
+ * @param size          Size of the buffer.
+ * @param type          Record type of the call.
+ * @param message_id    Message ID of a command.
+ */
+static void trace_report_call_name(char *buf, size_t size, uint16_t type, uint16_t message_id)
+{
+    if (type == TRACE_RECORD_COMMAND || type == TRACE_RECORD_SUBMIT)
+        snprintf(buf, size, "%s 0x%04x", trace_record_type_name(type), message_id);
+    else
+        snprintf(buf, size, "%s", trace_record_type_name(type));
+}
+
+/**
+ * @brief Read a trace file into a report.
+ *
+ * @param path          Path of the trace file.
+ * @param[out] header   Header of the trace.
+ * @param report        Report to add the calls to.
+ *
+ * @return              Number of records read, or -1 on error.
+ */
+static int trace_report_read(const char *path, struct trace_header *header,
+                             struct trace_report *report)
+{
+    struct trace_record rec;
+    uint8_t *payload = NULL;
+    size_t size = 0;
+    int n_records = 0;
+    FILE *in;
+    int ret;
+
+    in = fopen(path, "rb");
+    if (!in)
+    {
+        mctrl_err("Could not open trace file %s\n", path);
+        return -1;
+    }
+
+    if (trace_read_header(in, header))
+    {
+        mctrl_err("%s is not a supported trace file\n", path);
+        fclose(in);
+        return -1;
+    }
+
+    while ((ret = trace_read_record(in, &rec, &payload, &size)) > 0)
+    {
+        if (trace_report_add(report, &rec))
+        {
+            ret = -1;
+            break;
+        }
+        n_records++;
+    }
+
+    if (ret < 0)
+        mctrl_err("Trace file %s is malformed or truncated after %d records\n", path, n_records);
+
+    free(payload);
+    fclose(in);
+
+    return (ret < 0) ? -1 : n_records;
+}
+
+int trace_report(struct morsectrl *mors, int argc, char *argv[])
+{
+    int slowest = report_args.slowest->count ?
+                  report_args.slowest->ival[0] : TRACE_REPORT_DEFAULT_SLOWEST;
+    struct trace_report report = {};
+    struct trace_header header;
+    int n_records;
+    int ret = -1;
+
+    if (slowest < 0 || slowest > TRACE_REPORT_MAX_SLOWEST)
+    {
+        mctrl_err("Invalid number of slowest calls %d, must be 0 - %d\n", slowest,
+                  TRACE_REPORT_MAX_SLOWEST);
+        return -1;
+    }
+
+    report.max_slowest = slowest;
+    report.slowest = calloc(slowest + 1, sizeof(*report.slowest));
+    if (!report.slowest)
+        goto exit;
+
+    n_records = trace_report_read(report_args.trace->sval[0], &header, &report);
+    if (n_records < 0)
+        goto exit;
+
+    mctrl_print("start_us: %" PRIu64 "\nduration_us: %" PRIu64 "\nrecords: %d\n\n",
+                header.start_us, report.end_us, n_records);
+    mctrl_print("%-20s %8s %6s %12s %10s %10s %10s %10s %10s %12s\n", "call", "count", "errors",
+                "octets", "min_us", "p50_us", "p90_us", "p99_us", "max_us", "total_us");
+
+    for (size_t i = 0; i < report.n_rows; i++)
+    {
+        struct trace_report_row *row = &report.rows[i];
+        uint64_t total_us = 0;
+        char name[32];
+
+        qsort(row->latencies, row->n_latencies, sizeof(*row->latencies),
+              trace_report_cmp_latency);
+
+        for (size_t j = 0; j < row->n_latencies; j++)
+            total_us += row->latencies[j];
+
+        trace_report_call_name(name, sizeof(name), row->type, row->message_id);
+        mctrl_print("%-20s %8zu %6u %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+                    " %10" PRIu64 " %10" PRIu64 " %12" PRIu64 "\n",
+                    name, row->n_latencies, row->errors, row->octets, row->latencies[0],
+                    trace_report_percentile(row, 50), trace_report_percentile(row, 90),
+                    trace_report_percentile(row, 99), row->latencies[row->n_latencies - 1],
+                    total_us);
+    }
+
+    if (report.n_slowest)
+    {
+        mctrl_print("\n%12s %12s %-20s %10s %8s\n", "start_us", "latency_us", "call", "addr",
+                    "status");
+
+        for (size_t i = 0; i < report.n_slowest; i++)
+        {
+            const struct trace_report_call *call = &report.slowest[i];
+            char name[32];
+
+            trace_report_call_name(name, sizeof(name), call->type, call->message_id);
+            mctrl_print("%12" PRIu64 " %12" PRIu64 " %-20s 0x%08x %8d\n", call->start_us,
+                        call->latency_us, name, call->addr, call->status);
+        }
+    }
+
+    ret = 0;
+
+exit:
+    trace_report_free(&report);
+    return ret;
+}
+
+/**
+ * @brief Send a command from a trace again.
+ *
+ * @param mors          Handle
+ * @param replayed      Report to add the replayed command to
+ * @param message_id    Message ID of the command
+ * @param payload       Payload of the command, excluding its header
+ * @param len           Length of the payload
+ * @param resp_size     Size of the response payload expected
+ * @param traced        Record of the traced command, or NULL if its outcome was not traced
+ *
+ * @return              1 if the status differed from the trace, 0 if not, or -1 on error
+ */
+static int trace_replay_command(struct morsectrl *mors, struct trace_report *replayed,
+                                uint16_t message_id, const uint8_t *payload, size_t len,
+                                size_t resp_size, const struct trace_record *traced)
+{
+    struct morsectrl_transport_buff *cmd_tbuff;
+    struct morsectrl_transport_buff *rsp_tbuff;
+    struct trace_record rec = {
+        .type = TRACE_RECORD_COMMAND,
+        .message_id = message_id,
+    };
+    int ret = -1;
+
+    cmd_tbuff = morsectrl_transport_cmd_alloc(mors->transport, len);
+    rsp_tbuff = morsectrl_transport_resp_alloc(mors->transport, resp_size);
+    if (!cmd_tbuff || !rsp_tbuff)
+        goto exit;
+
+    if (len)
+        memcpy(((struct command *)cmd_tbuff->data)->data, payload, len);
+
+    rec.start_us = time_monotonic_us();
+    rec.status = morsectrl_send_command(mors->transport, message_id, cmd_tbuff, rsp_tbuff);
+    rec.end_us = time_monotonic_us();
+    rec.out_len = cmd_tbuff->data_len;
+
+    if (trace_report_add(replayed, &rec))
+        goto exit;
+
+    ret = 0;
+    if (traced && traced->status != rec.status)
+    {
+        mctrl_err("command 0x%04x traced at %" PRIu64 " us returned %d, replay returned %d\n",
+                  message_id, traced->start_us, traced->status, rec.status);
+        ret = 1;
+    }
+
+exit:
+    morsectrl_transport_buff_free(cmd_tbuff);
+    morsectrl_transport_buff_free(rsp_tbuff);
+    return ret;
+}
+
+int trace_replay(struct morsectrl *mors, int argc, char *argv[])
+{
+    const char *path = replay_args.trace->sval[0];
+    struct trace_replay_pending pending[TRACE_REPLAY_MAX_PENDING] = {};
+    struct trace_report traced = {};
+    struct trace_report replayed = {};
+    struct trace_header header;
+    struct trace_record rec;
+    uint8_t *payload = NULL;
+    size_t size = 0;
+    int n_replayed = 0;
+    int n_skipped = 0;
+    int n_differed = 0;
+    FILE *in;
+    int ret;
+
+    in = fopen(path, "rb");
+    if (!in)
+    {
+        mctrl_err("Could not open trace file %s\n", path);
+        return -1;
+    }
+
+    if (trace_read_header(in, &header))
+    {
+        mctrl_err("%s is not a supported trace file\n", path);
+        fclose(in);
+        return -1;
+    }
+
+    while ((ret = trace_read_record(in, &rec, &payload, &size)) > 0)
+    {
+        struct trace_replay_pending *waiting = NULL;
+        size_t resp_size = TRACE_REPLAY_RESP_SIZE;
+
+        if (rec.type != TRACE_RECORD_COMMAND && rec.type != TRACE_RECORD_SUBMIT &&
+            rec.type != TRACE_RECORD_RESPONSE)
+            continue;
+
+        if (rec.type == TRACE_RECORD_SUBMIT)
+        {
+            /* Replay submitted commands once their response shows how they fared */
+            for (size_t i = 0; i < TRACE_REPLAY_MAX_PENDING && !waiting; i++)
+            {
+                if (!pending[i].payload)
+                    waiting = &pending[i];
+            }
+
+            if (!waiting || rec.out_len < sizeof(struct command))
+            {
+                n_skipped++;
+                continue;
+            }
+
+            waiting->len = rec.out_len - sizeof(struct command);
+            waiting->payload = malloc(waiting->len + 1);
+            if (!waiting->payload)
+            {
+                ret = -1;
+                break;
+            }
+
+            memcpy(waiting->payload, payload + sizeof(struct command), waiting->len);
+            waiting->tag = rec.tag;
+            waiting->message_id = rec.message_id;
+            continue;
+        }
+
+        if (trace_report_add(&traced, &rec))
+        {
+            ret = -1;
+            break;
+        }
+
+        if (rec.in_len > sizeof(struct response))
+            resp_size = MAX(resp_size, rec.in_len - sizeof(struct response));
+
+        if (rec.type == TRACE_RECORD_RESPONSE)
+        {
+            for (size_t i = 0; i < TRACE_REPLAY_MAX_PENDING && !waiting; i++)
+            {
+                if (pending[i].payload && pending[i].tag == rec.tag)
+                    waiting = &pending[i];
+            }
+
+            if (!waiting)
+            {
+                n_skipped++;
+                continue;
+            }
+
+            ret = trace_replay_command(mors, &replayed, waiting->message_id, waiting->payload,
+                                       waiting->len, resp_size, &rec);
+            free(waiting->payload);
+            waiting->payload = NULL;
+        }
+        else if (rec.out_len >= sizeof(struct command))
+        {
+            ret = trace_replay_command(mors, &replayed, rec.message_id,
+                                       payload + sizeof(struct command),
+                                       rec.out_len - sizeof(struct command), resp_size, &rec);
+        }
+        else
+        {
+            n_skipped++;
+            continue;
+        }
+
+        if (ret < 0)
+            break;
+
+        n_replayed++;
+        n_differed += ret;
+    }
+
+    /* Commands whose response was never traced are still replayed, there is just no comparison */
+    for (size_t i = 0; i < TRACE_REPLAY_MAX_PENDING; i++)
+    {
+        if (!pending[i].payload)
+            continue;
+
+        if (ret >= 0)
+        {
+            ret = trace_replay_command(mors, &replayed, pending[i].message_id, pending[i].payload,
+                                       pending[i].len, TRACE_REPLAY_RESP_SIZE, NULL);
+            if (ret >= 0)
+                n_replayed++;
+        }
+        free(pending[i].payload);
+    }
+
+    if (ret < 0)
+    {
+        mctrl_err("Replay of %s stopped after %d commands\n", path, n_replayed);
+        goto exit;
+    }
+
+    mctrl_print("%-20s %8s %10s %10s %8s %6s %10s %10s\n", "command", "traced", "p50_us",
+                "p99_us", "replayed", "errors", "p50_us", "p99_us");
+
+    for (size_t i = 0; i < replayed.n_rows; i++)
+    {
+        struct trace_report_row *row = &replayed.rows[i];
+        struct trace_report_row *before = trace_report_row(&traced, row->type, row->message_id);
+        char name[32];
+
+        if (!before)
+        {
+            ret = -1;
+            goto exit;
+        }
+
+        qsort(row->latencies, row->n_latencies, sizeof(*row->latencies),
+              trace_report_cmp_latency);
+        qsort(before->latencies, before->n_latencies, sizeof(*before->latencies),
+              trace_report_cmp_latency);
+
+        trace_report_call_name(name, sizeof(name), row->type, row->message_id);
+        mctrl_print("%-20s %8zu %10" PRIu64 " %10" PRIu64 " %8zu %6u %10" PRIu64 " %10" PRIu64
+                    "\n", name, before->n_latencies, trace_report_percentile(before, 50),
+                    trace_report_percentile(before, 99), row->n_latencies, row->errors,
+                    trace_report_percentile(row, 50), trace_report_percentile(row, 99));
+    }
+
+    mctrl_print("\nreplayed: %d\nskipped: %d\nstatus differed: %d\n", n_replayed, n_skipped,
+                n_differed);
+    ret = 0;
+
+exit:
+    free(payload);
+    fclose(in);
+    trace_report_free(&traced);
+    trace_report_free(&replayed);
+    return ret;
+}
+
+MM_CLI_HANDLER(trace_report, MM_INTF_NOT_REQUIRED, MM_DIRECT_CHIP_SUPPORTED);
+MM_CLI_HANDLER(trace_replay, MM_INTF_REQUIRED, MM_DIRECT_CHIP_SUPPORTED);
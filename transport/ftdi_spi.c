@@ -22,9 +22,11 @@
 
 #include "ftd2xx.h"
 #include "libmpsse_spi.h"
+#include "ftdi_mid.h"
 #include "transport.h"
 #include "transport_private.h"
 #include "sdio_over_spi.h"
+#include "host_table.h"
 
 /* We need this to trim the response to the correct length */
 #include "../command.h"
@@ -62,6 +64,15 @@
 
 #define FTDI_SPI_JUNK_OCTET             (0xFF)
 
+/** Most octets a single MPSSE data command can clock */
+#define FTDI_SPI_MPSSE_MAX_XFER         (64 * 1024)
+/** Length of an MPSSE data command, excluding the data */
+#define FTDI_SPI_MPSSE_XFER_HDR_LEN     (3)
+/** Length of an MPSSE set data bits command */
+#define FTDI_SPI_MPSSE_SET_BITS_LEN     (3)
+/** Initial size of the queue buffers, enough for a register access */
+#define FTDI_SPI_QUEUE_MIN_SIZE         (1024)
+
 #define FTDI_SPI_STR_CPOL               "cpol"
 #define FTDI_SPI_STR_CPHA               "cpha"
 #define FTDI_SPI_STR_FREQ               "freq_khz"
@@ -72,22 +83,23 @@
 #define FTDI_SPI_STR_JTAGRST_PIN        "jtag_reset_pin_num"
 #define FTDI_SPI_STR_RESET_MS           "reset_ms"
 #define FTDI_SPI_STR_SERIAL_NUM         "serial_num"
+#define FTDI_SPI_STR_RESP_TIMEOUT_MS    "resp_timeout_ms"
+#define FTDI_SPI_STR_POLL_SPIN_US       "poll_spin_us"
+#define FTDI_SPI_STR_POLL_MAX_US        "poll_max_us"
+#define FTDI_SPI_STR_SDIO_DELAY         "sdio_delay_octets"
 #define FTDI_SPI_STR_HELP               "help"
 
 #define RESP_TIMEOUT_MS                 (3000)
-#define RESP_POLL_INTERVAL_MS           (100)
+/** Time to poll for a response back to back before backing off */
+#define RESP_POLL_SPIN_US_DEFAULT       (2000)
+/** First sleep between polls once backing off, doubled after every poll */
+#define RESP_POLL_MIN_US                (100)
+/** Longest sleep between polls */
+#define RESP_POLL_MAX_US_DEFAULT        (100000)
 
 #define FTDI_SPI_PINSTATE_TO_VAL(x)     (((x) >> 8) & 0xFF)
 #define FTDI_SPI_PINSTATE_TO_DIR(x)     ((x) & 0xFF)
 
-#define MM_MANIFEST_ADDR                (0x10054d40)
-#define MM_TRIGGER_ADDR                 (0x100A6010)
-#define MM_STATUS_ADDR                  (0x100A6060)
-#define MM_STATUS_CLR_ADDR              (0x100A6068)
-#define MM_CMD_MASK                     BIT(1)
-#define MM_CMD_ADDR_OFFSET              (16)
-#define MM_RESP_ADDR_OFFSET             (20)
-
 #define FTDI_SPI_FREQ_KHZ_TO_HZ(freq_khz)  ((freq_khz) * 1000)
 
 
@@ -110,6 +122,57 @@ struct morsectrl_ftdi_spi_cfg
     uint32_t reset_ms;
     /** Size taken from FT_DEVICE_LIST_INFO_NODE structure in libmpsse library. */
     char serial_num[MAX_SERIAL_NUMBER_LEN];
+    /** Time to wait for a command response */
+    uint32_t resp_timeout_ms;
+    /** Time to poll for a command response without sleeping */
+    uint32_t poll_spin_us;
+    /** Maximum time to sleep between polls for a command response */
+    uint32_t poll_max_us;
+    /** Padding given to the chip to respond to a CMD53, or 0 to calibrate it */
+    uint32_t sdio_delay_octets;
+};
+
+/** @brief A read queued by a raw transfer, copied out when the queue is flushed. */
+struct ftdi_spi_queued_read
+{
+    /** Where to copy the octets read to */
+    uint8_t *dest;
+    /** Number of octets read */
+    size_t len;
+};
+
+/**
+ * @brief Raw transfers queued to be sent to the MPSSE with a single USB write and read.
+ *
+ * Every raw transfer otherwise costs at least one USB round trip for each CS toggle and data
+ * command, which dominates the time taken by short SDIO commands.
+ */
+struct ftdi_spi_queue
+{
+    /** Whether raw transfers are being queued rather than performed */
+    bool active;
+    /** MPSSE commands and data to write */
+    uint8_t *out;
+    /** Number of octets in out */
+    size_t out_len;
+    /** Allocated size of out */
+    size_t out_size;
+    /** Buffer the MPSSE response is read into before being demultiplexed */
+    uint8_t *in;
+    /** Number of octets the MPSSE will send back */
+    size_t in_len;
+    /** Allocated size of in */
+    size_t in_size;
+    /** Where each queued read is copied to, in order */
+    struct ftdi_spi_queued_read *reads;
+    /** Number of entries in reads */
+    size_t n_reads;
+    /** Allocated number of entries in reads */
+    size_t reads_size;
+    /** Whether pin_state holds a pin state queued but not yet sent */
+    bool pin_state_staged;
+    /** Pin state the queued transfers leave the channel in, committed by a successful flush */
+    uint16_t pin_state;
 };
 
 /** @brief State information for the FTDI SPI interface. */
@@ -117,6 +180,16 @@ struct morsectrl_ftdi_spi_state
 {
     FT_HANDLE handle;
     FT_HANDLE reset_handle;
+    /** Whether cmd_addr and resp_addr hold the addresses from the firmware's host table */
+    bool mailbox_valid;
+    /** Address commands are written to */
+    uint32_t cmd_addr;
+    /** Address responses are read from */
+    uint32_t resp_addr;
+    /** State of the SDIO over SPI layer */
+    struct sdio_over_spi_state sdio;
+    /** Raw transfers waiting to be flushed */
+    struct ftdi_spi_queue queue;
 };
 
 /** @brief Data structure used to represent an instance of this transport. */
@@ -149,6 +222,11 @@ static struct morsectrl_ftdi_spi_state *ftdi_spi_state(struct morsectrl_transpor
     return &ftdi_spi_transport->state;
 }
 
+struct sdio_over_spi_state *sdio_over_spi_get_state(struct morsectrl_transport *transport)
+{
+    return &ftdi_spi_state(transport)->sdio;
+}
+
 /**
  * @brief Prints an error message if possible.
  *
@@ -281,6 +359,14 @@ static bool ftdi_spi_print_config_usage(const char *str, const char *key)
     mctrl_print("\t%s - Reset time (default %d)\n", FTDI_SPI_STR_RESET_MS,
                     MMDEBUG_RESET_MS_DEFAULT);
     mctrl_print("\t%s - Serial number to use\n", FTDI_SPI_STR_SERIAL_NUM);
+    mctrl_print("\t%s - Command response timeout (default %d)\n", FTDI_SPI_STR_RESP_TIMEOUT_MS,
+                    RESP_TIMEOUT_MS);
+    mctrl_print("\t%s - Time to poll for a response before backing off (default %d)\n",
+                    FTDI_SPI_STR_POLL_SPIN_US, RESP_POLL_SPIN_US_DEFAULT);
+    mctrl_print("\t%s - Maximum time between polls for a response (default %d)\n",
+                    FTDI_SPI_STR_POLL_MAX_US, RESP_POLL_MAX_US_DEFAULT);
+    mctrl_print("\t%s - SDIO padding for the chip to respond to block writes and byte reads, "
+                "0 to calibrate it (default 0)\n", FTDI_SPI_STR_SDIO_DELAY);
     mctrl_print("\t%s - Prints this message\n", FTDI_SPI_STR_HELP);
 
     return true;
@@ -333,6 +419,9 @@ static int ftdi_spi_parse(struct morsectrl_transport **transport,
     chan_config->Pin = 0xFFFFFFFF;
     chan_config->configOptions = 0;
     config->reset_ms = MMDEBUG_RESET_MS_DEFAULT;
+    config->resp_timeout_ms = RESP_TIMEOUT_MS;
+    config->poll_spin_us = RESP_POLL_SPIN_US_DEFAULT;
+    config->poll_max_us = RESP_POLL_MAX_US_DEFAULT;
 
     if (cfg_opts)
     {
@@ -361,6 +450,14 @@ static int ftdi_spi_parse(struct morsectrl_transport **transport,
             if (ftdi_spi_get_string(ptr, FTDI_SPI_STR_SERIAL_NUM, config->serial_num,
                                     sizeof(config->serial_num)))
                 continue;
+            if (ftdi_spi_get_uint32(ptr, FTDI_SPI_STR_RESP_TIMEOUT_MS, &config->resp_timeout_ms))
+                continue;
+            if (ftdi_spi_get_uint32(ptr, FTDI_SPI_STR_POLL_SPIN_US, &config->poll_spin_us))
+                continue;
+            if (ftdi_spi_get_uint32(ptr, FTDI_SPI_STR_POLL_MAX_US, &config->poll_max_us))
+                continue;
+            if (ftdi_spi_get_uint32(ptr, FTDI_SPI_STR_SDIO_DELAY, &config->sdio_delay_octets))
+                continue;
             if (ftdi_spi_print_config_usage(ptr, FTDI_SPI_STR_HELP))
                 exit(ETRANSSUCC);
 
@@ -368,6 +465,12 @@ static int ftdi_spi_parse(struct morsectrl_transport **transport,
         }
     }
 
+    if (config->sdio_delay_octets > UINT16_MAX)
+    {
+        mctrl_err("%s must be at most %u\n", FTDI_SPI_STR_SDIO_DELAY, UINT16_MAX);
+        config_error++;
+    }
+
     if (config_error)
     {
         mctrl_err("FTDI SPI configuration error\n");
@@ -445,6 +548,13 @@ static int ftdi_spi_parse(struct morsectrl_transport **transport,
         mctrl_print("Reset time (ms) = %u\n", config->reset_ms);
         mctrl_print("Serial Number   = %s\n", strlen(config->serial_num) ?
                                               config->serial_num : "N/A");
+        mctrl_print("Resp timeout    = %u ms\n", config->resp_timeout_ms);
+        mctrl_print("Poll spin       = %u us\n", config->poll_spin_us);
+        mctrl_print("Poll max        = %u us\n", config->poll_max_us);
+        if (config->sdio_delay_octets)
+            mctrl_print("SDIO delay      = %u octets\n", config->sdio_delay_octets);
+        else
+            mctrl_print("SDIO delay      = calibrated\n");
     }
 
     return 0;
@@ -502,6 +612,10 @@ static int ftdi_spi_init(struct morsectrl_transport *transport)
     unsigned int ii;
     char serial_num_list[MMDEBUG_MAX_CHANNELS][MAX_SERIAL_NUMBER_LEN] = {"\0"};
 
+    state->mailbox_valid = false;
+    sdio_over_spi_invalidate(transport);
+    state->sdio.delay_octets = config->sdio_delay_octets;
+
     Init_libMPSSE();
 
     if (transport->debug)
@@ -633,6 +747,11 @@ static int ftdi_spi_deinit(struct morsectrl_transport *transport)
     SPI_CloseChannel(state->reset_handle);
     Cleanup_libMPSSE();
 
+    free(state->queue.out);
+    free(state->queue.in);
+    free(state->queue.reads);
+    memset(&state->queue, 0, sizeof(state->queue));
+
     return ret;
 }
 
@@ -658,17 +777,10 @@ static struct morsectrl_transport_buff *ftdi_spi_alloc(struct morsectrl_transpor
     /* Alignment to word boundaries. */
     aligned_size = align_size(size, sizeof(uint32_t));
 
-    buff = malloc(sizeof(*buff));
+    buff = morsectrl_transport_buff_alloc(transport, aligned_size);
     if (!buff)
         return NULL;
 
-    buff->capacity = aligned_size;
-    buff->memblock = (uint8_t *)malloc(buff->capacity);
-    if (!buff->memblock)
-    {
-        free(buff);
-        return NULL;
-    }
     buff->data = buff->memblock;
     buff->data_len = size;
     memset(&buff->data[size], FTDI_SPI_JUNK_OCTET, aligned_size - size);
@@ -724,7 +836,17 @@ static int ftdi_spi_reg_read(struct morsectrl_transport *transport,
 static int ftdi_spi_reg_write(struct morsectrl_transport *transport,
                               uint32_t addr, uint32_t value)
 {
-    return sdio_over_spi_write_reg_32bit(transport, addr, value);
+    int ret;
+
+    /* The write could change the firmware, so look the mailbox up again before the next command */
+    ftdi_spi_state(transport)->mailbox_valid = false;
+
+    ret = sdio_over_spi_write_reg_32bit(transport, addr, value);
+
+    /* The write could also have reset the chip, and with it the keyhole registers */
+    sdio_over_spi_invalidate(transport);
+
+    return ret;
 }
 
 /**
@@ -758,6 +880,9 @@ static int ftdi_spi_mem_write(struct morsectrl_transport *transport,
                               struct morsectrl_transport_buff *write,
                               uint32_t addr)
 {
+    /* The write could change the firmware (e.g. load_elf), so look the mailbox up again */
+    ftdi_spi_state(transport)->mailbox_valid = false;
+
     return sdio_over_spi_write_memblock(transport, write, addr);
 }
 
@@ -788,6 +913,307 @@ static int ftdi_spi_set_cs(struct morsectrl_transport *transport, bool assert)
     return ETRANSSUCC;
 }
 
+/**
+ * @brief Make room for more octets in a queue buffer.
+ *
+ * @param buf       Buffer to grow.
+ * @param size      Allocated size of the buffer, updated on success.
+ * @param needed    Number of octets the buffer must hold.
+ * @param elem_size Size of each element of the buffer.
+ * @return          0 on success otherwise relevant error.
+ */
+static int ftdi_spi_queue_grow(void **buf, size_t *size, size_t needed, size_t elem_size)
+{
+    size_t new_size = MAX(*size, (size_t)FTDI_SPI_QUEUE_MIN_SIZE);
+    void *new_buf;
+
+    if (needed <= *size)
+        return ETRANSSUCC;
+
+    while (new_size < needed)
+        new_size *= 2;
+
+    new_buf = realloc(*buf, new_size * elem_size);
+    if (!new_buf)
+        return -ETRANSNOMEM;
+
+    *buf = new_buf;
+    *size = new_size;
+    return ETRANSSUCC;
+}
+
+/**
+ * @brief Queue an MPSSE command to set the CS line.
+ *
+ * This mirrors SPI_ToggleCS(), including updating the pin state libmpsse keeps for the channel so
+ * that later unqueued transfers start from the right state.
+ *
+ * @param transport The transport structure.
+ * @param assert    Whether to assert CS.
+ * @return          0 on success otherwise relevant error.
+ */
+static int ftdi_spi_queue_cs(struct morsectrl_transport *transport, bool assert)
+{
+    struct ftdi_spi_queue *queue = &ftdi_spi_state(transport)->queue;
+    ChannelConfig *config = NULL;
+    bool active_low;
+    uint8_t cs_bit;
+    uint8_t value;
+    uint8_t direction;
+    int ret;
+
+    if (SPI_GetChannelConfig(ftdi_spi_state(transport)->handle, &config) || !config)
+    {
+        ftdi_spi_error(-ETRANSFTDISPIERR, "Failed to get channel config");
+        return -ETRANSFTDISPIERR;
+    }
+
+    ret = ftdi_spi_queue_grow((void **)&queue->out, &queue->out_size,
+                              queue->out_len + FTDI_SPI_MPSSE_SET_BITS_LEN, 1);
+    if (ret)
+        return ret;
+
+    active_low = (config->configOptions & SPI_CONFIG_OPTION_CS_ACTIVELOW) != 0;
+    cs_bit = (1 << ((config->configOptions & SPI_CONFIG_OPTION_CS_MASK) >> 2)) << 3;
+    if (!queue->pin_state_staged)
+    {
+        queue->pin_state = config->currentPinState;
+        queue->pin_state_staged = true;
+    }
+
+    direction = FTDI_SPI_PINSTATE_TO_DIR(queue->pin_state) | cs_bit;
+    value = FTDI_SPI_PINSTATE_TO_VAL(queue->pin_state);
+
+    if (assert != active_low)
+        value |= cs_bit;
+    else
+        value &= ~cs_bit;
+
+    /* Only reaches the channel config once the flush has sent it, see ftdi_spi_raw_flush() */
+    queue->pin_state = ((uint16_t)value << 8) | direction;
+
+    queue->out[queue->out_len++] = MPSSE_CMD_SET_DATA_BITS_LOWBYTE;
+    queue->out[queue->out_len++] = value;
+    queue->out[queue->out_len++] = direction;
+
+    return ETRANSSUCC;
+}
+
+/**
+ * @brief Queue a raw transfer, with the same arguments as the unqueued raw functions.
+ *
+ * @param transport The transport structure.
+ * @param read      Buffer to read data into, or NULL to only write. Only valid once the queue has
+ *                  been flushed.
+ * @param write     Buffer to write data from, or NULL to write junk octets.
+ * @param len       Number of octets to transfer.
+ * @param start     Whether to assert CS before data transmission.
+ * @param finish    Whether to de-assert CS after data transmission.
+ * @return          0 on success otherwise relevant error.
+ */
+static int ftdi_spi_queue_xfer(struct morsectrl_transport *transport,
+                               uint8_t *read,
+                               const uint8_t *write,
+                               size_t len,
+                               bool start,
+                               bool finish)
+{
+    struct ftdi_spi_queue *queue = &ftdi_spi_state(transport)->queue;
+    ChannelConfig *config = NULL;
+    size_t n_chunks = (len + FTDI_SPI_MPSSE_MAX_XFER - 1) / FTDI_SPI_MPSSE_MAX_XFER;
+    bool mode_pos_edge;
+    uint8_t opcode;
+    int ret;
+
+    if (start)
+    {
+        ret = ftdi_spi_queue_cs(transport, true);
+        if (ret)
+            return ret;
+    }
+
+    if (len)
+    {
+        if (SPI_GetChannelConfig(ftdi_spi_state(transport)->handle, &config) || !config)
+        {
+            ftdi_spi_error(-ETRANSFTDISPIERR, "Failed to get channel config");
+            return -ETRANSFTDISPIERR;
+        }
+
+        ret = ftdi_spi_queue_grow((void **)&queue->out, &queue->out_size,
+                                  queue->out_len + len + n_chunks * FTDI_SPI_MPSSE_XFER_HDR_LEN,
+                                  1);
+        if (!ret && read)
+            ret = ftdi_spi_queue_grow((void **)&queue->reads, &queue->reads_size,
+                                      queue->n_reads + 1, sizeof(*queue->reads));
+        if (ret)
+            return ret;
+
+        /* Modes 0 and 3 change the output on the falling edge and sample on the rising edge. */
+        switch (config->configOptions & SPI_CONFIG_OPTION_MODE_MASK)
+        {
+        case SPI_CONFIG_OPTION_MODE0:
+        case SPI_CONFIG_OPTION_MODE3:
+            mode_pos_edge = true;
+            break;
+        default:
+            mode_pos_edge = false;
+            break;
+        }
+
+        if (read)
+            opcode = mode_pos_edge ? MPSSE_CMD_DATA_BYTES_IN_POS_OUT_NEG_EDGE :
+                                     MPSSE_CMD_DATA_BYTES_IN_NEG_OUT_POS_EDGE;
+        else
+            opcode = mode_pos_edge ? MPSSE_CMD_DATA_OUT_BYTES_NEG_EDGE :
+                                     MPSSE_CMD_DATA_OUT_BYTES_POS_EDGE;
+
+        for (size_t done = 0; done < len; done += FTDI_SPI_MPSSE_MAX_XFER)
+        {
+            size_t chunk = MIN(len - done, (size_t)FTDI_SPI_MPSSE_MAX_XFER);
+
+            queue->out[queue->out_len++] = opcode;
+            queue->out[queue->out_len++] = (chunk - 1) & 0xFF;
+            queue->out[queue->out_len++] = ((chunk - 1) >> 8) & 0xFF;
+
+            if (write)
+                memcpy(&queue->out[queue->out_len], &write[done], chunk);
+            else
+                memset(&queue->out[queue->out_len], FTDI_SPI_JUNK_OCTET, chunk);
+            queue->out_len += chunk;
+        }
+
+        if (read)
+        {
+            queue->reads[queue->n_reads].dest = read;
+            queue->reads[queue->n_reads].len = len;
+            queue->n_reads++;
+            queue->in_len += len;
+        }
+    }
+
+    if (finish)
+        return ftdi_spi_queue_cs(transport, false);
+
+    return ETRANSSUCC;
+}
+
+/**
+ * @brief Start queueing raw transfers instead of performing them.
+ *
+ * @param transport The transport structure.
+ * @return          0 on success otherwise relevant error.
+ */
+static int ftdi_spi_raw_queue(struct morsectrl_transport *transport)
+{
+    struct ftdi_spi_queue *queue = &ftdi_spi_state(transport)->queue;
+
+    if (queue->active)
+        return ETRANSSUCC;
+
+    queue->active = true;
+    queue->out_len = 0;
+    queue->in_len = 0;
+    queue->n_reads = 0;
+    queue->pin_state_staged = false;
+
+    return ETRANSSUCC;
+}
+
+/**
+ * @brief Send the queued raw transfers with a single USB write and read.
+ *
+ * @param state     The FTDI SPI state.
+ * @return          0 on success otherwise relevant error.
+ */
+static int ftdi_spi_queue_send(struct morsectrl_ftdi_spi_state *state)
+{
+    struct ftdi_spi_queue *queue = &state->queue;
+    DWORD size_transferred = 0;
+    FT_STATUS status;
+    size_t offset = 0;
+    int ret;
+
+    if (!queue->out_len)
+        return ETRANSSUCC;
+
+    ret = ftdi_spi_queue_grow((void **)&queue->out, &queue->out_size, queue->out_len + 1, 1);
+    if (!ret)
+        ret = ftdi_spi_queue_grow((void **)&queue->in, &queue->in_size, queue->in_len, 1);
+    if (ret)
+        return ret;
+
+    /* Have the MPSSE return what was read straight away instead of waiting for the latency timer */
+    queue->out[queue->out_len++] = MPSSE_CMD_SEND_IMMEDIATE;
+
+    status = FT_Channel_Write(SPI, state->handle, queue->out_len, queue->out, &size_transferred);
+    if (status || size_transferred != queue->out_len)
+    {
+        ftdi_spi_error(status, "Failed to write queued transfers");
+        return -ETRANSFTDISPIERR;
+    }
+
+    if (!queue->in_len)
+        return ETRANSSUCC;
+
+    size_transferred = 0;
+    status = FT_Channel_Read(SPI, state->handle, queue->in_len, queue->in, &size_transferred);
+    if (status || size_transferred != queue->in_len)
+    {
+        ftdi_spi_error(status, "Failed to read queued transfers");
+        return -ETRANSFTDISPIERR;
+    }
+
+    for (size_t ii = 0; ii < queue->n_reads; ii++)
+    {
+        memcpy(queue->reads[ii].dest, &queue->in[offset], queue->reads[ii].len);
+        offset += queue->reads[ii].len;
+    }
+
+    return ETRANSSUCC;
+}
+
+/**
+ * @brief Perform all queued raw transfers with a single USB write and read, and stop queueing.
+ *
+ * The chip select state queued with the transfers is only recorded in the channel config once
+ * they have been sent, so a failed flush leaves the config describing the pins as they were.
+ *
+ * @param transport The transport structure.
+ * @return          0 on success otherwise relevant error.
+ */
+static int ftdi_spi_raw_flush(struct morsectrl_transport *transport)
+{
+    struct morsectrl_ftdi_spi_state *state = ftdi_spi_state(transport);
+    struct ftdi_spi_queue *queue = &state->queue;
+    ChannelConfig *config = NULL;
+    int ret;
+
+    if (!queue->active)
+        return ETRANSSUCC;
+
+    queue->active = false;
+
+    ret = ftdi_spi_queue_send(state);
+
+    if (queue->pin_state_staged && ret == ETRANSSUCC)
+    {
+        if (SPI_GetChannelConfig(state->handle, &config) || !config)
+        {
+            ftdi_spi_error(-ETRANSFTDISPIERR, "Failed to get channel config");
+            ret = -ETRANSFTDISPIERR;
+        }
+        else
+        {
+            config->currentPinState = queue->pin_state;
+        }
+    }
+
+    queue->pin_state_staged = false;
+
+    return ret;
+}
+
 /**
  * @brief Read data from the FTDI SPI device.
  *
@@ -806,6 +1232,10 @@ static int ftdi_spi_raw_read(struct morsectrl_transport *transport,
     FT_STATUS status;
     DWORD size_transferred;
 
+    if (ftdi_spi_state(transport)->queue.active)
+        return ftdi_spi_queue_xfer(transport, read ? read->data : NULL, NULL,
+                                   read ? read->data_len : 0, start, finish);
+
     if (read == NULL)
     {
         if (finish)
@@ -859,6 +1289,10 @@ int ftdi_spi_raw_write(struct morsectrl_transport *transport,
     FT_STATUS status;
     DWORD size_transferred;
 
+    if (ftdi_spi_state(transport)->queue.active)
+        return ftdi_spi_queue_xfer(transport, NULL, write ? write->data : NULL,
+                                   write ? write->data_len : 0, start, finish);
+
     if (write == NULL)
     {
         if (finish)
@@ -924,6 +1358,10 @@ int ftdi_spi_raw_read_write(struct morsectrl_transport *transport,
 
     transfer_size = MIN(read->data_len, write->data_len);
 
+    if (ftdi_spi_state(transport)->queue.active)
+        return ftdi_spi_queue_xfer(transport, read->data, write->data, transfer_size,
+                                   start, finish);
+
     if (start)
         options |= FTDI_SPI_OPTS_CS_START;
     if (finish)
@@ -948,65 +1386,129 @@ int ftdi_spi_raw_read_write(struct morsectrl_transport *transport,
     return ETRANSSUCC;
 } /* NOLINT */
 
-static int ftdi_spi_send(struct morsectrl_transport *transport,
-                         struct morsectrl_transport_buff *cmd,
-                         struct morsectrl_transport_buff *resp)
+/**
+ * @brief Wait for the firmware to flag that a command response is ready.
+ *
+ * Most commands are answered within a few milliseconds, so the status is polled back to back at
+ * first. After poll_spin_us the sleep between polls starts small and doubles up to poll_max_us,
+ * so that slow commands do not keep the SPI bus busy.
+ *
+ * @param transport The transport structure.
+ * @return          0 on success, otherwise relevant error.
+ */
+static int ftdi_spi_wait_for_response(struct morsectrl_transport *transport)
 {
-    const struct morsectrl_transport_ops *tops;
-    struct response *response;
-    uint32_t host_table_ptr;
-    uint32_t cmd_addr;
-    uint32_t resp_addr;
+    const struct morsectrl_ftdi_spi_cfg *config = ftdi_spi_cfg(transport);
+    const uint64_t timeout_us = (uint64_t)config->resp_timeout_ms * 1000;
+    const uint64_t start_us = time_monotonic_us();
+    uint32_t backoff_us = MIN(RESP_POLL_MIN_US, config->poll_max_us);
+    uint64_t elapsed_us;
     uint32_t status;
-    int ii;
     int ret;
 
-    if (!transport || !transport->tops ||
-        !transport->tops->reg_read || !transport->tops->reg_write ||
-        !transport->tops->mem_read || !transport->tops->mem_write ||
-        !cmd || !resp)
+    while (true)
     {
-        return -ETRANSFTDISPIERR;
+        ret = sdio_over_spi_read_reg_32bit(transport, MM_STATUS_ADDR, &status);
+        if (ret)
+            return ret;
+
+        if (transport->debug)
+            mctrl_print("\nStatus: 0x%08x\n\n", status);
+
+        if (status & MM_CMD_MASK)
+            return ETRANSSUCC;
+
+        elapsed_us = time_monotonic_us() - start_us;
+        if (elapsed_us >= timeout_us)
+        {
+            ftdi_spi_error(-ETRANSFTDISPIERR, "Timed out waiting for response");
+            return -ETRANSFTDISPIERR;
+        }
+
+        if (elapsed_us < config->poll_spin_us)
+            continue;
+
+        sleep_us(MIN(backoff_us, timeout_us - elapsed_us));
+        backoff_us = MIN(backoff_us * 2, config->poll_max_us);
     }
+}
 
-    tops = transport->tops;
+/**
+ * @brief Get the command and response mailbox addresses from the firmware's host table.
+ *
+ * The lookup takes three dependent register reads, so the result is kept until the chip is reset,
+ * its memory or registers are written through the transport ops, or a command fails.
+ *
+ * @param transport The transport structure.
+ * @return          0 on success otherwise relevant error.
+ */
+static int ftdi_spi_lookup_mailbox(struct morsectrl_transport *transport)
+{
+    struct morsectrl_ftdi_spi_state *state = ftdi_spi_state(transport);
+    uint32_t host_table_ptr;
+    int ret;
+
+    if (state->mailbox_valid)
+        return ETRANSSUCC;
 
-    /* Locate command and response memory locations. */
-    ret = tops->reg_read(transport, MM_MANIFEST_ADDR, &host_table_ptr);
+    ret = sdio_over_spi_read_reg_32bit(transport, MM_MANIFEST_ADDR, &host_table_ptr);
     if (ret)
-        goto fail;
+        return ret;
     if (transport->debug)
         mctrl_print("\nHost table ptr: 0x%08x\n\n", host_table_ptr);
 
-    ret = tops->reg_read(transport, host_table_ptr + MM_CMD_ADDR_OFFSET, &cmd_addr);
+    ret = sdio_over_spi_read_reg_32bit(transport, host_table_ptr + MM_CMD_ADDR_OFFSET,
+                                       &state->cmd_addr);
+    if (ret)
+        return ret;
+    if (transport->debug)
+        mctrl_print("\nCommand addr: 0x%08x\n\n", state->cmd_addr);
+
     /* For production firmware which doesn't support memcmd, the address supplied to write commands
      * is 0.
      */
-    if (ret)
+    if (!state->cmd_addr)
     {
-        goto fail;
+        ftdi_spi_error(state->cmd_addr, "This transport is not supported for production firmware");
+        return -ETRANSFTDISPIERR;
     }
+
+    ret = sdio_over_spi_read_reg_32bit(transport, host_table_ptr + MM_RESP_ADDR_OFFSET,
+                                       &state->resp_addr);
+    if (ret)
+        return ret;
     if (transport->debug)
+        mctrl_print("\nResponse addr: 0x%08x\n\n", state->resp_addr);
+
+    state->mailbox_valid = true;
+
+    return ETRANSSUCC;
+}
+
+static int ftdi_spi_send(struct morsectrl_transport *transport,
+                         struct morsectrl_transport_buff *cmd,
+                         struct morsectrl_transport_buff *resp)
+{
+    struct morsectrl_ftdi_spi_state *state;
+    struct response *response;
+    int ret;
+
+    if (!transport || !cmd || !resp)
     {
-        mctrl_print("\nCommand addr: 0x%08x\n\n", cmd_addr);
-    }
-    if (!cmd_addr)
-    {
-        ftdi_spi_error(cmd_addr, "This transport is not supported for production firmware");
         return -ETRANSFTDISPIERR;
     }
 
-    ret = tops->reg_read(transport, host_table_ptr + MM_RESP_ADDR_OFFSET, &resp_addr);
+    state = ftdi_spi_state(transport);
+
+    /*
+     * Commands are sent through the sdio_over_spi functions rather than the transport ops, as
+     * the ops treat every write as a possible change to the firmware.
+     */
+    ret = ftdi_spi_lookup_mailbox(transport);
     if (ret)
-    {
         goto fail;
-    }
-    if (transport->debug)
-    {
-        mctrl_print("\nResponse addr: 0x%08x\n\n", resp_addr);
-    }
 
-    ret = tops->reg_write(transport, MM_STATUS_CLR_ADDR, MM_CMD_MASK);
+    ret = sdio_over_spi_write_reg_32bit(transport, MM_STATUS_CLR_ADDR, MM_CMD_MASK);
     if (ret)
     {
         goto fail;
@@ -1016,7 +1518,7 @@ static int ftdi_spi_send(struct morsectrl_transport *transport,
         mctrl_print("\nCleared status\n\n");
     }
 
-    ret = tops->mem_write(transport, cmd, cmd_addr);
+    ret = sdio_over_spi_write_memblock(transport, cmd, state->cmd_addr);
     if (ret)
     {
         goto fail;
@@ -1026,7 +1528,7 @@ static int ftdi_spi_send(struct morsectrl_transport *transport,
         mctrl_print("\nWrote command\n\n");
     }
 
-    ret = tops->reg_write(transport, MM_TRIGGER_ADDR, MM_CMD_MASK);
+    ret = sdio_over_spi_write_reg_32bit(transport, MM_TRIGGER_ADDR, MM_CMD_MASK);
     if (ret)
     {
         goto fail;
@@ -1037,29 +1539,14 @@ static int ftdi_spi_send(struct morsectrl_transport *transport,
     }
 
     /* Poll for reponse. */
-    for (ii = 0; ii < RESP_TIMEOUT_MS; ii += RESP_POLL_INTERVAL_MS)
-    {
-        ret = tops->reg_read(transport, MM_STATUS_ADDR, &status);
-        if (ret)
-            goto fail;
-
-        if (transport->debug)
-            mctrl_print("\nStatus: 0x%08x\n\n", status);
-
-        if (status & MM_CMD_MASK)
-        {
-            break;
-        }
-        sleep_ms(RESP_POLL_INTERVAL_MS);
-    }
-
-    if (ii >= RESP_TIMEOUT_MS)
+    ret = ftdi_spi_wait_for_response(transport);
+    if (ret)
     {
         goto fail;
     }
 
     /* Read in response. */
-    ret = tops->mem_read(transport, resp, resp_addr);
+    ret = sdio_over_spi_read_memblock(transport, resp, state->resp_addr);
     if (ret)
     {
         goto fail;
@@ -1070,7 +1557,7 @@ static int ftdi_spi_send(struct morsectrl_transport *transport,
     }
 
     /* Clear status. */
-    tops->reg_write(transport, MM_STATUS_CLR_ADDR, MM_CMD_MASK);
+    sdio_over_spi_write_reg_32bit(transport, MM_STATUS_CLR_ADDR, MM_CMD_MASK);
     if (transport->debug)
     {
         mctrl_print("\nCleared status\n\n");
@@ -1084,11 +1571,12 @@ static int ftdi_spi_send(struct morsectrl_transport *transport,
     return ETRANSSUCC;
 
 fail:
+    /* The firmware may have been restarted, so do not trust the cached mailbox */
+    state->mailbox_valid = false;
     ftdi_spi_error(ret, "Failed to send command");
     return ret;
 }
 
-
 static int ftdi_spi_reset(struct morsectrl_transport *transport)
 {
     struct morsectrl_transport_buff *buff =
@@ -1101,6 +1589,8 @@ static int ftdi_spi_reset(struct morsectrl_transport *transport)
     UCHAR dir;
     int ret;
 
+    state->mailbox_valid = false;
+
     if (!buff)
     {
         return -ETRANSFTDISPIERR;
@@ -1189,8 +1679,12 @@ static const struct morsectrl_transport_ops ftdi_spi_ops = {
     .raw_read = ftdi_spi_raw_read,
     .raw_write = ftdi_spi_raw_write,
     .raw_read_write = ftdi_spi_raw_read_write,
+    .raw_queue = ftdi_spi_raw_queue,
+    .raw_flush = ftdi_spi_raw_flush,
     .reset_device = ftdi_spi_reset,
     .get_ifname = NULL,
+    .submit = NULL,
+    .receive = NULL,
 };
 
 REGISTER_TRANSPORT(ftdi_spi_ops);
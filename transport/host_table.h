@@ -0,0 +1,46 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Registers and host table layout used to pass commands to the firmware over a direct chip
+ * transport.
+ *
+ * The manifest register holds the address of the firmware's host table, which gives the
+ * addresses of the command and response mailboxes. A command is written to its mailbox and the
+ * trigger register written, then the response is read back once the status register shows it is
+ * ready.
+ */
+
+#pragma once
+
+#include "../utilities.h"
+
+/** Register holding the address of the host table */
+#define MM_MANIFEST_ADDR                (0x10054d40)
+/** Register written to have the firmware process the command in its mailbox */
+#define MM_TRIGGER_ADDR                 (0x100A6010)
+/** Register showing whether a response is ready */
+#define MM_STATUS_ADDR                  (0x100A6060)
+/** Register written to clear bits of MM_STATUS_ADDR */
+#define MM_STATUS_CLR_ADDR              (0x100A6068)
+/** Bit of the trigger and status registers for commands */
+#define MM_CMD_MASK                     BIT(1)
+/** Offset in the host table of the command mailbox address */
+#define MM_CMD_ADDR_OFFSET              (16)
+/** Offset in the host table of the response mailbox address */
+#define MM_RESP_ADDR_OFFSET             (20)
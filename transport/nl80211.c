@@ -34,6 +34,11 @@
 #define MORSE_OUI 0x0CBF74
 #define MORSE_VENDOR_CMD_TO_MORSE 0x00
 #define NL80211_BUFFER_SIZE (8192)
+/**
+ * Netlink sequence numbers of submitted commands are this base plus the tag, keeping them clear
+ * of the auto sequence numbers used for synchronous commands (which start from the time of day).
+ */
+#define NL80211_ASYNC_SEQ_BASE (0xFFFF0000)
 
 
 static const struct morsectrl_transport_ops nl80211_ops;
@@ -54,6 +59,15 @@ struct morsectrl_nl80211_state
     struct nl_sock* nl_socket;
     struct nl_cb *cb;
     struct nl_cb *s_cb;
+    /** Callbacks used to receive responses to submitted commands */
+    struct nl_cb *async_cb;
+    /** Completion function and argument for the receive in progress */
+    morsectrl_transport_complete_fn complete;
+    void *complete_arg;
+    /** Set when the receive in progress completed a command with an error */
+    bool complete_error;
+    /** Number of submitted commands whose ack or error has not been received */
+    unsigned int outstanding;
     bool wait_for_ack;
 };
 
@@ -229,6 +243,108 @@ static int morsectrl_nl80211_receive_handler(struct nl_msg *msg, void *arg)
     return NL_OK;
 }
 
+/**
+ * @brief Handle errors for submitted commands, completing the command with the error.
+ *
+ * @param nla   Netlink socket address.
+ * @param nlerr Netlink error, containing the header of the failed command.
+ * @param arg   @ref morsectrl_transport opaque pointer.
+ * @return      NL_STOP always.
+ */
+static int morsectrl_nl80211_async_error_handler(struct sockaddr_nl *nla,
+                                                 struct nlmsgerr *nlerr,
+                                                 void *arg)
+{
+    struct morsectrl_nl80211_state *state = nl80211_state(arg);
+
+    morsectrl_nl80211_error(nlerr->error, "Error callback called");
+
+    if (nlerr->msg.nlmsg_seq >= NL80211_ASYNC_SEQ_BASE)
+    {
+        if (state->outstanding)
+            state->outstanding--;
+
+        state->complete_error = true;
+        if (state->complete)
+            state->complete(state->complete_arg, nlerr->msg.nlmsg_seq - NL80211_ASYNC_SEQ_BASE,
+                            nlerr->error ? nlerr->error : -ETRANSNL80211ERR, NULL, 0);
+    }
+
+    return NL_STOP;
+}
+
+/**
+ * @brief Handle acks for submitted commands.
+ *
+ * The response always precedes the ack and has already completed the command, and a failed
+ * command is completed by the error handler instead, so the ack is only counted.
+ *
+ * @param msg   Netlink message.
+ * @param arg   @ref morsectrl_transport opaque pointer.
+ * @return      NL_STOP always.
+ */
+static int morsectrl_nl80211_async_ack_handler(struct nl_msg *msg, void *arg)
+{
+    struct morsectrl_nl80211_state *state = nl80211_state(arg);
+    uint32_t seq = nlmsg_hdr(msg)->nlmsg_seq;
+
+    if (seq >= NL80211_ASYNC_SEQ_BASE)
+    {
+        if (state->outstanding)
+            state->outstanding--;
+    }
+
+    return NL_STOP;
+}
+
+/**
+ * @brief Handle responses to submitted commands, passing the vendor data to the completion
+ *        function.
+ *
+ * @param msg   Netlink message.
+ * @param arg   @ref morsectrl_transport opaque pointer.
+ * @return      NL_SKIP if reponse is missing otherwise NL_OK.
+ */
+static int morsectrl_nl80211_async_receive_handler(struct nl_msg *msg, void *arg)
+{
+    struct morsectrl_transport *transport = (struct morsectrl_transport *)arg;
+    struct morsectrl_nl80211_state *state = nl80211_state(transport);
+    struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+    uint32_t seq = nlmsg_hdr(msg)->nlmsg_seq;
+    struct nlattr *attr;
+
+    if (transport->debug)
+    {
+        mctrl_print("nla_msg_dump\n");
+        nl_msg_dump(msg, stdout);
+    }
+
+    if (seq < NL80211_ASYNC_SEQ_BASE || !state->complete)
+        return NL_SKIP;
+
+    attr = nla_find(genlmsg_attrdata(gnlh, 0),
+                    genlmsg_attrlen(gnlh, 0),
+                    NL80211_ATTR_VENDOR_DATA);
+    if (!attr)
+    {
+        morsectrl_nl80211_error(0, "Vendor data attribute missing");
+        return NL_SKIP;
+    }
+
+    state->complete(state->complete_arg, seq - NL80211_ASYNC_SEQ_BASE, 0,
+                    nla_data(attr), nla_len(attr));
+    return NL_OK;
+}
+
+/**
+ * @brief Accept any sequence number, as submitted commands are matched to their responses by
+ *        the handlers.
+ */
+static int morsectrl_nl80211_async_seq_check(struct nl_msg *msg, void *arg)
+{
+    return NL_OK;
+}
+
 static int morsectrl_nl80211_init(struct morsectrl_transport *transport)
 {
     struct morsectrl_nl80211_state *state;
@@ -288,7 +404,8 @@ static int morsectrl_nl80211_init(struct morsectrl_transport *transport)
 
     state->s_cb = nl_cb_alloc(transport->debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
     state->cb = nl_cb_alloc(NL_CB_DEFAULT);
-    if (!state->cb || !state->s_cb)
+    state->async_cb = nl_cb_alloc(NL_CB_DEFAULT);
+    if (!state->cb || !state->s_cb || !state->async_cb)
     {
         ret = -ENOMEM;
         morsectrl_nl80211_error(ret, "Failed to allocate netlink callbacks");
@@ -298,6 +415,13 @@ static int morsectrl_nl80211_init(struct morsectrl_transport *transport)
     nl_cb_err(state->cb, NL_CB_CUSTOM, morsectrl_nl80211_error_handler, transport);
     nl_cb_set(state->cb, NL_CB_VALID, NL_CB_CUSTOM, morsectrl_nl80211_receive_handler, transport);
     nl_cb_set(state->cb, NL_CB_ACK, NL_CB_CUSTOM, morsectrl_nl80211_ack_handler, transport);
+    nl_cb_err(state->async_cb, NL_CB_CUSTOM, morsectrl_nl80211_async_error_handler, transport);
+    nl_cb_set(state->async_cb, NL_CB_VALID, NL_CB_CUSTOM,
+              morsectrl_nl80211_async_receive_handler, transport);
+    nl_cb_set(state->async_cb, NL_CB_ACK, NL_CB_CUSTOM,
+              morsectrl_nl80211_async_ack_handler, transport);
+    nl_cb_set(state->async_cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM,
+              morsectrl_nl80211_async_seq_check, transport);
     nl_socket_set_cb(state->nl_socket, state->s_cb);
 
     return ret;
@@ -305,6 +429,7 @@ static int morsectrl_nl80211_init(struct morsectrl_transport *transport)
 exit_cb_free:
     nl_cb_put(state->cb);
     nl_cb_put(state->s_cb);
+    nl_cb_put(state->async_cb);
 exit_socket_free:
     nl_socket_free(state->nl_socket);
 exit:
@@ -321,6 +446,7 @@ static int morsectrl_nl80211_deinit(struct morsectrl_transport *transport)
     state = nl80211_state(transport);
     nl_cb_put(state->cb);
     nl_cb_put(state->s_cb);
+    nl_cb_put(state->async_cb);
     nl_socket_free(state->nl_socket);
     memset(state, 0, sizeof(*state));
     return ETRANSSUCC;
@@ -329,31 +455,25 @@ static int morsectrl_nl80211_deinit(struct morsectrl_transport *transport)
 /**
  * @brief Allocate @ref morsectrl_transport_buff for commands and responses.
  *
- * @param size  Size of command and morse headers.
- * @return      Allocated @ref morsectrl_transport_buff or NULL on failure.
+ * @param transport Transport structure.
+ * @param size      Size of command and morse headers.
+ * @return          Allocated @ref morsectrl_transport_buff or NULL on failure.
  */
-static struct morsectrl_transport_buff *morsectrl_nl80211_alloc(size_t size)
+static struct morsectrl_transport_buff *morsectrl_nl80211_alloc(
+    struct morsectrl_transport *transport, size_t size)
 {
     struct morsectrl_transport_buff *buff;
 
     if (size <= 0)
         return NULL;
 
-    buff = (struct morsectrl_transport_buff *)malloc(sizeof(struct morsectrl_transport_buff));
+    buff = morsectrl_transport_buff_alloc(transport, size);
     if (!buff)
         return NULL;
 
-    buff->capacity = size;
-    buff->memblock = (uint8_t *)malloc(buff->capacity);
-    if (!buff->memblock)
-    {
-        free(buff);
-        return NULL;
-    }
-
     /* In this case there isn't any framing required in a contiguous block of memory. */
     buff->data = buff->memblock;
-    buff->data_len = buff->capacity;
+    buff->data_len = size;
 
     return buff;
 }
@@ -364,7 +484,7 @@ static struct morsectrl_transport_buff *morsectrl_nl80211_write_alloc(
     if (!transport)
         return NULL;
 
-    return morsectrl_nl80211_alloc(size);
+    return morsectrl_nl80211_alloc(transport, size);
 }
 
 static struct morsectrl_transport_buff *morsectrl_nl80211_read_alloc(
@@ -373,34 +493,35 @@ static struct morsectrl_transport_buff *morsectrl_nl80211_read_alloc(
     if (!transport)
         return NULL;
 
-    return morsectrl_nl80211_alloc(size);
+    return morsectrl_nl80211_alloc(transport, size);
 }
 
-static int morsectrl_nl80211_send(struct morsectrl_transport *transport,
-                                  struct morsectrl_transport_buff *cmd,
-                                  struct morsectrl_transport_buff *resp)
+/**
+ * @brief Build a vendor command message carrying a command.
+ *
+ * @param state State of the transport.
+ * @param cmd   Command to carry in the vendor data.
+ * @param seq   Netlink sequence number, or NL_AUTO_SEQ.
+ * @param msg   Set to the message, to be freed with nlmsg_free().
+ * @return      0 on success otherwise relevant error.
+ */
+static int morsectrl_nl80211_build_msg(struct morsectrl_nl80211_state *state,
+                                       struct morsectrl_transport_buff *cmd,
+                                       uint32_t seq,
+                                       struct nl_msg **msg)
 {
     int ret = ETRANSSUCC;
     void* header;
-    struct morsectrl_nl80211_state *state;
-    struct nl_msg* msg;
-
-    if (!transport)
-        return -ETRANSNL80211ERR;
-
-    state = nl80211_state(transport);
-    state->data = resp->data;
-    state->len = &resp->data_len;
 
-    msg = nlmsg_alloc();
-    if (msg == NULL)
+    *msg = nlmsg_alloc();
+    if (*msg == NULL)
     {
         ret = -ENOMEM;
         morsectrl_nl80211_error(ret, "Failed to allocate netlink message");
-        goto exit;
+        return ret;
     }
 
-    header = genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, state->nl80211_id,
+    header = genlmsg_put(*msg, NL_AUTO_PORT, seq, state->nl80211_id,
                          0, 0, NL80211_CMD_VENDOR, 0);
     if (header == NULL)
     {
@@ -409,16 +530,76 @@ static int morsectrl_nl80211_send(struct morsectrl_transport *transport,
         goto exit_message_free;
     }
 
-    ret = nla_put_u32(msg, NL80211_ATTR_IFINDEX, state->interface_index);
+    ret = nla_put_u32(*msg, NL80211_ATTR_IFINDEX, state->interface_index);
     if (ret < ETRANSSUCC)
     {
         morsectrl_nl80211_error(ret, "Unable to put interface index");
         goto exit_message_free;
     }
 
-    NLA_PUT_U32(msg, NL80211_ATTR_VENDOR_ID, MORSE_OUI);
-    NLA_PUT_U32(msg, NL80211_ATTR_VENDOR_SUBCMD, MORSE_VENDOR_CMD_TO_MORSE);
-    NLA_PUT(msg, NL80211_ATTR_VENDOR_DATA, cmd->data_len, cmd->data);
+    NLA_PUT_U32(*msg, NL80211_ATTR_VENDOR_ID, MORSE_OUI);
+    NLA_PUT_U32(*msg, NL80211_ATTR_VENDOR_SUBCMD, MORSE_VENDOR_CMD_TO_MORSE);
+    NLA_PUT(*msg, NL80211_ATTR_VENDOR_DATA, cmd->data_len, cmd->data);
+
+    return ret;
+
+nla_put_failure:
+    ret = -ETRANSNL80211ERR;
+    morsectrl_nl80211_error(ret, "Unable to put vendor attributes");
+exit_message_free:
+    nlmsg_free(*msg);
+    *msg = NULL;
+    return ret;
+}
+
+/**
+ * @brief Receive the outstanding acks of submitted commands, so that they are not mistaken for
+ *        the response to a synchronous command.
+ *
+ * @param state State of the transport.
+ * @return      0 on success otherwise relevant error.
+ */
+static int morsectrl_nl80211_drain(struct morsectrl_nl80211_state *state)
+{
+    int ret;
+
+    while (state->outstanding)
+    {
+        ret = nl_recvmsgs(state->nl_socket, state->async_cb);
+        if (ret < ETRANSSUCC && !state->complete_error)
+        {
+            morsectrl_nl80211_error(ret, "Failed to receive outstanding acks");
+            state->outstanding = 0;
+            return ret;
+        }
+        state->complete_error = false;
+    }
+
+    return ETRANSSUCC;
+}
+
+static int morsectrl_nl80211_send(struct morsectrl_transport *transport,
+                                  struct morsectrl_transport_buff *cmd,
+                                  struct morsectrl_transport_buff *resp)
+{
+    int ret = ETRANSSUCC;
+    struct morsectrl_nl80211_state *state;
+    struct nl_msg* msg;
+
+    if (!transport)
+        return -ETRANSNL80211ERR;
+
+    state = nl80211_state(transport);
+    state->data = resp->data;
+    state->len = &resp->data_len;
+
+    ret = morsectrl_nl80211_drain(state);
+    if (ret < ETRANSSUCC)
+        goto exit;
+
+    ret = morsectrl_nl80211_build_msg(state, cmd, NL_AUTO_SEQ, &msg);
+    if (ret < ETRANSSUCC)
+        goto exit;
 
     state->wait_for_ack = true;
     ret = nl_send_auto_complete(state->nl_socket, msg);
@@ -445,7 +626,6 @@ static int morsectrl_nl80211_send(struct morsectrl_transport *transport,
         }
     }
 
-nla_put_failure:
 exit_message_free:
     state->wait_for_ack = false;
     nlmsg_free(msg);
@@ -453,6 +633,73 @@ exit:
     return ret;
 }
 
+/**
+ * @brief Send a command without waiting for the response. The tag is carried in the netlink
+ *        sequence number, which the kernel copies into the response, error and ack.
+ */
+static int morsectrl_nl80211_submit(struct morsectrl_transport *transport,
+                                    struct morsectrl_transport_buff *cmd,
+                                    uint16_t tag)
+{
+    struct morsectrl_nl80211_state *state;
+    struct nl_msg* msg;
+    int ret;
+
+    if (!transport)
+        return -ETRANSNL80211ERR;
+
+    state = nl80211_state(transport);
+
+    ret = morsectrl_nl80211_build_msg(state, cmd, NL80211_ASYNC_SEQ_BASE + tag, &msg);
+    if (ret < ETRANSSUCC)
+        return ret;
+
+    /* Sends as-is, so the explicit sequence number is kept */
+    ret = nl_send_auto_complete(state->nl_socket, msg);
+    if (ret < ETRANSSUCC)
+    {
+        morsectrl_nl80211_error(ret, "Failed to send_auto_complete");
+    }
+    else
+    {
+        state->outstanding++;
+        ret = ETRANSSUCC;
+    }
+
+    nlmsg_free(msg);
+    return ret;
+}
+
+static int morsectrl_nl80211_receive(struct morsectrl_transport *transport,
+                                     morsectrl_transport_complete_fn complete,
+                                     void *arg)
+{
+    struct morsectrl_nl80211_state *state;
+    int ret;
+
+    if (!transport || !complete)
+        return -ETRANSNL80211ERR;
+
+    state = nl80211_state(transport);
+    state->complete = complete;
+    state->complete_arg = arg;
+    state->complete_error = false;
+
+    ret = nl_recvmsgs(state->nl_socket, state->async_cb);
+
+    state->complete = NULL;
+    state->complete_arg = NULL;
+
+    /* An error for a single command has already been passed to the completion function */
+    if (ret < ETRANSSUCC && !state->complete_error)
+    {
+        morsectrl_nl80211_error(ret, "Failed to rcvmsgs");
+        return ret;
+    }
+
+    return ETRANSSUCC;
+}
+
 const char *morsectrl_nl80211_get_ifname(struct morsectrl_transport *transport)
 {
     return nl80211_cfg(transport)->interface_name;
@@ -477,8 +724,12 @@ static const struct morsectrl_transport_ops nl80211_ops = {
     .raw_read = NULL,
     .raw_write = NULL,
     .raw_read_write = NULL,
+    .raw_queue = NULL,
+    .raw_flush = NULL,
     .reset_device = NULL,
     .get_ifname = morsectrl_nl80211_get_ifname,
+    .submit = morsectrl_nl80211_submit,
+    .receive = morsectrl_nl80211_receive,
 };
 
 REGISTER_TRANSPORT(nl80211_ops);
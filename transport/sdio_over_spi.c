@@ -22,6 +22,7 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "../crc.h"
 #include "../utilities.h"
 #include "transport.h"
 #include "transport_private.h"
@@ -95,8 +96,15 @@
 
 #define SDIO_CMD_TIMEOUT_ATTEMPTS       (5000)
 
-/* An optimisation would be to calculate this from the frequency. */
+/*
+ * Padding used until it has been calibrated, which is enough for the slowest supported SPI clock
+ * and chip clock configuration.
+ */
 #define SDIO_INTERBLOCK_DELAY_OCTETS    (250UL)
+/** Number of CMD53s to measure before shrinking the padding */
+#define SDIO_DELAY_CALIBRATION_SAMPLES  (8)
+/** Padding added on top of 1.5 times the most that was measured to be needed */
+#define SDIO_DELAY_MARGIN_OCTETS        (8)
 
 /* TODO Optimise this value. */
 #define SDIO_POST_BYTE_DELAY_OCTETS     (30)
@@ -178,14 +186,8 @@ static void sdio_over_spi_prep_cmd(uint8_t cmd, uint8_t *cmd_hdr)
  */
 static uint8_t sdio_over_spi_calc_cmd_crc_octet(uint8_t *data)
 {
-    uint8_t crc7;
-    uint64_t number = (((uint64_t)data[0]) << 32) |
-                      ((uint64_t)data[1] << 24) |
-                      ((uint64_t)data[2] << 16) |
-                      ((uint64_t)data[3] << 8) |
-                      ((uint64_t)data[4]);
-
-    crc7 = crc7_gen(number, SDIO_CRC_BITS);
+    uint8_t crc7 = crc7_sd(data, SDIO_CRC_BITS / 8);
+
     return ((crc7 << SDIO_CRC_OFFSET) | SDIO_STOP_BIT);
 }
 
@@ -335,6 +337,73 @@ exit:
     return ret;
 }
 
+/**
+ * @brief Start queueing raw transfers, if the transport supports it, so that the CMD52s setting
+ *        up the keyhole and the CMD53 that follows them take a single transaction.
+ *
+ * @param transport The transport structure.
+ * @return          0 on success otherwise relevant error.
+ */
+static int sdio_over_spi_queue(struct morsectrl_transport *transport)
+{
+    struct sdio_over_spi_state *state = sdio_over_spi_get_state(transport);
+    int ret;
+
+    if (!transport->tops->raw_queue || state->queueing)
+        return ETRANSSUCC;
+
+    ret = transport->tops->raw_queue(transport);
+    if (ret)
+        return ret;
+
+    state->queueing = true;
+    state->n_queued_cmd52 = 0;
+    return ETRANSSUCC;
+}
+
+/**
+ * @brief Perform the queued raw transfers and check the responses to any queued CMD52s.
+ *
+ * @param transport The transport structure.
+ * @return          0 on success otherwise relevant error.
+ */
+static int sdio_over_spi_flush(struct morsectrl_transport *transport)
+{
+    struct sdio_over_spi_state *state = sdio_over_spi_get_state(transport);
+    int ret;
+
+    if (!state->queueing)
+        return ETRANSSUCC;
+
+    state->queueing = false;
+
+    ret = transport->tops->raw_flush(transport);
+    if (ret)
+        sdio_over_spi_error(transport, ret, "Failed to perform queued transactions");
+
+    for (size_t ii = 0; ii < state->n_queued_cmd52; ii++)
+    {
+        struct morsectrl_transport_buff *resp_buff = state->queued_cmd52[ii];
+
+        if (!ret && !sdio_over_spi_cmd_find_resp(transport,
+                                                 &resp_buff->data[SDIO_CMD_HDR_LEN],
+                                                 SDIO_CMD_HDR_EXTRA_LEN))
+        {
+            ret = -ETRANSERR;
+            sdio_over_spi_error(transport, ret, "Failed to find CMD52 response");
+        }
+
+        morsectrl_transport_buff_free(resp_buff);
+    }
+    state->n_queued_cmd52 = 0;
+
+    /* Only keyhole writes are queued, so the keyhole is unknown if any of them failed */
+    if (ret)
+        sdio_over_spi_invalidate(transport);
+
+    return ret;
+}
+
 /*
  * CMD52 bits
  * | Start bit  | 1
@@ -371,10 +440,20 @@ static int sdio_over_spi_cmd52(struct morsectrl_transport *transport,
                                uint32_t addr,
                                uint8_t *data)
 {
+    struct sdio_over_spi_state *state = sdio_over_spi_get_state(transport);
     int ret = ETRANSSUCC;
-    struct morsectrl_transport_buff *cmd_buff = sdio_over_spi_alloc_cmd(transport, 52);
+    struct morsectrl_transport_buff *cmd_buff;
     struct morsectrl_transport_buff *resp_buff;
 
+    /* Reads must see their data straight away, so only writes are queued */
+    if (state->queueing && (!write || state->n_queued_cmd52 == SDIO_OVER_SPI_MAX_QUEUED_CMD52))
+    {
+        ret = sdio_over_spi_flush(transport);
+        if (ret)
+            return ret;
+    }
+
+    cmd_buff = sdio_over_spi_alloc_cmd(transport, 52);
     if (!cmd_buff)
     {
         return -ETRANSERR;
@@ -417,6 +496,14 @@ static int sdio_over_spi_cmd52(struct morsectrl_transport *transport,
         goto exit;
     }
 
+    /* The response is only read once the queue is flushed, so check it then */
+    if (state->queueing)
+    {
+        state->queued_cmd52[state->n_queued_cmd52++] = resp_buff;
+        resp_buff = NULL;
+        goto exit;
+    }
+
     if (!sdio_over_spi_cmd_find_resp(transport,
                                      &resp_buff->data[SDIO_CMD_HDR_LEN],
                                      SDIO_CMD_HDR_EXTRA_LEN))
@@ -522,6 +609,62 @@ static uint8_t *sdio_over_spi_cmd53_find_ack(struct morsectrl_transport *transpo
     return NULL;
 }
 
+/**
+ * @brief Get the padding to give the chip to respond to a CMD53.
+ *
+ * @param state The SDIO over SPI state.
+ * @param delay Calibration for the kind of CMD53.
+ * @return      The padding in octets.
+ */
+static uint16_t sdio_over_spi_delay_octets(const struct sdio_over_spi_state *state,
+                                           const struct sdio_over_spi_delay *delay)
+{
+    if (state->delay_octets)
+        return state->delay_octets;
+
+    return delay->calibrated ? delay->octets : SDIO_INTERBLOCK_DELAY_OCTETS;
+}
+
+/**
+ * @brief Record how much padding a CMD53 needed, and shrink the padding once enough CMD53s have
+ *        been measured.
+ *
+ * @param transport The transport structure.
+ * @param delay     Calibration for the kind of CMD53.
+ * @param needed    Padding the CMD53 needed in octets.
+ * @param name      Name of the kind of CMD53, for debug.
+ */
+static void sdio_over_spi_delay_sample(struct morsectrl_transport *transport,
+                                       struct sdio_over_spi_delay *delay,
+                                       uint16_t needed,
+                                       const char *name)
+{
+    if (delay->calibrated || sdio_over_spi_get_state(transport)->delay_octets)
+        return;
+
+    delay->max_needed = MAX(delay->max_needed, needed);
+
+    if (++delay->samples < SDIO_DELAY_CALIBRATION_SAMPLES)
+        return;
+
+    delay->octets = MIN(delay->max_needed + (delay->max_needed / 2) + SDIO_DELAY_MARGIN_OCTETS,
+                        SDIO_INTERBLOCK_DELAY_OCTETS);
+    delay->calibrated = true;
+
+    if (transport->debug)
+        mctrl_print("Calibrated %s padding to %u octets\n", name, delay->octets);
+}
+
+/**
+ * @brief Forget the calibrated padding so that it is measured again.
+ *
+ * @param delay Calibration to reset.
+ */
+static void sdio_over_spi_delay_reset(struct sdio_over_spi_delay *delay)
+{
+    memset(delay, 0, sizeof(*delay));
+}
+
 /**
  * @brief Perform an SDIO CMD53. Read/writes word aligned data from/to a 32-bit chip memory address.
  *
@@ -535,17 +678,23 @@ static uint8_t *sdio_over_spi_cmd53_find_ack(struct morsectrl_transport *transpo
  * @param block_mode    Whether transaction uses block mode.
  * @param addr          Address to write to or read from.
  * @param count         Number of blocks in block mode, otherwise number of octets (word aligned).
+ * @param[out] retry    Set if the command failed because the calibrated padding was too short,
+ *                      in which case the calibration has been reset.
  * @return              0 on success otherwise relevant error.
  */
-static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
-                               struct morsectrl_transport_buff *data,
-                               bool write,
-                               uint8_t func,
-                               bool block_mode,
-                               uint32_t addr,
-                               uint16_t count)
+static int sdio_over_spi_cmd53_transfer(struct morsectrl_transport *transport,
+                                        struct morsectrl_transport_buff *data,
+                                        bool write,
+                                        uint8_t func,
+                                        bool block_mode,
+                                        uint32_t addr,
+                                        uint16_t count,
+                                        bool *retry)
 {
     const struct morsectrl_transport_ops *tops = transport->tops;
+    struct sdio_over_spi_state *state = sdio_over_spi_get_state(transport);
+    struct sdio_over_spi_delay *delay = NULL;
+    uint16_t delay_needed = 0;
     struct morsectrl_transport_buff *full_trans;
     struct morsectrl_transport_buff *resp;
     uint8_t *cmd_hdr;
@@ -559,11 +708,20 @@ static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
     int ret;
     uint16_t crc16;
 
+    *retry = false;
+
     /* Constuct a complete transaction with CMD, CMD response, Read/Write. */
     if (write)
     {
-        post_block_delay_bytes =
-            block_mode ? SDIO_INTERBLOCK_DELAY_OCTETS : SDIO_POST_BYTE_DELAY_OCTETS;
+        if (block_mode)
+        {
+            delay = &state->write_delay;
+            post_block_delay_bytes = sdio_over_spi_delay_octets(state, delay);
+        }
+        else
+        {
+            post_block_delay_bytes = SDIO_POST_BYTE_DELAY_OCTETS;
+        }
         total_block_size = SDIO_TOKEN_LEN + block_size + SDIO_CRC_OCTETS + post_block_delay_bytes;
         if (!block_mode)
         {
@@ -584,11 +742,9 @@ static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
     {
         if (!block_mode)
         {
-            /* Interblock delay is timing based so scale with size when less than a full block.
-             * TODO optimise this value.
-             */
-            post_block_delay_bytes =
-                SDIO_INTERBLOCK_DELAY_OCTETS;
+            /* The time taken for the data to be ready depends on the SPI and chip clocks. */
+            delay = &state->read_delay;
+            post_block_delay_bytes = sdio_over_spi_delay_octets(state, delay);
 
             total_block_size = SDIO_TOKEN_BYTE_READ_LEN +
                                block_size +
@@ -628,6 +784,7 @@ static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
     {
         ret = -ETRANSERR;
         sdio_over_spi_error(transport, ret, "CMD53 failed to allocate buffers");
+        sdio_over_spi_flush(transport);
         morsectrl_transport_buff_free(full_trans);
         morsectrl_transport_buff_free(resp);
         return ret;
@@ -670,7 +827,7 @@ static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
                    &data->data[ii * block_size],
                    block_size);
 
-            crc16 = crc16_gen(&data->data[ii * block_size], block_size);
+            crc16 = crc16_xmodem(0, &data->data[ii * block_size], block_size);
             full_trans->data[crc_offset] = crc16 >> 8;
             full_trans->data[crc_offset + 1] = crc16 & 0xFF;
 
@@ -688,14 +845,19 @@ static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
                full_trans->data_len - SDIO_CMD_HDR_LEN);
     }
 
-    /* Send the entire command, including the data. */
+    /* Send the entire command, including the data, along with anything queued before it. */
     ret = tops->raw_read_write(transport, resp, full_trans, true, true);
     if (ret)
     {
         sdio_over_spi_error(transport, ret, "CMD53 Read/Write error");
+        sdio_over_spi_flush(transport);
         goto exit;
     }
 
+    ret = sdio_over_spi_flush(transport);
+    if (ret)
+        goto exit;
+
     /* Check for command success. */
     if (!sdio_over_spi_cmd_find_resp(transport,
                                      &resp->data[SDIO_CMD_HDR_LEN],
@@ -714,6 +876,9 @@ static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
         for (ii = 0; ii < loop_count; ii++)
         {
             size_t start_idx = ii * total_block_size;
+            uint8_t *block_end = &ptr[start_idx + total_block_size];
+            uint8_t *delay_start =
+                &ptr[start_idx + SDIO_TOKEN_LEN + block_size + SDIO_CRC_OCTETS];
             uint8_t *ack;
 
             ack = sdio_over_spi_cmd53_find_ack(transport, &ptr[start_idx], total_block_size);
@@ -721,8 +886,16 @@ static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
             {
                 ret = -ETRANSERR;
                 sdio_over_spi_error(transport, ret, "CMD53 Write block ack error");
+                *retry = delay && delay->calibrated && !state->delay_octets;
                 goto exit;
             }
+
+            /* The chip is busy until it releases the line, which the next block must wait for */
+            while (ack < block_end && *ack != SDIO_JUNK_TOKEN)
+                ack++;
+
+            if (ack > delay_start)
+                delay_needed = MAX(delay_needed, (uint16_t)(ack - delay_start));
         }
     }
     /* Process read. */
@@ -732,16 +905,22 @@ static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
 
         for (ii = 0; ii < loop_count; ii++)
         {
+            uint8_t *search_start = ptr;
+
             ptr = sdio_over_spi_cmd53_find_token(transport, ptr, post_block_delay_bytes);
 
             if (!ptr)
             {
                 ret = -ETRANSERR;
                 sdio_over_spi_error(transport, ret, "CMD53 Read start token missing.");
+                *retry = delay && delay->calibrated && !state->delay_octets;
                 goto exit;
             }
 
-            if (!crc16_check(ptr, block_size, (ptr[block_size] << 8) + ptr[block_size + 1]))
+            /* The search covers one octet less than the padding, and the token is before ptr */
+            delay_needed = MAX(delay_needed, (uint16_t)(ptr - search_start + 1));
+
+            if (crc16_xmodem(0, ptr, block_size) != ((ptr[block_size] << 8) | ptr[block_size + 1]))
             {
                 ret = -ETRANSERR;
                 sdio_over_spi_error(transport, ret, "CMD53 Read block CRC error");
@@ -753,13 +932,57 @@ static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
         }
     }
 
+    if (delay)
+        sdio_over_spi_delay_sample(transport, delay, delay_needed, write ? "write" : "read");
+
 exit:
+    if (*retry)
+        sdio_over_spi_delay_reset(delay);
+
     morsectrl_transport_buff_free(full_trans);
     morsectrl_transport_buff_free(resp);
 
     return ret;
 }
 
+/**
+ * @brief Perform an SDIO CMD53, retrying with the default padding if the calibrated padding turns
+ *        out to be too short (e.g. after the chip clock has been changed).
+ *
+ * @param transport     The transport structure.
+ * @param data          Buffer to read data from or write data into.
+ * @param write         Whether this command is a write (otherwise it is a read).
+ * @param func          Function to perform the command on.
+ * @param block_mode    Whether transaction uses block mode.
+ * @param addr          Address to write to or read from.
+ * @param count         Number of blocks in block mode, otherwise number of octets (word aligned).
+ * @return              0 on success otherwise relevant error.
+ */
+static int sdio_over_spi_cmd53(struct morsectrl_transport *transport,
+                               struct morsectrl_transport_buff *data,
+                               bool write,
+                               uint8_t func,
+                               bool block_mode,
+                               uint32_t addr,
+                               uint16_t count)
+{
+    bool retry;
+    int ret;
+
+    ret = sdio_over_spi_cmd53_transfer(transport, data, write, func, block_mode, addr, count,
+                                       &retry);
+    if (ret && retry)
+    {
+        if (transport->debug)
+            mctrl_print("Retrying CMD53 with the default padding\n");
+
+        ret = sdio_over_spi_cmd53_transfer(transport, data, write, func, block_mode, addr, count,
+                                           &retry);
+    }
+
+    return ret;
+}
+
 int sdio_over_spi_read_reg_32bit(struct morsectrl_transport *transport,
                                  uint32_t addr,
                                  uint32_t *data)
@@ -820,35 +1043,62 @@ int sdio_over_spi_write_reg_32bit(struct morsectrl_transport *transport,
     return ret;
 }
 
+void sdio_over_spi_invalidate(struct morsectrl_transport *transport)
+{
+    sdio_over_spi_get_state(transport)->keyhole_valid = false;
+}
+
 static int sdio_over_spi_setup_keyhole(struct morsectrl_transport *transport,
                                        uint32_t addr, size_t size)
 {
+    struct sdio_over_spi_state *state = sdio_over_spi_get_state(transport);
     int ret;
     uint8_t key_win0 = MM_ADDR_TO_KEYHOLE_WIN0(addr);
     uint8_t key_win1 = MM_ADDR_TO_KEYHOLE_WIN1(addr);
     uint8_t key_cfg = MM_SIZE_TO_CFG(size);
 
-    /* Always write keyhole registers because the overhead should be small. */
-    ret = sdio_over_spi_cmd52(transport, true, SDIO_FUNC_REG, MM_KEYHOLE_ADDR_WIN0, &key_win0);
-    if (ret)
+    /*
+     * Only write the keyhole registers that differ from what was last written, which for repeated
+     * accesses to the same 64k window (e.g. polling a register) is none of them. Until all three
+     * have been written successfully their values are unknown.
+     */
+    if (!state->keyhole_valid || state->keyhole_win0 != key_win0)
     {
-        sdio_over_spi_error(transport, ret, "Failed to set window0 keyhole reg");
-        return ret;
+        state->keyhole_valid = false;
+        ret = sdio_over_spi_cmd52(transport, true, SDIO_FUNC_REG, MM_KEYHOLE_ADDR_WIN0, &key_win0);
+        if (ret)
+        {
+            sdio_over_spi_error(transport, ret, "Failed to set window0 keyhole reg");
+            return ret;
+        }
     }
-    ret = sdio_over_spi_cmd52(transport, true, SDIO_FUNC_REG, MM_KEYHOLE_ADDR_WIN1, &key_win1);
-    if (ret)
+    if (!state->keyhole_valid || state->keyhole_win1 != key_win1)
     {
-        sdio_over_spi_error(transport, ret, "Failed to set window1 keyhole reg");
-        return ret;
+        state->keyhole_valid = false;
+        ret = sdio_over_spi_cmd52(transport, true, SDIO_FUNC_REG, MM_KEYHOLE_ADDR_WIN1, &key_win1);
+        if (ret)
+        {
+            sdio_over_spi_error(transport, ret, "Failed to set window1 keyhole reg");
+            return ret;
+        }
     }
-    ret = sdio_over_spi_cmd52(transport, true, SDIO_FUNC_REG, MM_KEYHOLE_ADDR_CFG, &key_cfg);
-    if (ret)
+    if (!state->keyhole_valid || state->keyhole_cfg != key_cfg)
     {
-        sdio_over_spi_error(transport, ret, "Failed to set cfg keyhole reg");
-        return ret;
+        state->keyhole_valid = false;
+        ret = sdio_over_spi_cmd52(transport, true, SDIO_FUNC_REG, MM_KEYHOLE_ADDR_CFG, &key_cfg);
+        if (ret)
+        {
+            sdio_over_spi_error(transport, ret, "Failed to set cfg keyhole reg");
+            return ret;
+        }
     }
 
-    return ret;
+    state->keyhole_win0 = key_win0;
+    state->keyhole_win1 = key_win1;
+    state->keyhole_cfg = key_cfg;
+    state->keyhole_valid = true;
+
+    return ETRANSSUCC;
 }
 
 static int sdio_over_spi_memblock_common(struct morsectrl_transport *transport,
@@ -882,10 +1132,14 @@ static int sdio_over_spi_memblock_common(struct morsectrl_transport *transport,
                    chip_mem_addr, chip_mem_addr + current_size - 1);
         }
 
-        ret = sdio_over_spi_setup_keyhole(transport, chip_mem_addr, SDIO_KEYHOLE_SIZE);
+        /* The keyhole writes are sent with the first CMD53, which flushes the queue */
+        ret = sdio_over_spi_queue(transport);
+        if (!ret)
+            ret = sdio_over_spi_setup_keyhole(transport, chip_mem_addr, SDIO_KEYHOLE_SIZE);
         if (ret)
         {
             sdio_over_spi_error(transport, ret, "Failed to set keyhole registers");
+            sdio_over_spi_flush(transport);
             return ret;
         }
 
@@ -904,6 +1158,9 @@ static int sdio_over_spi_memblock_common(struct morsectrl_transport *transport,
                                       true,
                                       chip_mem_addr,
                                       current_size / fn_max_block_size[SDIO_FUNC_MEM_BLOCK]);
+            /* The chip may be in an unknown state, so program the keyhole again next time */
+            if (ret)
+                sdio_over_spi_invalidate(transport);
         }
         buff->data += (current_size - byte_mode_count);
 
@@ -928,6 +1185,8 @@ static int sdio_over_spi_memblock_common(struct morsectrl_transport *transport,
                                       false,
                                       chip_mem_addr + current_size - byte_mode_count,
                                       aligned_count);
+            if (ret)
+                sdio_over_spi_invalidate(transport);
         }
 
         chip_mem_addr += current_size;
@@ -963,6 +1222,11 @@ int sdio_over_spi_post_hard_reset(struct morsectrl_transport *transport)
     int ret;
     uint32_t data32;
 
+    /* The keyhole registers and clocks have been reset along with the chip */
+    sdio_over_spi_invalidate(transport);
+    sdio_over_spi_delay_reset(&sdio_over_spi_get_state(transport)->write_delay);
+    sdio_over_spi_delay_reset(&sdio_over_spi_get_state(transport)->read_delay);
+
     /* First Send a CMD63 */
     for (ii = 0; ii < 3; ii++)
     {
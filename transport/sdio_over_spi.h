@@ -18,11 +18,70 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "transport.h"
 #include "../utilities.h"
 
+/** Most CMD52s that can be queued ahead of a CMD53, enough to program the keyhole */
+#define SDIO_OVER_SPI_MAX_QUEUED_CMD52  (3)
+
+/** Calibration of the padding given to the chip to respond to one kind of CMD53 */
+struct sdio_over_spi_delay
+{
+    /** Whether octets has been shrunk to what was measured */
+    bool calibrated;
+    /** Padding to use once calibrated */
+    uint16_t octets;
+    /** Number of transfers measured so far */
+    uint8_t samples;
+    /** Most padding measured to be needed so far */
+    uint16_t max_needed;
+};
+
+/** State kept by the SDIO over SPI layer for each transport using it */
+struct sdio_over_spi_state
+{
+    /** Whether the keyhole registers are known to hold the values below */
+    bool keyhole_valid;
+    /** Value of the window0 keyhole register */
+    uint8_t keyhole_win0;
+    /** Value of the window1 keyhole register */
+    uint8_t keyhole_win1;
+    /** Value of the cfg keyhole register */
+    uint8_t keyhole_cfg;
+    /** Whether raw transfers are being queued by the transport */
+    bool queueing;
+    /** Responses to queued CMD52s, to be checked once the queue is flushed */
+    struct morsectrl_transport_buff *queued_cmd52[SDIO_OVER_SPI_MAX_QUEUED_CMD52];
+    /** Number of entries in queued_cmd52 */
+    size_t n_queued_cmd52;
+    /** Padding set by the transport config, or 0 to calibrate it */
+    uint16_t delay_octets;
+    /** Padding after each block of a block mode write */
+    struct sdio_over_spi_delay write_delay;
+    /** Padding before the data of a byte mode read */
+    struct sdio_over_spi_delay read_delay;
+};
+
+/**
+ * @brief Get the SDIO over SPI state of a transport.
+ *
+ * @note This must be provided by the transport using this layer.
+ *
+ * @param transport The transport structure.
+ * @return          The state.
+ */
+struct sdio_over_spi_state *sdio_over_spi_get_state(struct morsectrl_transport *transport);
+
+/**
+ * @brief Forget the cached keyhole register values, e.g. after the chip may have been reset.
+ *
+ * @param transport The transport structure.
+ */
+void sdio_over_spi_invalidate(struct morsectrl_transport *transport);
+
 /**
  * @brief Read a 32bit register (or word aligned memory location).
  *
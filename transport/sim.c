@@ -0,0 +1,1127 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Simulated chip, for exercising and benchmarking the host side without hardware.
+ *
+ * The chip is modelled as a sparse memory map that reads as zero until written. Commands are
+ * passed through the same host table mailbox as with ftdi_spi: the manifest register points to a
+ * host table giving the command and response mailbox addresses, the command is written to its
+ * mailbox, the trigger register is written, and the response is read back once the status
+ * register shows it is ready. Every register, memory and raw access can be slowed down by a
+ * fixed latency, which can be set separately for each kind of access, and a bandwidth, so that
+ * timings are reproducible.
+ *
+ * The simulated firmware answers:
+ * * commands listed in a response script, with the given status and payload
+ * * statistics commands, with a TLV for each numeric statistic in a firmware ELF file's offchip
+ *   table, whose values count up on each read
+ * * the version command, with "sim"
+ * * any other command, with success and no payload
+ *
+ * A response script has one response per line, '#' starting a comment:
+ *
+ *      <message id> <status> [<payload as hex octets>]
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "transport.h"
+#include "transport_private.h"
+#include "host_table.h"
+#include "../command.h"
+#include "../elf_file.h"
+#include "../offchip_statistics.h"
+#include "../portable_endian.h"
+#include "../utilities.h"
+
+#define SIM_STR_LATENCY_US          "latency_us"
+#define SIM_STR_REG_LATENCY_US      "reg_latency_us"
+#define SIM_STR_MEM_LATENCY_US      "mem_latency_us"
+#define SIM_STR_RAW_LATENCY_US      "raw_latency_us"
+#define SIM_STR_BANDWIDTH_KBPS      "bandwidth_kbps"
+#define SIM_STR_FIRMWARE            "firmware"
+#define SIM_STR_RESPONSES           "responses"
+#define SIM_STR_HELP                "help"
+
+#define SIM_MAX_PATH_LEN            (256)
+/** Maximum length of a line of a response script */
+#define SIM_MAX_LINE_LEN            (8192)
+/** Size of each page of the simulated memory map */
+#define SIM_PAGE_SIZE               (64 * 1024UL)
+
+/** Location of the simulated firmware's host table and mailboxes */
+#define SIM_HOST_TABLE_ADDR         (0x80100000)
+#define SIM_CMD_ADDR                (0x80110000)
+#define SIM_RESP_ADDR               (0x80120000)
+#define SIM_MAILBOX_SIZE            (SIM_RESP_ADDR - SIM_CMD_ADDR)
+
+/** Version string reported by the simulated firmware */
+#define SIM_VERSION                 "sim"
+
+/** Latency of a kind of access that has not been configured, so latency_us is used */
+#define SIM_LATENCY_DEFAULT         UINT32_MAX
+
+static const struct morsectrl_transport_ops sim_ops;
+
+/** Kinds of access that can be given their own latency */
+enum sim_access
+{
+    /** Register reads and writes */
+    SIM_ACCESS_REG,
+    /** Memory reads and writes */
+    SIM_ACCESS_MEM,
+    /** Raw reads and writes, and flushes of queued raw transfers */
+    SIM_ACCESS_RAW,
+    SIM_ACCESS_COUNT,
+};
+
+struct sim_cfg
+{
+    /** Time added to every access whose kind has no latency of its own */
+    uint32_t latency_us;
+    /** Time added to each kind of access (enum sim_access), SIM_LATENCY_DEFAULT for latency_us */
+    uint32_t access_latency_us[SIM_ACCESS_COUNT];
+    /** Rate at which accesses transfer data, 0 for unlimited */
+    uint32_t bandwidth_kbps;
+    /** Firmware ELF file whose statistics are simulated, empty for none */
+    char firmware[SIM_MAX_PATH_LEN];
+    /** Response script, empty for none */
+    char responses[SIM_MAX_PATH_LEN];
+};
+
+/** A page of simulated memory */
+struct sim_page
+{
+    uint32_t base;
+    uint8_t data[SIM_PAGE_SIZE];
+};
+
+/** A statistic reported by the simulated firmware */
+struct sim_stat
+{
+    stats_tlv_tag_t tag;
+    uint8_t len;
+    uint64_t value;
+};
+
+/** A response from the response script */
+struct sim_scripted_response
+{
+    uint16_t message_id;
+    uint32_t status;
+    uint8_t *payload;
+    size_t len;
+};
+
+/** A response to a submitted command that has not yet been received */
+struct sim_pending_response
+{
+    uint16_t tag;
+    uint8_t *data;
+    size_t len;
+};
+
+/** @brief Data structure used to represent an instance of this transport. */
+struct morsectrl_sim_transport
+{
+    struct morsectrl_transport common;
+    struct sim_cfg config;
+    /** Pages of memory that have been written, in no particular order */
+    struct sim_page **pages;
+    size_t n_pages;
+    /** Value of the status register */
+    uint32_t status;
+    /** Whether the command and response mailbox addresses are known */
+    bool mailbox_valid;
+    uint32_t cmd_addr;
+    uint32_t resp_addr;
+    /** Whether raw transfers are being queued, and the octets queued so far */
+    bool queueing;
+    size_t queued_octets;
+    struct sim_stat *stats;
+    size_t n_stats;
+    struct sim_scripted_response *scripted;
+    size_t n_scripted;
+    struct sim_pending_response *pending;
+    size_t n_pending;
+    /** Buffer the response to a command is built in before being written to its mailbox */
+    uint8_t resp_buf[SIM_MAILBOX_SIZE];
+};
+
+static struct morsectrl_sim_transport *sim_transport(struct morsectrl_transport *transport)
+{
+    return (struct morsectrl_sim_transport *)transport;
+}
+
+static void sim_error(int error_code, char *error_msg)
+{
+    morsectrl_transport_err("SIM", error_code, error_msg);
+}
+
+/**
+ * @brief Wait for as long as an access of the given size would take.
+ *
+ * While raw transfers are being queued only their size is recorded, and the wait for all of them
+ * happens when they are flushed.
+ *
+ * @param sim       Transport state.
+ * @param access    Kind of access.
+ * @param octets    Number of octets transferred.
+ */
+static void sim_delay(struct morsectrl_sim_transport *sim, enum sim_access access, size_t octets)
+{
+    uint64_t delay_us = sim->config.access_latency_us[access];
+
+    if (sim->config.bandwidth_kbps)
+        delay_us += ((uint64_t)octets * 8000) / sim->config.bandwidth_kbps;
+
+    if (delay_us)
+        sleep_us(MIN(delay_us, (uint64_t)UINT32_MAX));
+}
+
+/**
+ * @brief Find the page of simulated memory holding an address.
+ *
+ * @param sim       Transport state.
+ * @param addr      Address within the page.
+ * @param create    Whether to create the page if it does not yet exist.
+ * @return          the page, or NULL if it does not exist and was not created.
+ */
+static struct sim_page *sim_page(struct morsectrl_sim_transport *sim, uint32_t addr, bool create)
+{
+    uint32_t base = addr & ~(SIM_PAGE_SIZE - 1);
+    struct sim_page **pages;
+    struct sim_page *page;
+
+    for (size_t ii = 0; ii < sim->n_pages; ii++)
+    {
+        if (sim->pages[ii]->base == base)
+            return sim->pages[ii];
+    }
+
+    if (!create)
+        return NULL;
+
+    pages = realloc(sim->pages, (sim->n_pages + 1) * sizeof(*pages));
+    if (!pages)
+        return NULL;
+    sim->pages = pages;
+
+    page = calloc(1, sizeof(*page));
+    if (!page)
+        return NULL;
+
+    page->base = base;
+    sim->pages[sim->n_pages++] = page;
+
+    return page;
+}
+
+/**
+ * @brief Read from the simulated memory. Memory that has never been written reads as zero.
+ */
+static void sim_memory_read(struct morsectrl_sim_transport *sim, uint32_t addr,
+                            uint8_t *buf, size_t len)
+{
+    while (len)
+    {
+        uint32_t offset = addr & (SIM_PAGE_SIZE - 1);
+        size_t chunk = MIN(len, SIM_PAGE_SIZE - offset);
+        struct sim_page *page = sim_page(sim, addr, false);
+
+        if (page)
+            memcpy(buf, page->data + offset, chunk);
+        else
+            memset(buf, 0, chunk);
+
+        addr += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+}
+
+/**
+ * @brief Write to the simulated memory.
+ *
+ * @return 0 on success otherwise relevant error.
+ */
+static int sim_memory_write(struct morsectrl_sim_transport *sim, uint32_t addr,
+                            const uint8_t *buf, size_t len)
+{
+    while (len)
+    {
+        uint32_t offset = addr & (SIM_PAGE_SIZE - 1);
+        size_t chunk = MIN(len, SIM_PAGE_SIZE - offset);
+        struct sim_page *page = sim_page(sim, addr, true);
+
+        if (!page)
+            return -ETRANSNOMEM;
+
+        memcpy(page->data + offset, buf, chunk);
+
+        addr += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+
+    return ETRANSSUCC;
+}
+
+static int sim_memory_write_32bit(struct morsectrl_sim_transport *sim, uint32_t addr,
+                                  uint32_t value)
+{
+    value = htole32(value);
+    return sim_memory_write(sim, addr, (const uint8_t *)&value, sizeof(value));
+}
+
+/**
+ * @brief Free the simulated memory and set up the simulated firmware's host table.
+ *
+ * @return 0 on success otherwise relevant error.
+ */
+static int sim_memory_reset(struct morsectrl_sim_transport *sim)
+{
+    int ret;
+
+    for (size_t ii = 0; ii < sim->n_pages; ii++)
+        free(sim->pages[ii]);
+    free(sim->pages);
+    sim->pages = NULL;
+    sim->n_pages = 0;
+    sim->status = 0;
+    sim->mailbox_valid = false;
+
+    ret = sim_memory_write_32bit(sim, MM_MANIFEST_ADDR, SIM_HOST_TABLE_ADDR);
+    if (!ret)
+        ret = sim_memory_write_32bit(sim, SIM_HOST_TABLE_ADDR + MM_CMD_ADDR_OFFSET, SIM_CMD_ADDR);
+    if (!ret)
+        ret = sim_memory_write_32bit(sim, SIM_HOST_TABLE_ADDR + MM_RESP_ADDR_OFFSET,
+                                     SIM_RESP_ADDR);
+
+    return ret;
+}
+
+/**
+ * @brief Get the size of a statistic from its firmware type.
+ *
+ * @return the size in octets, or 0 if the type is not a simple integer.
+ */
+static uint8_t sim_stat_len(const char *type)
+{
+    if (strchr(type, '[') || strchr(type, '*') || strstr(type, "struct"))
+        return 0;
+    if (strstr(type, "64"))
+        return sizeof(uint64_t);
+    if (strstr(type, "16"))
+        return sizeof(uint16_t);
+    if (strstr(type, "8_t") || strstr(type, "bool") || strstr(type, "char"))
+        return sizeof(uint8_t);
+
+    return sizeof(uint32_t);
+}
+
+/**
+ * @brief Load the statistics to simulate from the offchip table of a firmware ELF file.
+ *
+ * Only statistics printed as plain numbers are simulated, as the others have a structure that
+ * the simulation does not know about.
+ *
+ * @return 0 on success otherwise relevant error.
+ */
+static int sim_load_stats(struct morsectrl_sim_transport *sim, const char *filename)
+{
+    struct morsectrl mors = {
+        .debug = sim->common.debug,
+    };
+    int ret;
+
+    ret = morse_stats_load_file(&mors, filename);
+    if (ret)
+    {
+        mctrl_err("Failed to load statistics from %s\n", filename);
+        return -ETRANSERR;
+    }
+
+    sim->stats = calloc(mors.n_stats ? mors.n_stats : 1, sizeof(*sim->stats));
+    if (!sim->stats)
+    {
+        morse_stats_free(&mors);
+        return -ETRANSNOMEM;
+    }
+
+    for (size_t ii = 0; ii < mors.n_stats; ii++)
+    {
+        const struct statistics_offchip_data *offchip = &mors.stats[ii];
+        struct sim_stat *stat = &sim->stats[sim->n_stats];
+
+        if (offchip->format > MORSE_STATS_FMT_0_HEX)
+            continue;
+
+        stat->tag = offchip->tag;
+        stat->len = sim_stat_len(offchip->type_str);
+        if (stat->len)
+            sim->n_stats++;
+    }
+
+    morse_stats_free(&mors);
+    return ETRANSSUCC;
+}
+
+/**
+ * @brief Parse hex octets, optionally separated by whitespace.
+ *
+ * @return the number of octets, or -1 if the string is not valid hex or too long.
+ */
+static int sim_parse_hex(const char *str, uint8_t *buf, size_t size)
+{
+    size_t len = 0;
+
+    while (*str)
+    {
+        unsigned int octet;
+
+        if (isspace((unsigned char)*str))
+        {
+            str++;
+            continue;
+        }
+
+        if (len == size || !isxdigit((unsigned char)str[0]) ||
+            !isxdigit((unsigned char)str[1]) || sscanf(str, "%2x", &octet) != 1)
+            return -1;
+
+        buf[len++] = octet;
+        str += 2;
+    }
+
+    return len;
+}
+
+/**
+ * @brief Load a response script.
+ *
+ * @return 0 on success otherwise relevant error.
+ */
+static int sim_load_responses(struct morsectrl_sim_transport *sim, const char *filename)
+{
+    char line[SIM_MAX_LINE_LEN];
+    uint8_t payload[sizeof(line) / 2];
+    FILE *file;
+    int lineno = 0;
+    int ret = ETRANSSUCC;
+
+    file = fopen(filename, "r");
+    if (!file)
+    {
+        mctrl_err("Could not open response script %s\n", filename);
+        return -ETRANSERR;
+    }
+
+    while (fgets(line, sizeof(line), file))
+    {
+        struct sim_scripted_response *scripted;
+        unsigned int message_id;
+        int status;
+        int consumed = 0;
+        int len;
+        char *comment = strchr(line, '#');
+
+        lineno++;
+
+        if (comment)
+            *comment = '\0';
+
+        if (sscanf(line, " %i %i %n", &message_id, &status, &consumed) < 2)
+        {
+            if (sscanf(line, " %n", &consumed) >= 0 && line[consumed] == '\0')
+                continue;
+
+            mctrl_err("%s:%d: expected <message id> <status> [<payload>]\n", filename, lineno);
+            ret = -ETRANSERR;
+            break;
+        }
+
+        len = sim_parse_hex(line + consumed, payload, sizeof(payload));
+        if (len < 0 || message_id > UINT16_MAX)
+        {
+            mctrl_err("%s:%d: invalid response\n", filename, lineno);
+            ret = -ETRANSERR;
+            break;
+        }
+
+        scripted = realloc(sim->scripted, (sim->n_scripted + 1) * sizeof(*scripted));
+        if (!scripted)
+        {
+            ret = -ETRANSNOMEM;
+            break;
+        }
+        sim->scripted = scripted;
+        scripted = &sim->scripted[sim->n_scripted];
+
+        scripted->message_id = message_id;
+        scripted->status = status;
+        scripted->len = len;
+        scripted->payload = malloc(len ? len : 1);
+        if (!scripted->payload)
+        {
+            ret = -ETRANSNOMEM;
+            break;
+        }
+        memcpy(scripted->payload, payload, len);
+        sim->n_scripted++;
+    }
+
+    fclose(file);
+    return ret;
+}
+
+/**
+ * @brief Build the payload of a statistics response, advancing each statistic.
+ *
+ * @return the length of the payload.
+ */
+static size_t sim_stats_payload(struct morsectrl_sim_transport *sim, uint8_t *buf, size_t size)
+{
+    size_t len = 0;
+
+    for (size_t ii = 0; ii < sim->n_stats; ii++)
+    {
+        struct sim_stat *stat = &sim->stats[ii];
+        uint16_t tag = htole16(stat->tag);
+        uint16_t tlv_len = htole16(stat->len);
+        uint64_t value;
+
+        if (len + STATS_TLV_OVERHEAD + stat->len > size)
+            break;
+
+        stat->value += stat->tag + 1;
+        value = htole64(stat->value);
+
+        memcpy(buf + len, &tag, sizeof(tag));
+        memcpy(buf + len + sizeof(tag), &tlv_len, sizeof(tlv_len));
+        memcpy(buf + len + STATS_TLV_OVERHEAD, &value, stat->len);
+        len += STATS_TLV_OVERHEAD + stat->len;
+    }
+
+    return len;
+}
+
+/**
+ * @brief Run the command in the command mailbox and put the response in the response mailbox.
+ *
+ * @return 0 on success otherwise relevant error.
+ */
+static int sim_run_command(struct morsectrl_sim_transport *sim)
+{
+    uint8_t *buf = sim->resp_buf;
+    struct command_hdr hdr;
+    struct response *response = (struct response *)buf;
+    size_t max_payload = sizeof(sim->resp_buf) - sizeof(*response);
+    size_t payload_len = 0;
+    uint32_t status = 0;
+    uint16_t message_id;
+    size_t ii;
+
+    sim_memory_read(sim, SIM_CMD_ADDR, (uint8_t *)&hdr, sizeof(hdr));
+    message_id = le16toh(hdr.message_id);
+
+    for (ii = 0; ii < sim->n_scripted; ii++)
+    {
+        if (sim->scripted[ii].message_id == message_id)
+            break;
+    }
+
+    if (ii < sim->n_scripted)
+    {
+        status = sim->scripted[ii].status;
+        payload_len = MIN(sim->scripted[ii].len, max_payload);
+        memcpy(response->data, sim->scripted[ii].payload, payload_len);
+    }
+    else if (message_id == MORSE_COMMAND_APP_STATS_LOG ||
+             message_id == MORSE_COMMAND_MAC_STATS_LOG ||
+             message_id == MORSE_COMMAND_UPHY_STATS_LOG)
+    {
+        payload_len = sim_stats_payload(sim, response->data, max_payload);
+    }
+    else if (message_id == MORSE_COMMAND_APP_STATS_RESET ||
+             message_id == MORSE_COMMAND_MAC_STATS_RESET ||
+             message_id == MORSE_COMMAND_UPHY_STATS_RESET)
+    {
+        for (ii = 0; ii < sim->n_stats; ii++)
+            sim->stats[ii].value = 0;
+    }
+    else if (message_id == MORSE_COMMAND_GET_VERSION)
+    {
+        int32_t version_len = htole32(strlen(SIM_VERSION));
+
+        memcpy(response->data, &version_len, sizeof(version_len));
+        memcpy(response->data + sizeof(version_len), SIM_VERSION, strlen(SIM_VERSION));
+        payload_len = sizeof(version_len) + strlen(SIM_VERSION);
+    }
+
+    response->hdr = hdr;
+    response->hdr.len = htole16(sizeof(response->status) + payload_len);
+    response->status = htole32(status);
+
+    return sim_memory_write(sim, SIM_RESP_ADDR, buf, sizeof(*response) + payload_len);
+}
+
+static int sim_reg_read(struct morsectrl_transport *transport, uint32_t addr, uint32_t *value)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+
+    if (!transport || !value || (addr & 0x3))
+        return -ETRANSERR;
+
+    sim_delay(sim, SIM_ACCESS_REG, sizeof(*value));
+
+    if (addr == MM_STATUS_ADDR)
+    {
+        *value = sim->status;
+    }
+    else
+    {
+        sim_memory_read(sim, addr, (uint8_t *)value, sizeof(*value));
+        *value = le32toh(*value);
+    }
+
+    return ETRANSSUCC;
+}
+
+static int sim_reg_write(struct morsectrl_transport *transport, uint32_t addr, uint32_t value)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+    int ret;
+
+    if (!transport || (addr & 0x3))
+        return -ETRANSERR;
+
+    sim_delay(sim, SIM_ACCESS_REG, sizeof(value));
+
+    if (addr == MM_STATUS_CLR_ADDR)
+    {
+        sim->status &= ~value;
+        return ETRANSSUCC;
+    }
+
+    if (addr == MM_TRIGGER_ADDR && (value & MM_CMD_MASK))
+    {
+        ret = sim_run_command(sim);
+        if (ret)
+            return ret;
+
+        sim->status |= MM_CMD_MASK;
+        return ETRANSSUCC;
+    }
+
+    return sim_memory_write_32bit(sim, addr, value);
+}
+
+static int sim_mem_read(struct morsectrl_transport *transport,
+                        struct morsectrl_transport_buff *read, uint32_t addr)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+
+    if (!transport || !read || (addr & 0x3))
+        return -ETRANSERR;
+
+    sim_delay(sim, SIM_ACCESS_MEM, read->data_len);
+    sim_memory_read(sim, addr, read->data, read->data_len);
+
+    return ETRANSSUCC;
+}
+
+static int sim_mem_write(struct morsectrl_transport *transport,
+                         struct morsectrl_transport_buff *write, uint32_t addr)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+
+    if (!transport || !write || (addr & 0x3))
+        return -ETRANSERR;
+
+    sim_delay(sim, SIM_ACCESS_MEM, write->data_len);
+    return sim_memory_write(sim, addr, write->data, write->data_len);
+}
+
+/**
+ * @brief Account for a raw transfer, which has nothing to talk to beyond taking time.
+ */
+static void sim_raw_transfer(struct morsectrl_sim_transport *sim, size_t octets)
+{
+    if (sim->queueing)
+        sim->queued_octets += octets;
+    else
+        sim_delay(sim, SIM_ACCESS_RAW, octets);
+}
+
+static int sim_raw_read(struct morsectrl_transport *transport,
+                        struct morsectrl_transport_buff *read, bool start, bool finish)
+{
+    if (!transport || !read)
+        return -ETRANSERR;
+
+    /* An idle bus reads as all ones */
+    memset(read->data, 0xff, read->data_len);
+    sim_raw_transfer(sim_transport(transport), read->data_len);
+
+    return ETRANSSUCC;
+}
+
+static int sim_raw_write(struct morsectrl_transport *transport,
+                         struct morsectrl_transport_buff *write, bool start, bool finish)
+{
+    if (!transport || !write)
+        return -ETRANSERR;
+
+    sim_raw_transfer(sim_transport(transport), write->data_len);
+
+    return ETRANSSUCC;
+}
+
+static int sim_raw_read_write(struct morsectrl_transport *transport,
+                              struct morsectrl_transport_buff *read,
+                              struct morsectrl_transport_buff *write, bool start, bool finish)
+{
+    if (!transport || !read || !write)
+        return -ETRANSERR;
+
+    memset(read->data, 0xff, read->data_len);
+    sim_raw_transfer(sim_transport(transport), MAX(read->data_len, write->data_len));
+
+    return ETRANSSUCC;
+}
+
+static int sim_raw_queue(struct morsectrl_transport *transport)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+
+    sim->queueing = true;
+
+    return ETRANSSUCC;
+}
+
+static int sim_raw_flush(struct morsectrl_transport *transport)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+
+    if (sim->queueing && sim->queued_octets)
+        sim_delay(sim, SIM_ACCESS_RAW, sim->queued_octets);
+
+    sim->queueing = false;
+    sim->queued_octets = 0;
+
+    return ETRANSSUCC;
+}
+
+/**
+ * @brief Get the mailbox addresses from the host table, as ftdi_spi does.
+ *
+ * @return 0 on success otherwise relevant error.
+ */
+static int sim_lookup_mailbox(struct morsectrl_transport *transport)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+    uint32_t host_table_ptr;
+    int ret;
+
+    if (sim->mailbox_valid)
+        return ETRANSSUCC;
+
+    ret = sim_reg_read(transport, MM_MANIFEST_ADDR, &host_table_ptr);
+    if (!ret)
+        ret = sim_reg_read(transport, host_table_ptr + MM_CMD_ADDR_OFFSET, &sim->cmd_addr);
+    if (!ret)
+        ret = sim_reg_read(transport, host_table_ptr + MM_RESP_ADDR_OFFSET, &sim->resp_addr);
+
+    sim->mailbox_valid = !ret;
+    return ret;
+}
+
+static int sim_send(struct morsectrl_transport *transport,
+                    struct morsectrl_transport_buff *cmd,
+                    struct morsectrl_transport_buff *resp)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+    struct response *response;
+    uint32_t status = 0;
+    int ret;
+
+    if (!transport || !cmd || !resp)
+        return -ETRANSERR;
+
+    if (cmd->data_len > SIM_MAILBOX_SIZE)
+    {
+        sim_error(-ETRANSERR, "Command too large for the mailbox");
+        return -ETRANSERR;
+    }
+
+    ret = sim_lookup_mailbox(transport);
+    if (!ret)
+        ret = sim_reg_write(transport, MM_STATUS_CLR_ADDR, MM_CMD_MASK);
+    if (!ret)
+        ret = sim_mem_write(transport, cmd, sim->cmd_addr);
+    if (!ret)
+        ret = sim_reg_write(transport, MM_TRIGGER_ADDR, MM_CMD_MASK);
+    if (!ret)
+        ret = sim_reg_read(transport, MM_STATUS_ADDR, &status);
+    if (!ret && !(status & MM_CMD_MASK))
+        ret = -ETRANSERR;
+    if (!ret)
+        ret = sim_mem_read(transport, resp, sim->resp_addr);
+    if (!ret)
+        ret = sim_reg_write(transport, MM_STATUS_CLR_ADDR, MM_CMD_MASK);
+
+    if (ret)
+    {
+        sim->mailbox_valid = false;
+        sim_error(ret, "Failed to send command");
+        return ret;
+    }
+
+    /* Trim the response to its length, as ftdi_spi does */
+    response = (struct response *)resp->data;
+    resp->data_len = MIN(le16toh(response->hdr.len) + sizeof(response->hdr), resp->capacity);
+
+    return ETRANSSUCC;
+}
+
+/**
+ * @brief Run a command straight away, keeping the response until it is received.
+ */
+static int sim_submit(struct morsectrl_transport *transport,
+                      struct morsectrl_transport_buff *cmd, uint16_t tag)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+    struct morsectrl_transport_buff *resp;
+    struct sim_pending_response *pending;
+    int ret;
+
+    if (!transport || !cmd)
+        return -ETRANSERR;
+
+    pending = realloc(sim->pending, (sim->n_pending + 1) * sizeof(*pending));
+    if (!pending)
+        return -ETRANSNOMEM;
+    sim->pending = pending;
+
+    resp = morsectrl_transport_raw_read_alloc(transport, SIM_MAILBOX_SIZE);
+    if (!resp)
+        return -ETRANSNOMEM;
+
+    ret = sim_send(transport, cmd, resp);
+    if (!ret)
+    {
+        pending = &sim->pending[sim->n_pending];
+        pending->tag = tag;
+        pending->len = resp->data_len;
+        pending->data = malloc(resp->data_len);
+        if (pending->data)
+        {
+            memcpy(pending->data, resp->data, resp->data_len);
+            sim->n_pending++;
+        }
+        else
+        {
+            ret = -ETRANSNOMEM;
+        }
+    }
+
+    morsectrl_transport_buff_free(resp);
+    return ret;
+}
+
+static int sim_receive(struct morsectrl_transport *transport,
+                       morsectrl_transport_complete_fn complete, void *arg)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+    size_t n_pending;
+
+    if (!transport || !complete)
+        return -ETRANSERR;
+
+    if (!sim->n_pending)
+    {
+        sim_error(-ETRANSERR, "No response to receive");
+        return -ETRANSERR;
+    }
+
+    /* The completion function may submit more commands, so only complete those pending now */
+    n_pending = sim->n_pending;
+    for (size_t ii = 0; ii < n_pending; ii++)
+    {
+        struct sim_pending_response pending = sim->pending[ii];
+
+        complete(arg, pending.tag, 0, pending.data, pending.len);
+        free(pending.data);
+    }
+
+    memmove(sim->pending, sim->pending + n_pending,
+            (sim->n_pending - n_pending) * sizeof(*sim->pending));
+    sim->n_pending -= n_pending;
+
+    return ETRANSSUCC;
+}
+
+static int sim_reset(struct morsectrl_transport *transport)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+
+    for (size_t ii = 0; ii < sim->n_stats; ii++)
+        sim->stats[ii].value = 0;
+
+    return sim_memory_reset(sim);
+}
+
+static struct morsectrl_transport_buff *sim_alloc(struct morsectrl_transport *transport,
+                                                  size_t size)
+{
+    struct morsectrl_transport_buff *buff;
+
+    if (!transport || !size)
+        return NULL;
+
+    buff = morsectrl_transport_buff_alloc(transport, size);
+    if (!buff)
+        return NULL;
+
+    buff->data = buff->memblock;
+    buff->data_len = size;
+    memset(buff->data, 0, size);
+
+    return buff;
+}
+
+static bool sim_get_uint32(const char *str, const char *key, uint32_t *value)
+{
+    size_t key_len = strlen(key);
+
+    return !strncmp(str, key, key_len) && str[key_len] == '=' &&
+           !str_to_uint32(&str[key_len + 1], value);
+}
+
+static bool sim_get_string(const char *str, const char *key, char *value, size_t size)
+{
+    size_t key_len = strlen(key);
+
+    if (strncmp(str, key, key_len) || str[key_len] != '=')
+        return false;
+
+    return snprintf(value, size, "%s", &str[key_len + 1]) < (int)size;
+}
+
+static void sim_print_config_usage(void)
+{
+    mctrl_print("<config string> is a comma-separated list of <keyword>=<value>, "
+                "where <keyword> is one of the following\n");
+    mctrl_print("\t%s - Time added to every access (default 0)\n", SIM_STR_LATENCY_US);
+    mctrl_print("\t%s - Time added to register accesses (default %s)\n",
+                SIM_STR_REG_LATENCY_US, SIM_STR_LATENCY_US);
+    mctrl_print("\t%s - Time added to memory accesses (default %s)\n",
+                SIM_STR_MEM_LATENCY_US, SIM_STR_LATENCY_US);
+    mctrl_print("\t%s - Time added to raw transfers and queue flushes (default %s)\n",
+                SIM_STR_RAW_LATENCY_US, SIM_STR_LATENCY_US);
+    mctrl_print("\t%s - Rate at which accesses transfer data, 0 for unlimited (default 0)\n",
+                SIM_STR_BANDWIDTH_KBPS);
+    mctrl_print("\t%s - Firmware ELF file whose statistics are simulated\n", SIM_STR_FIRMWARE);
+    mctrl_print("\t%s - File of '<message id> <status> [<payload hex>]' responses\n",
+                SIM_STR_RESPONSES);
+    mctrl_print("\t%s - Prints this message\n", SIM_STR_HELP);
+}
+
+/**
+ * @brief Parse the configuration for the simulated chip.
+ *
+ * @param transport     The transport structure.
+ * @param debug         Indicates whether debug print statements are enabled.
+ * @param iface_opts    Unused.
+ * @param cfg_opts      Comma separated string with simulation configuration options. May be NULL.
+ * @return              0 on success otherwise relevant error.
+ */
+static int sim_parse(struct morsectrl_transport **transport,
+                     bool debug,
+                     const char *iface_opts,
+                     const char *cfg_opts)
+{
+    struct morsectrl_sim_transport *sim;
+    struct sim_cfg *config;
+    int config_error = 0;
+
+    sim = calloc(1, sizeof(*sim));
+    if (!sim)
+    {
+        mctrl_err("Transport memory allocation failure\n");
+        return -ETRANSNOMEM;
+    }
+
+    sim->common.debug = debug;
+    sim->common.tops = &sim_ops;
+    *transport = &sim->common;
+    config = &sim->config;
+
+    for (size_t ii = 0; ii < SIM_ACCESS_COUNT; ii++)
+        config->access_latency_us[ii] = SIM_LATENCY_DEFAULT;
+
+    if (cfg_opts)
+    {
+        char *cpy = strdup(cfg_opts);
+        char *pos = cpy;
+        char *ptr;
+
+        if (!cpy)
+            return -ETRANSNOMEM;
+
+        while ((ptr = strsep(&pos, ",")) != NULL)
+        {
+            if (!strlen(ptr))
+                continue;
+            if (sim_get_uint32(ptr, SIM_STR_LATENCY_US, &config->latency_us))
+                continue;
+            if (sim_get_uint32(ptr, SIM_STR_REG_LATENCY_US,
+                               &config->access_latency_us[SIM_ACCESS_REG]))
+                continue;
+            if (sim_get_uint32(ptr, SIM_STR_MEM_LATENCY_US,
+                               &config->access_latency_us[SIM_ACCESS_MEM]))
+                continue;
+            if (sim_get_uint32(ptr, SIM_STR_RAW_LATENCY_US,
+                               &config->access_latency_us[SIM_ACCESS_RAW]))
+                continue;
+            if (sim_get_uint32(ptr, SIM_STR_BANDWIDTH_KBPS, &config->bandwidth_kbps))
+                continue;
+            if (sim_get_string(ptr, SIM_STR_FIRMWARE, config->firmware,
+                               sizeof(config->firmware)))
+                continue;
+            if (sim_get_string(ptr, SIM_STR_RESPONSES, config->responses,
+                               sizeof(config->responses)))
+                continue;
+            if (!strcmp(ptr, SIM_STR_HELP))
+            {
+                sim_print_config_usage();
+                exit(ETRANSSUCC);
+            }
+
+            config_error++;
+        }
+
+        free(cpy);
+    }
+
+    if (config_error)
+    {
+        mctrl_err("Simulation configuration error\n");
+        sim_print_config_usage();
+        return ETRANSERR;
+    }
+
+    for (size_t ii = 0; ii < SIM_ACCESS_COUNT; ii++)
+    {
+        if (config->access_latency_us[ii] == SIM_LATENCY_DEFAULT)
+            config->access_latency_us[ii] = config->latency_us;
+    }
+
+    if (debug)
+    {
+        mctrl_print("Reg latency     = %u us\n", config->access_latency_us[SIM_ACCESS_REG]);
+        mctrl_print("Mem latency     = %u us\n", config->access_latency_us[SIM_ACCESS_MEM]);
+        mctrl_print("Raw latency     = %u us\n", config->access_latency_us[SIM_ACCESS_RAW]);
+        mctrl_print("Bandwidth       = %u kbps\n", config->bandwidth_kbps);
+        mctrl_print("Firmware        = %s\n", strlen(config->firmware) ? config->firmware : "N/A");
+        mctrl_print("Responses       = %s\n",
+                    strlen(config->responses) ? config->responses : "N/A");
+    }
+
+    return 0;
+}
+
+static int sim_deinit(struct morsectrl_transport *transport)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+
+    for (size_t ii = 0; ii < sim->n_pages; ii++)
+        free(sim->pages[ii]);
+    free(sim->pages);
+    sim->pages = NULL;
+    sim->n_pages = 0;
+
+    for (size_t ii = 0; ii < sim->n_scripted; ii++)
+        free(sim->scripted[ii].payload);
+    free(sim->scripted);
+    sim->scripted = NULL;
+    sim->n_scripted = 0;
+
+    for (size_t ii = 0; ii < sim->n_pending; ii++)
+        free(sim->pending[ii].data);
+    free(sim->pending);
+    sim->pending = NULL;
+    sim->n_pending = 0;
+
+    free(sim->stats);
+    sim->stats = NULL;
+    sim->n_stats = 0;
+
+    return ETRANSSUCC;
+}
+
+static int sim_init(struct morsectrl_transport *transport)
+{
+    struct morsectrl_sim_transport *sim = sim_transport(transport);
+    int ret;
+
+    ret = sim_memory_reset(sim);
+    if (!ret && strlen(sim->config.firmware))
+        ret = sim_load_stats(sim, sim->config.firmware);
+    if (!ret && strlen(sim->config.responses))
+        ret = sim_load_responses(sim, sim->config.responses);
+
+    if (ret)
+        sim_deinit(transport);
+
+    return ret;
+}
+
+static const struct morsectrl_transport_ops sim_ops = {
+    .name = "sim",
+    .description = "Simulated chip, for testing and benchmarking without hardware",
+    .has_reset = true,
+    .has_driver = false,
+    .parse = sim_parse,
+    .init = sim_init,
+    .deinit = sim_deinit,
+    .write_alloc = sim_alloc,
+    .read_alloc = sim_alloc,
+    .send = sim_send,
+    .reg_read = sim_reg_read,
+    .reg_write = sim_reg_write,
+    .mem_read = sim_mem_read,
+    .mem_write = sim_mem_write,
+    .raw_read = sim_raw_read,
+    .raw_write = sim_raw_write,
+    .raw_read_write = sim_raw_read_write,
+    .raw_queue = sim_raw_queue,
+    .raw_flush = sim_raw_flush,
+    .reset_device = sim_reset,
+    .get_ifname = NULL,
+    .submit = sim_submit,
+    .receive = sim_receive,
+};
+
+REGISTER_TRANSPORT(sim_ops);
@@ -16,6 +16,8 @@
  * <https://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include "slip.h"
 
 enum slip_special_chars
@@ -86,43 +88,50 @@ enum slip_rx_status slip_rx(struct slip_rx_state *state, uint8_t c)
     }
 }
 
-int slip_tx(slip_transport_tx_fn transport_tx_fn, void *transport_tx_arg,
-            const uint8_t *packet, size_t packet_len)
+/**
+ * @brief Find the length of the run of characters that need no escaping.
+ *
+ * @param packet        Start of the run.
+ * @param packet_len    Number of characters remaining in the packet.
+ *
+ * @return the number of characters before the next special character, or @p packet_len if there
+ *         is none.
+ */
+static size_t slip_plain_run_len(const uint8_t *packet, size_t packet_len)
+{
+    size_t len = 0;
+
+    while (len < packet_len && packet[len] != SLIP_FRAME_END && packet[len] != SLIP_FRAME_ESC)
+        len++;
+
+    return len;
+}
+
+size_t slip_encode(const uint8_t *packet, size_t packet_len, uint8_t *out)
 {
-    int ret = 0;
+    uint8_t *pos = out;
 
-    transport_tx_fn(SLIP_FRAME_END, transport_tx_arg);
+    *pos++ = SLIP_FRAME_END;
 
-    while (packet_len-- > 0)
+    while (packet_len > 0)
     {
-        uint8_t c = *packet++;
-        switch (c)
-        {
-            case SLIP_FRAME_ESC:
-                ret = transport_tx_fn(SLIP_FRAME_ESC, transport_tx_arg);
-                if (ret != 0)
-                {
-                    break;
-                }
-                ret = transport_tx_fn(SLIP_FRAME_ESC_ESC, transport_tx_arg);
-                break;
-
-            case SLIP_FRAME_END:
-                ret = transport_tx_fn(SLIP_FRAME_ESC, transport_tx_arg);
-                if (ret != 0)
-                {
-                    break;
-                }
-                ret = transport_tx_fn(SLIP_FRAME_ESC_END, transport_tx_arg);
-                break;
-
-            default:
-                ret = transport_tx_fn(c, transport_tx_arg);
-                break;
-        }
+        size_t run = slip_plain_run_len(packet, packet_len);
+
+        memcpy(pos, packet, run);
+        pos += run;
+        packet += run;
+        packet_len -= run;
+
+        if (packet_len == 0)
+            break;
+
+        *pos++ = SLIP_FRAME_ESC;
+        *pos++ = (*packet == SLIP_FRAME_END) ? SLIP_FRAME_ESC_END : SLIP_FRAME_ESC_ESC;
+        packet++;
+        packet_len--;
     }
 
-    transport_tx_fn(SLIP_FRAME_END, transport_tx_arg);
+    *pos++ = SLIP_FRAME_END;
 
-    return ret;
+    return pos - out;
 }
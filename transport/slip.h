@@ -71,25 +71,17 @@ enum slip_rx_status
  */
 enum slip_rx_status slip_rx(struct slip_rx_state *state, uint8_t c);
 
-/**
- * @brief Function to send a character on the slip transport.
- *
- * @param c     The character to transmit
- * @param arg   Opaque argument, as passed to @c slip_tx().
- *
- * @return 0 on success, otherwise a negative error code.
- */
-typedef int (*slip_transport_tx_fn)(uint8_t c, void *arg);
+/** Maximum length of a packet of @p _len octets once SLIP encoded, including both frame ends */
+#define SLIP_ENCODED_MAX_LEN(_len)  (2 * (_len) + 2)
 
 /**
- * @brief Transmit a packet with with SLIP framing.
+ * @brief Encode a packet with SLIP framing.
  *
- * @param transport_tx_fn   Function to invoke to send characters on the transport.
- * @param transport_tx_arg  Argument to pass to @p transport_tx_fn.
- * @param packet            The packet to transmit.
- * @param packet_len        The length of the packet.
+ * @param packet        The packet to encode.
+ * @param packet_len    The length of the packet.
+ * @param out           Buffer to write the frame to, of at least
+ *                      @c SLIP_ENCODED_MAX_LEN(packet_len) octets.
  *
- * @return 0 on success, otherwise an error code as returned by @p transport_tx_fn.
+ * @return the length of the encoded frame.
  */
-int slip_tx(slip_transport_tx_fn transport_tx_fn, void *transport_tx_arg,
-            const uint8_t *packet, size_t packet_len);
+size_t slip_encode(const uint8_t *packet, size_t packet_len, uint8_t *out);
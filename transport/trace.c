@@ -0,0 +1,169 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef MORSE_WIN_BUILD
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "trace.h"
+#include "../portable_endian.h"
+#include "../utilities.h"
+
+/** Largest payload accepted when reading a record, to reject corrupt lengths */
+#define TRACE_MAX_PAYLOAD_LEN   (16 * 1024 * 1024)
+
+static const char *const trace_record_type_names[] = {
+    [TRACE_RECORD_COMMAND] = "command",
+    [TRACE_RECORD_SUBMIT] = "submit",
+    [TRACE_RECORD_RESPONSE] = "response",
+    [TRACE_RECORD_REG_READ] = "reg_read",
+    [TRACE_RECORD_REG_WRITE] = "reg_write",
+    [TRACE_RECORD_MEM_READ] = "mem_read",
+    [TRACE_RECORD_MEM_WRITE] = "mem_write",
+    [TRACE_RECORD_RAW_READ] = "raw_read",
+    [TRACE_RECORD_RAW_WRITE] = "raw_write",
+    [TRACE_RECORD_RAW_READ_WRITE] = "raw_read_write",
+    [TRACE_RECORD_RESET_DEVICE] = "reset_device",
+};
+
+/** Set a stream to binary mode, so that the C runtime does not translate newline bytes */
+static void trace_set_binary(FILE *stream)
+{
+#ifdef MORSE_WIN_BUILD
+    _setmode(_fileno(stream), _O_BINARY);
+#else
+    (void)stream;
+#endif
+}
+
+const char *trace_record_type_name(uint16_t type)
+{
+    if (type < MORSE_ARRAY_SIZE(trace_record_type_names) && trace_record_type_names[type])
+        return trace_record_type_names[type];
+
+    return "unknown";
+}
+
+int trace_write_header(FILE *out, uint64_t start_us)
+{
+    struct trace_header header = {
+        .magic = TRACE_MAGIC,
+        .version = htole16(TRACE_VERSION),
+        .start_us = htole64(start_us),
+    };
+
+    trace_set_binary(out);
+
+    if (fwrite(&header, sizeof(header), 1, out) != 1)
+        return -1;
+
+    return 0;
+}
+
+int trace_write_record(FILE *out, struct trace_record *rec, const void *data_out,
+                       const void *data_in)
+{
+    struct trace_record le = {
+        .len = htole32(sizeof(*rec) - sizeof(rec->len) + rec->out_len + rec->in_len),
+        .type = htole16(rec->type),
+        .message_id = htole16(rec->message_id),
+        .tag = htole16(rec->tag),
+        .status = (int32_t)htole32((uint32_t)rec->status),
+        .addr = htole32(rec->addr),
+        .start_us = htole64(rec->start_us),
+        .end_us = htole64(rec->end_us),
+        .out_len = htole32(rec->out_len),
+        .in_len = htole32(rec->in_len),
+    };
+
+    rec->len = le32toh(le.len);
+
+    if (fwrite(&le, sizeof(le), 1, out) != 1)
+        return -1;
+
+    if (rec->out_len && fwrite(data_out, rec->out_len, 1, out) != 1)
+        return -1;
+
+    if (rec->in_len && fwrite(data_in, rec->in_len, 1, out) != 1)
+        return -1;
+
+    return 0;
+}
+
+int trace_read_header(FILE *in, struct trace_header *header)
+{
+    trace_set_binary(in);
+
+    if (fread(header, sizeof(*header), 1, in) != 1)
+        return -1;
+
+    header->version = le16toh(header->version);
+    header->start_us = le64toh(header->start_us);
+
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) ||
+        header->version != TRACE_VERSION)
+        return -1;
+
+    return 0;
+}
+
+int trace_read_record(FILE *in, struct trace_record *rec, uint8_t **payload, size_t *size)
+{
+    size_t n = fread(rec, 1, sizeof(*rec), in);
+    size_t len;
+
+    if (n == 0 && feof(in))
+        return 0;
+
+    if (n != sizeof(*rec))
+        return -1;
+
+    rec->len = le32toh(rec->len);
+    rec->type = le16toh(rec->type);
+    rec->message_id = le16toh(rec->message_id);
+    rec->tag = le16toh(rec->tag);
+    rec->status = (int32_t)le32toh((uint32_t)rec->status);
+    rec->addr = le32toh(rec->addr);
+    rec->start_us = le64toh(rec->start_us);
+    rec->end_us = le64toh(rec->end_us);
+    rec->out_len = le32toh(rec->out_len);
+    rec->in_len = le32toh(rec->in_len);
+
+    len = (size_t)rec->out_len + rec->in_len;
+    if (len > TRACE_MAX_PAYLOAD_LEN || rec->len != sizeof(*rec) - sizeof(rec->len) + len)
+        return -1;
+
+    if (len > *size)
+    {
+        uint8_t *grown = realloc(*payload, len);
+
+        if (!grown)
+            return -1;
+
+        *payload = grown;
+        *size = len;
+    }
+
+    if (len && fread(*payload, len, 1, in) != 1)
+        return -1;
+
+    return 1;
+}
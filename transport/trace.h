@@ -0,0 +1,162 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Binary trace of the calls made to a transport, written with --trace.
+ *
+ * A trace is a struct trace_header followed by a sequence of records, each a struct trace_record
+ * followed by the octets written to the chip and then the octets read from it. All fields are
+ * little endian.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../command.h"
+
+/** Identifies a trace file */
+#define TRACE_MAGIC         "MMTRACE"
+/** Version of the trace format */
+#define TRACE_VERSION       (1)
+
+/** Calls recorded in a trace. The values are part of the trace format. */
+enum trace_record_type
+{
+    /** Command sent and its response received, out is the command and in the response */
+    TRACE_RECORD_COMMAND = 1,
+    /** Command submitted without waiting for its response, out is the command */
+    TRACE_RECORD_SUBMIT = 2,
+    /** Response to a submitted command, timed from its submission, in is the response */
+    TRACE_RECORD_RESPONSE = 3,
+    /** Register read, in is the value */
+    TRACE_RECORD_REG_READ = 4,
+    /** Register write, out is the value */
+    TRACE_RECORD_REG_WRITE = 5,
+    /** Memory read, in is the data */
+    TRACE_RECORD_MEM_READ = 6,
+    /** Memory write, out is the data */
+    TRACE_RECORD_MEM_WRITE = 7,
+    /** Raw read, in is the data */
+    TRACE_RECORD_RAW_READ = 8,
+    /** Raw write, out is the data */
+    TRACE_RECORD_RAW_WRITE = 9,
+    /** Raw simultaneous read and write */
+    TRACE_RECORD_RAW_READ_WRITE = 10,
+    /** Device reset */
+    TRACE_RECORD_RESET_DEVICE = 11,
+};
+
+/** Header at the start of a trace file */
+struct PACKED trace_header
+{
+    /** TRACE_MAGIC, including its null terminator */
+    char magic[8];
+    /** Trace format version (TRACE_VERSION) */
+    uint16_t version;
+    /** Reserved, zero */
+    uint16_t reserved;
+    /** Time the trace started, in us since the Unix epoch */
+    uint64_t start_us;
+};
+
+/** Header of a record in a trace file */
+struct PACKED trace_record
+{
+    /** Number of bytes in the record following this field, including the payload */
+    uint32_t len;
+    /** Call recorded (enum trace_record_type) */
+    uint16_t type;
+    /** Message ID of the command, 0 if the record is not of a command or response */
+    uint16_t message_id;
+    /** Tag of a submitted command and its response, otherwise 0 */
+    uint16_t tag;
+    /** Reserved, zero */
+    uint16_t reserved;
+    /** Result of the call: a negative transport error, otherwise the firmware status if any */
+    int32_t status;
+    /** Address of register and memory accesses, otherwise 0 */
+    uint32_t addr;
+    /** Time the call started, in us since the trace started */
+    uint64_t start_us;
+    /** Time the call returned, in us since the trace started */
+    uint64_t end_us;
+    /** Number of octets written to the chip, which start the payload */
+    uint32_t out_len;
+    /** Number of octets read from the chip, which follow those written */
+    uint32_t in_len;
+    /** Octets written followed by octets read */
+    uint8_t payload[];
+};
+
+/**
+ * @brief Get the name of a record type.
+ *
+ * @param type  Record type (enum trace_record_type)
+ *
+ * @return      The name, or "unknown"
+ */
+const char *trace_record_type_name(uint16_t type);
+
+/**
+ * @brief Prepare a stream for a trace and write the trace header.
+ *
+ * @param out       Stream to write to
+ * @param start_us  Time the trace started, in us since the Unix epoch
+ *
+ * @return          0 on success, -1 if the stream could not be written
+ */
+int trace_write_header(FILE *out, uint64_t start_us);
+
+/**
+ * @brief Write a trace record.
+ *
+ * @param out       Stream to write to
+ * @param rec       Header of the record in host byte order, whose len is filled in
+ * @param data_out  Octets written to the chip, rec->out_len long
+ * @param data_in   Octets read from the chip, rec->in_len long
+ *
+ * @return          0 on success, -1 if the stream could not be written
+ */
+int trace_write_record(FILE *out, struct trace_record *rec, const void *data_out,
+                       const void *data_in);
+
+/**
+ * @brief Prepare a stream for reading a trace and read the trace header.
+ *
+ * @param in            Stream to read from
+ * @param[out] header   The header, converted to host byte order
+ *
+ * @return              0 on success, or -1 if the stream is not a trace of a supported version
+ */
+int trace_read_header(FILE *in, struct trace_header *header);
+
+/**
+ * @brief Read a trace record written by trace_write_record().
+ *
+ * @param in                Stream to read from
+ * @param[out] rec          Header of the record, converted to host byte order
+ * @param[in,out] payload   Buffer for the payload, grown with realloc() as needed
+ * @param[in,out] size      Size of the payload buffer
+ *
+ * @return                  1 if a record was read, 0 at the end of the stream, or -1 if the record
+ *                          is truncated or malformed, or the buffer could not be grown
+ */
+int trace_read_record(FILE *in, struct trace_record *rec, uint8_t **payload, size_t *size);
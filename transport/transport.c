@@ -16,11 +16,13 @@
  * <https://www.gnu.org/licenses/>.
  */
 
+#include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "transport.h"
 #include "transport_private.h"
+#include "trace.h"
 #include "../command.h"
 #include "../utilities.h"
 
@@ -239,24 +241,643 @@ const char *morsectrl_transport_name(struct morsectrl_transport *transport)
     return transport->tops->name;
 }
 
+/** Names of the timed transport operations, indexed by enum morsectrl_transport_op */
+static const char *const transport_op_names[MORSECTRL_TRANSPORT_OP_COUNT] = {
+    [MORSECTRL_TRANSPORT_OP_INIT] = "init",
+    [MORSECTRL_TRANSPORT_OP_DEINIT] = "deinit",
+    [MORSECTRL_TRANSPORT_OP_SEND] = "send",
+    [MORSECTRL_TRANSPORT_OP_SUBMIT] = "submit",
+    [MORSECTRL_TRANSPORT_OP_RECEIVE] = "receive",
+    [MORSECTRL_TRANSPORT_OP_REG_READ] = "reg_read",
+    [MORSECTRL_TRANSPORT_OP_REG_WRITE] = "reg_write",
+    [MORSECTRL_TRANSPORT_OP_MEM_READ] = "mem_read",
+    [MORSECTRL_TRANSPORT_OP_MEM_WRITE] = "mem_write",
+    [MORSECTRL_TRANSPORT_OP_RAW_READ] = "raw_read",
+    [MORSECTRL_TRANSPORT_OP_RAW_WRITE] = "raw_write",
+    [MORSECTRL_TRANSPORT_OP_RAW_READ_WRITE] = "raw_read_write",
+    [MORSECTRL_TRANSPORT_OP_RESET_DEVICE] = "reset_device",
+};
+
+/** Trace record types of the transport operations, 0 for those that are not traced */
+static const uint16_t transport_op_trace_types[MORSECTRL_TRANSPORT_OP_COUNT] = {
+    [MORSECTRL_TRANSPORT_OP_SEND] = TRACE_RECORD_COMMAND,
+    [MORSECTRL_TRANSPORT_OP_SUBMIT] = TRACE_RECORD_SUBMIT,
+    [MORSECTRL_TRANSPORT_OP_REG_READ] = TRACE_RECORD_REG_READ,
+    [MORSECTRL_TRANSPORT_OP_REG_WRITE] = TRACE_RECORD_REG_WRITE,
+    [MORSECTRL_TRANSPORT_OP_MEM_READ] = TRACE_RECORD_MEM_READ,
+    [MORSECTRL_TRANSPORT_OP_MEM_WRITE] = TRACE_RECORD_MEM_WRITE,
+    [MORSECTRL_TRANSPORT_OP_RAW_READ] = TRACE_RECORD_RAW_READ,
+    [MORSECTRL_TRANSPORT_OP_RAW_WRITE] = TRACE_RECORD_RAW_WRITE,
+    [MORSECTRL_TRANSPORT_OP_RAW_READ_WRITE] = TRACE_RECORD_RAW_READ_WRITE,
+    [MORSECTRL_TRANSPORT_OP_RESET_DEVICE] = TRACE_RECORD_RESET_DEVICE,
+};
+
+/** @brief A call made through the transport API, to be timed and traced. */
+struct transport_call
+{
+    /** Operation called */
+    enum morsectrl_transport_op op;
+    /** Time the call started, from transport_call_start() */
+    uint64_t start_us;
+    /** Return code of the call */
+    int ret;
+    /** Message ID of a command, otherwise 0 */
+    uint16_t message_id;
+    /** Tag of a submitted command, otherwise 0 */
+    uint16_t tag;
+    /** Address of a register or memory access, otherwise 0 */
+    uint32_t addr;
+    /** Octets written to the chip */
+    const void *data_out;
+    /** Number of octets written to the chip */
+    size_t out_len;
+    /** Octets read from the chip */
+    const void *data_in;
+    /** Number of octets read from the chip */
+    size_t in_len;
+};
+
+/**
+ * @brief Check whether the calls made to a transport are being timed or traced.
+ *
+ * @param transport The transport instance.
+ * @return          true if calls are timed or traced.
+ */
+static bool transport_calls_recorded(struct morsectrl_transport *transport)
+{
+    return transport->timing.enabled || transport->trace;
+}
+
+/**
+ * @brief Get the time a timed or traced call starts at.
+ *
+ * @param transport The transport instance.
+ * @return          The current time, or 0 if calls are neither timed nor traced.
+ */
+static uint64_t transport_call_start(struct morsectrl_transport *transport)
+{
+    return transport_calls_recorded(transport) ? time_monotonic_us() : 0;
+}
+
+/**
+ * @brief Add a call to a latency histogram.
+ *
+ * @param hist      The histogram.
+ * @param elapsed   Time taken by the call in us.
+ * @param octets    Octets transferred by the call.
+ * @param ret       Return code of the call.
+ */
+static void transport_histogram_add(struct morsectrl_transport_histogram *hist,
+                                    uint64_t elapsed, size_t octets, int ret)
+{
+    size_t bucket = 0;
+
+    while (bucket < MORSECTRL_TRANSPORT_TIMING_BUCKETS - 1 && (elapsed >> (bucket + 1)))
+        bucket++;
+
+    if (!hist->count || elapsed < hist->min_us)
+        hist->min_us = elapsed;
+    hist->max_us = MAX(hist->max_us, elapsed);
+    hist->count++;
+    hist->errors += (ret != ETRANSSUCC);
+    hist->octets += octets;
+    hist->total_us += elapsed;
+    hist->buckets[bucket]++;
+}
+
+/**
+ * @brief Record the time taken to send a command against its message ID.
+ *
+ * Message IDs beyond the first MORSECTRL_TRANSPORT_TIMING_MESSAGES seen are only counted in the
+ * send operation.
+ *
+ * @param transport     The transport instance.
+ * @param message_id    Message ID of the command.
+ * @param elapsed       Time taken to send the command and receive its response.
+ * @param octets        Octets of the command and response.
+ * @param ret           Return code of the send.
+ */
+static void transport_timing_message(struct morsectrl_transport *transport, uint16_t message_id,
+                                     uint64_t elapsed, size_t octets, int ret)
+{
+    struct morsectrl_transport_timing *timing = &transport->timing;
+    size_t i;
+
+    for (i = 0; i < timing->n_messages; i++)
+    {
+        if (timing->message_ids[i] == message_id)
+            break;
+    }
+
+    if (i == timing->n_messages)
+    {
+        if (i == MORSECTRL_TRANSPORT_TIMING_MESSAGES)
+            return;
+
+        timing->message_ids[timing->n_messages++] = message_id;
+    }
+
+    transport_histogram_add(&timing->messages[i], elapsed, octets, ret);
+}
+
+/**
+ * @brief Get the status to trace for a command.
+ *
+ * @param ret       Return code of the transport.
+ * @param resp      The response, including its header.
+ * @param resp_len  Length of the response.
+ * @return          The transport error if there was one, otherwise the firmware status.
+ */
+static int32_t transport_trace_status(int ret, const void *resp, size_t resp_len)
+{
+    const struct response *response = resp;
+
+    if (ret != ETRANSSUCC || !response || resp_len < sizeof(*response))
+        return ret;
+
+    return (int32_t)le32toh(response->status);
+}
+
+/**
+ * @brief Write a record to the trace, stopping the trace if it cannot be written.
+ *
+ * @param transport The transport instance, which must be tracing.
+ * @param rec       The record, with times from time_monotonic_us().
+ * @param data_out  Octets written to the chip.
+ * @param data_in   Octets read from the chip.
+ */
+static void transport_trace_write(struct morsectrl_transport *transport, struct trace_record *rec,
+                                  const void *data_out, const void *data_in)
+{
+    rec->start_us -= MIN(rec->start_us, transport->trace_start_us);
+    rec->end_us -= MIN(rec->end_us, transport->trace_start_us);
+
+    if (trace_write_record(transport->trace, rec, data_out, data_in))
+    {
+        mctrl_err("Failed to write trace, tracing stopped\n");
+        fclose(transport->trace);
+        transport->trace = NULL;
+    }
+}
+
+/**
+ * @brief Time and trace a call started with transport_call_start().
+ *
+ * @param transport The transport instance.
+ * @param call      The call.
+ */
+static void transport_call_end(struct morsectrl_transport *transport,
+                               const struct transport_call *call)
+{
+    uint64_t end_us;
+
+    if (!transport_calls_recorded(transport))
+        return;
+
+    end_us = time_monotonic_us();
+
+    if (transport->timing.enabled)
+    {
+        uint64_t elapsed = end_us - call->start_us;
+        size_t octets = call->out_len + call->in_len;
+
+        transport_histogram_add(&transport->timing.ops[call->op], elapsed, octets, call->ret);
+        if (call->op == MORSECTRL_TRANSPORT_OP_SEND)
+            transport_timing_message(transport, call->message_id, elapsed, octets, call->ret);
+    }
+
+    if (transport->trace && transport_op_trace_types[call->op])
+    {
+        struct trace_record rec = {
+            .type = transport_op_trace_types[call->op],
+            .message_id = call->message_id,
+            .tag = call->tag,
+            .status = call->ret,
+            .addr = call->addr,
+            .start_us = call->start_us,
+            .end_us = end_us,
+            .out_len = call->out_len,
+            .in_len = call->in_len,
+        };
+
+        if (call->op == MORSECTRL_TRANSPORT_OP_SEND)
+            rec.status = transport_trace_status(call->ret, call->data_in, call->in_len);
+
+        transport_trace_write(transport, &rec, call->data_out, call->data_in);
+    }
+}
+
+/**
+ * @brief Remember when a command was submitted, to time and trace it up to its response.
+ *
+ * Commands submitted while MORSECTRL_TRANSPORT_TIMING_INFLIGHT others are waiting are only counted
+ * in the submit operation, and their responses are neither timed nor traced.
+ *
+ * @param transport     The transport instance.
+ * @param message_id    Message ID of the command.
+ * @param octets        Length of the command.
+ * @param tag           Tag the command was submitted with.
+ * @param start_us      Time the command was submitted.
+ */
+static void transport_call_submitted(struct morsectrl_transport *transport,
+                                     uint16_t message_id, size_t octets, uint16_t tag,
+                                     uint64_t start_us)
+{
+    for (size_t i = 0; i < MORSECTRL_TRANSPORT_TIMING_INFLIGHT; i++)
+    {
+        struct morsectrl_transport_timing_inflight *inflight = &transport->timing.inflight[i];
+
+        if (inflight->tag)
+            continue;
+
+        inflight->tag = tag;
+        inflight->message_id = message_id;
+        inflight->octets = octets;
+        inflight->start_us = start_us;
+        break;
+    }
+}
+
+/** Arguments of transport_call_complete() */
+struct transport_call_complete_arg
+{
+    struct morsectrl_transport *transport;
+    morsectrl_transport_complete_fn complete;
+    void *arg;
+};
+
+/**
+ * @brief Time and trace a response to a submitted command, then pass it on to the caller of
+ *        morsectrl_transport_receive().
+ *
+ * Only responses to commands remembered by transport_call_submitted() are timed and traced, so a
+ * transport completing a tag twice does not record a second response.
+ *
+ * See morsectrl_transport_complete_fn.
+ */
+static void transport_call_complete(void *arg, uint16_t tag, int status,
+                                    const uint8_t *data, size_t len)
+{
+    struct transport_call_complete_arg *complete_arg = arg;
+    struct morsectrl_transport *transport = complete_arg->transport;
+    struct morsectrl_transport_timing_inflight *inflight = NULL;
+    uint64_t end_us = time_monotonic_us();
+
+    for (size_t i = 0; i < MORSECTRL_TRANSPORT_TIMING_INFLIGHT; i++)
+    {
+        if (transport->timing.inflight[i].tag == tag)
+        {
+            inflight = &transport->timing.inflight[i];
+            break;
+        }
+    }
+
+    if (inflight && transport->timing.enabled)
+        transport_timing_message(transport, inflight->message_id, end_us - inflight->start_us,
+                                 inflight->octets + (status ? 0 : len), status);
+
+    if (inflight && transport->trace)
+    {
+        struct trace_record rec = {
+            .type = TRACE_RECORD_RESPONSE,
+            .message_id = inflight->message_id,
+            .tag = tag,
+            .status = transport_trace_status(status, data, len),
+            .start_us = inflight->start_us,
+            .end_us = end_us,
+            .in_len = data ? len : 0,
+        };
+
+        transport_trace_write(transport, &rec, NULL, data);
+    }
+
+    if (inflight)
+        inflight->tag = 0;
+
+    complete_arg->complete(complete_arg->arg, tag, status, data, len);
+}
+
+int morsectrl_transport_trace_open(struct morsectrl_transport *transport, const char *path)
+{
+    FILE *trace;
+
+    if (transport->trace)
+        return -ETRANSERR;
+
+    trace = fopen(path, "wb");
+    if (!trace)
+    {
+        mctrl_err("Could not open trace file %s\n", path);
+        return -ETRANSERR;
+    }
+
+    if (trace_write_header(trace, time_realtime_us()))
+    {
+        mctrl_err("Could not write trace file %s\n", path);
+        fclose(trace);
+        return -ETRANSERR;
+    }
+
+    transport->trace = trace;
+    transport->trace_start_us = time_monotonic_us();
+
+    return ETRANSSUCC;
+}
+
+int morsectrl_transport_trace_close(struct morsectrl_transport *transport)
+{
+    int ret = ETRANSSUCC;
+
+    if (!transport || !transport->trace)
+        return ETRANSSUCC;
+
+    if (ferror(transport->trace))
+        ret = -ETRANSERR;
+
+    if (fclose(transport->trace))
+        ret = -ETRANSERR;
+
+    transport->trace = NULL;
+
+    return ret;
+}
+
+void morsectrl_transport_timing_enable(struct morsectrl_transport *transport, uint64_t start_us)
+{
+    memset(&transport->timing, 0, sizeof(transport->timing));
+    transport->timing.enabled = true;
+    transport->timing.start_us = start_us;
+}
+
+/**
+ * @brief Estimate a percentile of a latency histogram.
+ *
+ * @param hist      The histogram.
+ * @param percent   Percentile to estimate.
+ * @return          Upper bound of the bucket the percentile falls in, limited to the slowest call.
+ */
+static uint64_t transport_histogram_percentile(const struct morsectrl_transport_histogram *hist,
+                                               unsigned int percent)
+{
+    uint64_t rank = ((uint64_t)hist->count * percent + 99) / 100;
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < MORSECTRL_TRANSPORT_TIMING_BUCKETS; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= rank)
+            return MIN((uint64_t)2 << i, hist->max_us);
+    }
+
+    return hist->max_us;
+}
+
+/**
+ * @brief Print one row of the timing summary.
+ *
+ * @param out   Stream to print to.
+ * @param name  Name of the operation or message.
+ * @param hist  Calls to the operation or message.
+ * @param json  Print as a JSON object rather than as a table row.
+ */
+static void transport_histogram_print(FILE *out, const char *name,
+                                      const struct morsectrl_transport_histogram *hist, bool json)
+{
+    const char *sep = "";
+
+    if (json)
+    {
+        fprintf(out, "\"name\":\"%s\",\"count\":%u,\"errors\":%u,\"octets\":%" PRIu64 ","
+                "\"total_us\":%" PRIu64 ",\"min_us\":%" PRIu64 ",\"max_us\":%" PRIu64 ","
+                "\"p50_us\":%" PRIu64 ",\"p99_us\":%" PRIu64 ",\"histogram\":[",
+                name, hist->count, hist->errors, hist->octets, hist->total_us,
+                hist->min_us, hist->max_us,
+                transport_histogram_percentile(hist, 50), transport_histogram_percentile(hist, 99));
+
+        for (size_t i = 0; i < MORSECTRL_TRANSPORT_TIMING_BUCKETS; i++)
+        {
+            if (!hist->buckets[i])
+                continue;
+
+            fprintf(out, "%s{\"lt_us\":%" PRIu64 ",\"count\":%u}",
+                    sep, (uint64_t)2 << i, hist->buckets[i]);
+            sep = ",";
+        }
+        fprintf(out, "]");
+        return;
+    }
+
+    fprintf(out, "%-16s %8u %6u %12" PRIu64 " %12" PRIu64 " %10" PRIu64 " %10" PRIu64
+            " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+            name, hist->count, hist->errors, hist->octets, hist->total_us,
+            hist->total_us / hist->count, hist->min_us, hist->max_us,
+            transport_histogram_percentile(hist, 50), transport_histogram_percentile(hist, 99));
+
+    fprintf(out, "%-16s", "");
+    for (size_t i = 0; i < MORSECTRL_TRANSPORT_TIMING_BUCKETS; i++)
+    {
+        if (hist->buckets[i])
+            fprintf(out, " <%" PRIu64 "us:%u", (uint64_t)2 << i, hist->buckets[i]);
+    }
+    fprintf(out, "\n");
+}
+
+void morsectrl_transport_timing_print(struct morsectrl_transport *transport, FILE *out, bool json)
+{
+    const struct morsectrl_transport_timing *timing;
+    uint64_t transport_us = 0;
+    uint64_t total_us;
+    const char *sep = "";
+    char name[32];
+
+    if (!transport || !transport->timing.enabled)
+        return;
+
+    timing = &transport->timing;
+    total_us = time_monotonic_us() - timing->start_us;
+
+    for (size_t op = 0; op < MORSECTRL_TRANSPORT_OP_COUNT; op++)
+        transport_us += timing->ops[op].total_us;
+
+    if (json)
+    {
+        fprintf(out, "{\"total_us\":%" PRIu64 ",\"transport_us\":%" PRIu64 ",\"ops\":[",
+                total_us, transport_us);
+        for (size_t op = 0; op < MORSECTRL_TRANSPORT_OP_COUNT; op++)
+        {
+            if (!timing->ops[op].count)
+                continue;
+
+            fprintf(out, "%s{", sep);
+            transport_histogram_print(out, transport_op_names[op], &timing->ops[op], true);
+            fprintf(out, "}");
+            sep = ",";
+        }
+
+        sep = "";
+        fprintf(out, "],\"messages\":[");
+        for (size_t i = 0; i < timing->n_messages; i++)
+        {
+            snprintf(name, sizeof(name), "0x%04x", timing->message_ids[i]);
+            fprintf(out, "%s{\"message_id\":%u,", sep, timing->message_ids[i]);
+            transport_histogram_print(out, name, &timing->messages[i], true);
+            fprintf(out, "}");
+            sep = ",";
+        }
+        fprintf(out, "]}\n");
+        return;
+    }
+
+    fprintf(out, "Total %" PRIu64 " us, in transport %" PRIu64 " us, outside transport %" PRIu64
+            " us\n", total_us, transport_us, total_us - MIN(transport_us, total_us));
+    fprintf(out, "%-16s %8s %6s %12s %12s %10s %10s %10s %10s %10s\n", "operation", "calls",
+            "errors", "octets", "total_us", "mean_us", "min_us", "max_us", "p50_us", "p99_us");
+
+    for (size_t op = 0; op < MORSECTRL_TRANSPORT_OP_COUNT; op++)
+    {
+        if (timing->ops[op].count)
+            transport_histogram_print(out, transport_op_names[op], &timing->ops[op], false);
+    }
+
+    for (size_t i = 0; i < timing->n_messages; i++)
+    {
+        snprintf(name, sizeof(name), "message 0x%04x", timing->message_ids[i]);
+        transport_histogram_print(out, name, &timing->messages[i], false);
+    }
+}
+
 int morsectrl_transport_init(struct morsectrl_transport *transport)
 {
-    if (transport->tops && transport->tops->init)
-        return transport->tops->init(transport);
+    struct transport_call call = { .op = MORSECTRL_TRANSPORT_OP_INIT };
+
+    if (!transport->tops || !transport->tops->init)
+        return -ETRANSERR;
+
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->init(transport);
+    transport_call_end(transport, &call);
 
-    return -ETRANSERR;
+    return call.ret;
+}
+
+/**
+ * @brief Get the pool size class of a buffer capacity.
+ *
+ * @param capacity  Capacity of the buffer.
+ * @return          The size class, or MORSECTRL_TRANSPORT_POOL_CLASSES if it is too big to pool.
+ */
+static size_t transport_pool_class(size_t capacity)
+{
+    size_t class_size = MORSECTRL_TRANSPORT_POOL_MIN_SIZE;
+    size_t pool_class = 0;
+
+    while (class_size < capacity && pool_class < MORSECTRL_TRANSPORT_POOL_CLASSES)
+    {
+        class_size *= 2;
+        pool_class++;
+    }
+
+    return pool_class;
+}
+
+/**
+ * @brief Free all the buffers kept by the pool of a transport.
+ *
+ * @param transport Transport to drain the pool of.
+ */
+static void transport_pool_drain(struct morsectrl_transport *transport)
+{
+    struct morsectrl_transport_pool *pool = &transport->pool;
+
+    for (size_t ii = 0; ii < MORSECTRL_TRANSPORT_POOL_CLASSES; ii++)
+    {
+        while (pool->n_free[ii])
+        {
+            struct morsectrl_transport_buff *buff = pool->free[ii][--pool->n_free[ii]];
+
+            free(buff->memblock);
+            free(buff);
+        }
+    }
+}
+
+struct morsectrl_transport_buff *morsectrl_transport_buff_alloc(
+    struct morsectrl_transport *transport, size_t capacity)
+{
+    struct morsectrl_transport_pool *pool = &transport->pool;
+    size_t pool_class = transport_pool_class(capacity);
+    struct morsectrl_transport_buff *buff;
+
+    if (pool_class < MORSECTRL_TRANSPORT_POOL_CLASSES && pool->n_free[pool_class])
+        return pool->free[pool_class][--pool->n_free[pool_class]];
+
+    buff = malloc(sizeof(*buff));
+    if (!buff)
+        return NULL;
+
+    /* Round up to the size class so that the buffer can be reused for anything in the class */
+    if (pool_class < MORSECTRL_TRANSPORT_POOL_CLASSES)
+    {
+        buff->capacity = MORSECTRL_TRANSPORT_POOL_MIN_SIZE << pool_class;
+        buff->owner = transport;
+    }
+    else
+    {
+        buff->capacity = capacity;
+        buff->owner = NULL;
+    }
+
+    buff->memblock = malloc(buff->capacity);
+    if (!buff->memblock)
+    {
+        free(buff);
+        return NULL;
+    }
+    buff->data = buff->memblock;
+    buff->data_len = 0;
+
+    return buff;
 }
 
 int morsectrl_transport_deinit(struct morsectrl_transport *transport)
 {
-    int ret = ETRANSSUCC;
+    struct transport_call call = {
+        .op = MORSECTRL_TRANSPORT_OP_DEINIT,
+        .start_us = transport_call_start(transport),
+        .ret = ETRANSSUCC,
+    };
 
     if (transport->tops && transport->tops->deinit)
-        ret = transport->tops->deinit(transport);
+        call.ret = transport->tops->deinit(transport);
+
+    if (transport->tops)
+        transport_call_end(transport, &call);
 
     transport->tops = NULL;
+    transport_pool_drain(transport);
 
-    return ret;
+    return call.ret;
+}
+
+int morsectrl_transport_reinit(struct morsectrl_transport *transport)
+{
+    const struct morsectrl_transport_ops *tops = transport->tops;
+
+    /* Deinit forgets the operations, which init needs */
+    morsectrl_transport_deinit(transport);
+    transport->tops = tops;
+
+    return morsectrl_transport_init(transport);
+}
+
+void morsectrl_transport_free(struct morsectrl_transport *transport)
+{
+    if (!transport)
+        return;
+
+    morsectrl_transport_trace_close(transport);
+    transport_pool_drain(transport);
+    free(transport);
 }
 
 struct morsectrl_transport_buff *morsectrl_transport_cmd_alloc(
@@ -304,12 +925,90 @@ int morsectrl_transport_buff_free(struct morsectrl_transport_buff *buff)
     if (!buff)
         return -ETRANSERR;
 
+    /* Once the transport has been deinitialised its pool is no longer drained */
+    if (buff->owner && buff->owner->tops)
+    {
+        struct morsectrl_transport_pool *pool = &buff->owner->pool;
+        size_t pool_class = transport_pool_class(buff->capacity);
+
+        if (pool->n_free[pool_class] < MORSECTRL_TRANSPORT_POOL_DEPTH)
+        {
+            pool->free[pool_class][pool->n_free[pool_class]++] = buff;
+            return ETRANSSUCC;
+        }
+    }
+
     free(buff->memblock);
     free(buff);
 
     return ETRANSSUCC;
 }
 
+bool morsectrl_transport_has_async(struct morsectrl_transport *transport)
+{
+    return transport->tops && transport->tops->submit && transport->tops->receive;
+}
+
+uint16_t morsectrl_transport_new_tag(struct morsectrl_transport *transport)
+{
+    /* Skip 0, which is used for synchronous commands */
+    if (++transport->next_tag == 0)
+        transport->next_tag = 1;
+
+    return transport->next_tag;
+}
+
+int morsectrl_transport_submit(struct morsectrl_transport *transport,
+                               struct morsectrl_transport_buff *cmd,
+                               uint16_t tag)
+{
+    struct transport_call call = {
+        .op = MORSECTRL_TRANSPORT_OP_SUBMIT,
+        .tag = tag,
+    };
+
+    if (!morsectrl_transport_has_async(transport))
+        return -ETRANSNOTSUP;
+
+    /* Taken beforehand as the transport may add its framing to the buffer in place */
+    call.message_id = le16toh(((struct command *)cmd->data)->hdr.message_id);
+    call.data_out = cmd->data;
+    call.out_len = cmd->data_len;
+
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->submit(transport, cmd, tag);
+    transport_call_end(transport, &call);
+
+    if (transport_calls_recorded(transport) && call.ret == ETRANSSUCC)
+        transport_call_submitted(transport, call.message_id, call.out_len, tag, call.start_us);
+
+    return call.ret;
+}
+
+int morsectrl_transport_receive(struct morsectrl_transport *transport,
+                                morsectrl_transport_complete_fn complete,
+                                void *arg)
+{
+    struct transport_call_complete_arg complete_arg = {
+        .transport = transport,
+        .complete = complete,
+        .arg = arg,
+    };
+    struct transport_call call = { .op = MORSECTRL_TRANSPORT_OP_RECEIVE };
+
+    if (!morsectrl_transport_has_async(transport))
+        return -ETRANSNOTSUP;
+
+    if (!transport_calls_recorded(transport))
+        return transport->tops->receive(transport, complete, arg);
+
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->receive(transport, transport_call_complete, &complete_arg);
+    transport_call_end(transport, &call);
+
+    return call.ret;
+}
+
 void morsectrl_transport_set_cmd_data_length(struct morsectrl_transport_buff *tbuff,
                                              uint16_t length)
 {
@@ -319,58 +1018,124 @@ void morsectrl_transport_set_cmd_data_length(struct morsectrl_transport_buff *tb
 int morsectrl_transport_reg_read(struct morsectrl_transport *transport,
                                  uint32_t addr, uint32_t *value)
 {
+    struct transport_call call = {
+        .op = MORSECTRL_TRANSPORT_OP_REG_READ,
+        .addr = addr,
+    };
+    uint32_t value_le;
+
     if (!transport->tops || !transport->tops->reg_read)
         return -ETRANSERR;
 
-    return transport->tops->reg_read(transport, addr, value);
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->reg_read(transport, addr, value);
+    if (call.ret == ETRANSSUCC)
+    {
+        value_le = htole32(*value);
+        call.data_in = &value_le;
+        call.in_len = sizeof(value_le);
+    }
+
+    transport_call_end(transport, &call);
+
+    return call.ret;
 }
 
 int morsectrl_transport_reg_write(struct morsectrl_transport *transport,
                                   uint32_t addr, uint32_t value)
 {
+    uint32_t value_le = htole32(value);
+    struct transport_call call = {
+        .op = MORSECTRL_TRANSPORT_OP_REG_WRITE,
+        .addr = addr,
+        .data_out = &value_le,
+        .out_len = sizeof(value_le),
+    };
+
     if (!transport->tops)
         return -ETRANSERR;
 
     if (!transport->tops->reg_write)
         return -ETRANSNOTSUP;
 
-    return transport->tops->reg_write(transport, addr, value);
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->reg_write(transport, addr, value);
+    transport_call_end(transport, &call);
+
+    return call.ret;
 }
 
 int morsectrl_transport_mem_read(struct morsectrl_transport *transport,
                                  struct morsectrl_transport_buff *read,
                                  uint32_t addr)
 {
+    struct transport_call call = {
+        .op = MORSECTRL_TRANSPORT_OP_MEM_READ,
+        .addr = addr,
+        .data_in = read->data,
+        .in_len = read->data_len,
+    };
+
     if (!transport->tops)
         return -ETRANSERR;
 
     if (!transport->tops->mem_read)
         return -ETRANSNOTSUP;
 
-    return transport->tops->mem_read(transport, read, addr);
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->mem_read(transport, read, addr);
+    transport_call_end(transport, &call);
+
+    return call.ret;
 }
 
 int morsectrl_transport_mem_write(struct morsectrl_transport *transport,
                                   struct morsectrl_transport_buff *write,
                                   uint32_t addr)
 {
+    struct transport_call call = {
+        .op = MORSECTRL_TRANSPORT_OP_MEM_WRITE,
+        .addr = addr,
+        .data_out = write->data,
+        .out_len = write->data_len,
+    };
+
     if (!transport->tops)
         return -ETRANSERR;
 
     if (!transport->tops->mem_write)
         return -ETRANSNOTSUP;
 
-    return transport->tops->mem_write(transport, write, addr);
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->mem_write(transport, write, addr);
+    transport_call_end(transport, &call);
+
+    return call.ret;
 }
 
 int morsectrl_transport_send(struct morsectrl_transport *transport,
                              struct morsectrl_transport_buff *cmd,
                              struct morsectrl_transport_buff *resp)
 {
+    struct transport_call call = { .op = MORSECTRL_TRANSPORT_OP_SEND };
+
     if (!transport->tops)
         return -ETRANSERR;
 
-    return transport->tops->send(transport, cmd, resp);
+    /* The transport may add its framing to the buffers in place, so take these beforehand */
+    call.message_id = le16toh(((struct command *)cmd->data)->hdr.message_id);
+    call.data_out = cmd->data;
+    call.out_len = cmd->data_len;
+    call.data_in = resp->data;
+
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->send(transport, cmd, resp);
+    if (call.ret == ETRANSSUCC)
+        call.in_len = resp->data_len;
+
+    transport_call_end(transport, &call);
+
+    return call.ret;
 }
 
 int morsectrl_transport_raw_read(struct morsectrl_transport *transport,
@@ -378,10 +1143,20 @@ int morsectrl_transport_raw_read(struct morsectrl_transport *transport,
                                  bool start,
                                  bool finish)
 {
+    struct transport_call call = {
+        .op = MORSECTRL_TRANSPORT_OP_RAW_READ,
+        .data_in = read->data,
+        .in_len = read->data_len,
+    };
+
     if (!transport->tops)
         return -ETRANSERR;
 
-    return transport->tops->raw_read(transport, read, start, finish);
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->raw_read(transport, read, start, finish);
+    transport_call_end(transport, &call);
+
+    return call.ret;
 }
 
 int morsectrl_transport_raw_write(struct morsectrl_transport *transport,
@@ -389,10 +1164,20 @@ int morsectrl_transport_raw_write(struct morsectrl_transport *transport,
                                   bool start,
                                   bool finish)
 {
+    struct transport_call call = {
+        .op = MORSECTRL_TRANSPORT_OP_RAW_WRITE,
+        .data_out = write->data,
+        .out_len = write->data_len,
+    };
+
     if (!transport->tops)
         return -ETRANSERR;
 
-    return transport->tops->raw_write(transport, write, start, finish);
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->raw_write(transport, write, start, finish);
+    transport_call_end(transport, &call);
+
+    return call.ret;
 }
 
 int morsectrl_transport_raw_read_write(struct morsectrl_transport *transport,
@@ -401,22 +1186,39 @@ int morsectrl_transport_raw_read_write(struct morsectrl_transport *transport,
                                        bool start,
                                        bool finish)
 {
+    struct transport_call call = {
+        .op = MORSECTRL_TRANSPORT_OP_RAW_READ_WRITE,
+        .data_out = write ? write->data : NULL,
+        .out_len = write ? write->data_len : 0,
+        .data_in = read ? read->data : NULL,
+        .in_len = read ? read->data_len : 0,
+    };
+
     if (!transport->tops)
         return -ETRANSERR;
 
-    return transport->tops->raw_read_write(transport, read, write, start, finish);
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->raw_read_write(transport, read, write, start, finish);
+    transport_call_end(transport, &call);
+
+    return call.ret;
 } /* NOLINT */
 
 int morsectrl_transport_reset_device(struct morsectrl_transport *transport)
 {
+    struct transport_call call = { .op = MORSECTRL_TRANSPORT_OP_RESET_DEVICE };
+
     if (!transport->tops)
         return -ETRANSERR;
 
     if (!transport->tops->reset_device)
         return -ETRANSNOTSUP;
 
+    call.start_us = transport_call_start(transport);
+    call.ret = transport->tops->reset_device(transport);
+    transport_call_end(transport, &call);
 
-    return transport->tops->reset_device(transport);
+    return call.ret;
 }
 
 const char *morsectrl_transport_get_ifname(struct morsectrl_transport *transport)
@@ -22,6 +22,7 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 
 enum moresctrl_transport_errnum
@@ -58,8 +59,22 @@ struct morsectrl_transport_buff
     uint8_t *data;
     /** Current size of the data (can be data or data and framing). */
     size_t data_len;
+    /** Transport whose buffer pool this is returned to when freed, NULL if not pooled. */
+    struct morsectrl_transport *owner;
 };
 
+/**
+ * @brief Called for each response received to a command sent with morsectrl_transport_submit().
+ *
+ * @param arg       Opaque argument given to morsectrl_transport_receive().
+ * @param tag       Tag the command was submitted with.
+ * @param status    0 if a response was received, otherwise a negative error code.
+ * @param data      The response, including the morse response header. NULL on error.
+ * @param len       Length of the response.
+ */
+typedef void (*morsectrl_transport_complete_fn)(void *arg, uint16_t tag, int status,
+                                                const uint8_t *data, size_t len);
+
 /**
  * Gets a regular expression string representing the supported transports.
  *
@@ -126,6 +141,24 @@ int morsectrl_transport_init(struct morsectrl_transport *transport);
  */
 int morsectrl_transport_deinit(struct morsectrl_transport *transport);
 
+/**
+ * @brief Deinitialises and initialises an initialised transport again, e.g. after the chip has
+ *        been reset.
+ *
+ * @param transport Transport to reinit.
+ * @return          0 on success or relevant error.
+ */
+int morsectrl_transport_reinit(struct morsectrl_transport *transport);
+
+/**
+ * @brief Frees a transport returned by morsectrl_transport_parse(), along with its pooled buffers.
+ *
+ * The transport must not be initialised, so deinit it first if it was.
+ *
+ * @param transport Transport to free, may be NULL.
+ */
+void morsectrl_transport_free(struct morsectrl_transport *transport);
+
 /**
  * @brief Allocates memory for a command to send using the provided transport.
  *
@@ -169,7 +202,9 @@ struct morsectrl_transport_buff *morsectrl_transport_raw_read_alloc(
 /**
  * @brief Frees memory for a @ref morsectrl_transport_buff.
  *
- * @param transport Transport to free memory for.
+ * Buffers allocated by a transport are kept in its pool for reuse rather than freed.
+ *
+ * @param buff      Buffer to free.
  * @return          0 on success or relevant error.
  */
 int morsectrl_transport_buff_free(struct morsectrl_transport_buff *buff);
@@ -200,6 +235,55 @@ int morsectrl_transport_send(struct morsectrl_transport *transport,
                              struct morsectrl_transport_buff *cmd,
                              struct morsectrl_transport_buff *resp);
 
+/**
+ * @brief Checks whether the transport can have more than one command in flight.
+ *
+ * @param transport The transport instance.
+ *
+ * @return @c true if morsectrl_transport_submit() is supported else @c false.
+ */
+bool morsectrl_transport_has_async(struct morsectrl_transport *transport);
+
+/**
+ * @brief Get a new tag to identify a command submitted with morsectrl_transport_submit().
+ *
+ * Tags are never 0, which is left for commands sent with morsectrl_transport_send().
+ *
+ * @param transport The transport instance.
+ *
+ * @return The tag.
+ */
+uint16_t morsectrl_transport_new_tag(struct morsectrl_transport *transport);
+
+/**
+ * @brief Send a command without waiting for its response.
+ *
+ * The response is delivered by a later call to morsectrl_transport_receive().
+ *
+ * @param transport Transport to send the command on.
+ * @param cmd       Buffer containing command to send. May be freed once this returns.
+ * @param tag       Tag identifying the command, from morsectrl_transport_new_tag().
+ * @return          0 on success or relevant error.
+ */
+int morsectrl_transport_submit(struct morsectrl_transport *transport,
+                               struct morsectrl_transport_buff *cmd,
+                               uint16_t tag);
+
+/**
+ * @brief Wait for responses to commands sent with morsectrl_transport_submit().
+ *
+ * Blocks until at least one response (or error for a command) has been received, calling
+ * @p complete for each one.
+ *
+ * @param transport Transport to receive on.
+ * @param complete  Function called for each response.
+ * @param arg       Opaque argument passed to @p complete.
+ * @return          0 on success or relevant error.
+ */
+int morsectrl_transport_receive(struct morsectrl_transport *transport,
+                                morsectrl_transport_complete_fn complete,
+                                void *arg);
+
 /**
  * @brief Reads raw data from the transport.
  *
@@ -291,6 +375,53 @@ bool morsectrl_transport_has_reset(struct morsectrl_transport *transport);
  */
 bool morsectrl_transport_has_driver(struct morsectrl_transport *transport);
 
+/**
+ * @brief Start timing the calls made to a transport.
+ *
+ * The latency and size of every call made through this API is then recorded, for each operation
+ * and for each message ID of sent commands, until the summary is printed with
+ * morsectrl_transport_timing_print().
+ *
+ * @param transport The transport instance.
+ * @param start_us  Time the run started, from time_monotonic_us(), which the total run time and
+ *                  the time spent outside the transport are measured from.
+ */
+void morsectrl_transport_timing_enable(struct morsectrl_transport *transport, uint64_t start_us);
+
+/**
+ * @brief Print a summary of the calls made to a transport since timing was enabled.
+ *
+ * Does nothing if timing is not enabled.
+ *
+ * @param transport The transport instance.
+ * @param out       Stream to print to.
+ * @param json      Print as JSON rather than as a table.
+ */
+void morsectrl_transport_timing_print(struct morsectrl_transport *transport, FILE *out, bool json);
+
+/**
+ * @brief Start tracing the calls made to a transport to a file.
+ *
+ * Every command sent and response received, and every register, memory and raw access, is recorded
+ * with its payload and start and end times in the binary format described in trace.h, until
+ * morsectrl_transport_trace_close() is called.
+ *
+ * @param transport The transport instance.
+ * @param path      Path of the trace file to create.
+ * @return          0 on success or relevant error.
+ */
+int morsectrl_transport_trace_open(struct morsectrl_transport *transport, const char *path);
+
+/**
+ * @brief Stop tracing the calls made to a transport and close the trace file.
+ *
+ * Does nothing if the transport is not being traced.
+ *
+ * @param transport The transport instance.
+ * @return          0 on success, or -ETRANSERR if the trace could not be written in full.
+ */
+int morsectrl_transport_trace_close(struct morsectrl_transport *transport);
+
 /**
  * Print an error message.
  *
@@ -91,10 +91,131 @@ struct morsectrl_transport_ops
                           struct morsectrl_transport_buff *write,
                           bool start,
                           bool finish);
+    /**
+     * Queue raw transfers until raw_flush() instead of performing them (optional; may be NULL).
+     * Data read by queued transfers is only valid once they have been flushed.
+     */
+    int (*raw_queue)(struct morsectrl_transport *transport);
+    /** Perform all queued raw transfers and stop queueing (required if raw_queue is provided). */
+    int (*raw_flush)(struct morsectrl_transport *transport);
     /** Reset the device. */
     int (*reset_device)(struct morsectrl_transport *transport);
     /** Retrieve the interface name, if supported (optional; may be NULL if not supported). */
     const char *(*get_ifname)(struct morsectrl_transport *transport);
+    /**
+     * Send a command without waiting for the response (optional; may be NULL if the transport
+     * can only have one command in flight). The tag must be returned with the response.
+     */
+    int (*submit)(struct morsectrl_transport *transport,
+                  struct morsectrl_transport_buff *cmd,
+                  uint16_t tag);
+    /**
+     * Wait for at least one response to a submitted command and pass each response received to
+     * the completion function (required if submit is provided).
+     */
+    int (*receive)(struct morsectrl_transport *transport,
+                   morsectrl_transport_complete_fn complete,
+                   void *arg);
+};
+
+/** Number of buffer size classes kept by the pool of a transport */
+#define MORSECTRL_TRANSPORT_POOL_CLASSES    (16)
+/** Capacity of the smallest size class, each class being double the capacity of the previous */
+#define MORSECTRL_TRANSPORT_POOL_MIN_SIZE   (64UL)
+/** Number of free buffers kept in each size class */
+#define MORSECTRL_TRANSPORT_POOL_DEPTH      (4)
+
+/**
+ * @brief Free buffers kept by a transport for reuse, so that repeated transfers of similar sizes
+ *        do not allocate.
+ */
+struct morsectrl_transport_pool
+{
+    /** Free buffers of each size class */
+    struct morsectrl_transport_buff *free[MORSECTRL_TRANSPORT_POOL_CLASSES]
+                                         [MORSECTRL_TRANSPORT_POOL_DEPTH];
+    /** Number of free buffers of each size class */
+    uint8_t n_free[MORSECTRL_TRANSPORT_POOL_CLASSES];
+};
+
+/** Transport operations that are timed when timing is enabled */
+enum morsectrl_transport_op
+{
+    MORSECTRL_TRANSPORT_OP_INIT,
+    MORSECTRL_TRANSPORT_OP_DEINIT,
+    MORSECTRL_TRANSPORT_OP_SEND,
+    MORSECTRL_TRANSPORT_OP_SUBMIT,
+    MORSECTRL_TRANSPORT_OP_RECEIVE,
+    MORSECTRL_TRANSPORT_OP_REG_READ,
+    MORSECTRL_TRANSPORT_OP_REG_WRITE,
+    MORSECTRL_TRANSPORT_OP_MEM_READ,
+    MORSECTRL_TRANSPORT_OP_MEM_WRITE,
+    MORSECTRL_TRANSPORT_OP_RAW_READ,
+    MORSECTRL_TRANSPORT_OP_RAW_WRITE,
+    MORSECTRL_TRANSPORT_OP_RAW_READ_WRITE,
+    MORSECTRL_TRANSPORT_OP_RESET_DEVICE,
+    MORSECTRL_TRANSPORT_OP_COUNT,
+};
+
+/**
+ * Number of latency histogram buckets. Bucket 0 counts calls taking less than 2us, and each
+ * following bucket covers twice the range of the previous one.
+ */
+#define MORSECTRL_TRANSPORT_TIMING_BUCKETS  (32)
+/** Number of distinct message IDs that sent commands are timed separately for */
+#define MORSECTRL_TRANSPORT_TIMING_MESSAGES (32)
+/** Number of submitted commands whose response is timed at once */
+#define MORSECTRL_TRANSPORT_TIMING_INFLIGHT (16)
+
+/** @brief Latency and size of the calls to one transport operation. */
+struct morsectrl_transport_histogram
+{
+    /** Number of calls */
+    uint32_t count;
+    /** Number of calls that failed */
+    uint32_t errors;
+    /** Octets transferred by the calls */
+    uint64_t octets;
+    /** Time taken by all the calls */
+    uint64_t total_us;
+    /** Time taken by the quickest call */
+    uint64_t min_us;
+    /** Time taken by the slowest call */
+    uint64_t max_us;
+    /** Number of calls falling in each latency bucket */
+    uint32_t buckets[MORSECTRL_TRANSPORT_TIMING_BUCKETS];
+};
+
+/** @brief A submitted command waiting for its response to be timed or traced. */
+struct morsectrl_transport_timing_inflight
+{
+    /** Tag the command was submitted with, 0 if the entry is free */
+    uint16_t tag;
+    /** Message ID of the command */
+    uint16_t message_id;
+    /** Length of the command */
+    size_t octets;
+    /** Time the command was submitted */
+    uint64_t start_us;
+};
+
+/** @brief Timing of the calls made to a transport, see morsectrl_transport_timing_enable(). */
+struct morsectrl_transport_timing
+{
+    /** Whether calls are being timed */
+    bool enabled;
+    /** Time to measure the total run time from */
+    uint64_t start_us;
+    /** Calls to each operation */
+    struct morsectrl_transport_histogram ops[MORSECTRL_TRANSPORT_OP_COUNT];
+    /** Message IDs of sent commands, in the order they were first seen */
+    uint16_t message_ids[MORSECTRL_TRANSPORT_TIMING_MESSAGES];
+    /** Sent commands of each message ID */
+    struct morsectrl_transport_histogram messages[MORSECTRL_TRANSPORT_TIMING_MESSAGES];
+    /** Number of message IDs seen */
+    size_t n_messages;
+    /** Submitted commands, timed and traced from submission to response */
+    struct morsectrl_transport_timing_inflight inflight[MORSECTRL_TRANSPORT_TIMING_INFLIGHT];
 };
 
 /**
@@ -108,8 +229,34 @@ struct morsectrl_transport
     const struct morsectrl_transport_ops *tops;
     /** Flag indicating whether debug messages are enabled. */
     bool debug;
+    /** Tag to give the next submitted command. */
+    uint16_t next_tag;
+    /** Buffers freed by morsectrl_transport_buff_free() for reuse. */
+    struct morsectrl_transport_pool pool;
+    /**
+     * Timing of the calls made to the transport. Not reset by morsectrl_transport_deinit(), so
+     * calls made after the transport is initialised again add to the same totals.
+     */
+    struct morsectrl_transport_timing timing;
+    /** Stream the calls made to the transport are traced to, NULL if not tracing. */
+    FILE *trace;
+    /** Time the trace started, from time_monotonic_us(). */
+    uint64_t trace_start_us;
 };
 
+/**
+ * @brief Allocate a buffer from the pool of a transport, for use by the transport's allocators.
+ *
+ * The buffer is returned to the pool when freed with morsectrl_transport_buff_free(). The data
+ * pointer and length are left for the caller to set.
+ *
+ * @param transport Transport to allocate the buffer for.
+ * @param capacity  Minimum capacity of the buffer.
+ * @return          the allocated @ref morsectrl_transport_buff or NULL on failure.
+ */
+struct morsectrl_transport_buff *morsectrl_transport_buff_alloc(
+    struct morsectrl_transport *transport, size_t capacity);
+
 
 #define REGISTER_TRANSPORT(_ops) \
     const struct morsectrl_transport_ops * const \
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -34,12 +35,26 @@ struct uart_config
     char dev_name[UART_MAX_DEVICE_NAME_LEN];
 
     int baudrate;
+
+    /** Use RTS/CTS hardware flow control */
+    bool rtscts;
 };
 
 struct uart_ctx *uart_init(const struct uart_config *cfg);
 
 int uart_deinit(struct uart_ctx *ctx);
 
-int uart_read(struct uart_ctx *ctx, uint8_t *buf, size_t len);
+/**
+ * @brief Read whatever has been received, waiting for data to arrive if there is none.
+ *
+ * @param ctx           UART context.
+ * @param buf           Buffer to read into.
+ * @param len           Size of @p buf.
+ * @param timeout_ms    Maximum time to wait for data, in milliseconds.
+ *
+ * @return the number of octets read, 0 if none arrived before the timeout, otherwise a negative
+ *         error code.
+ */
+int uart_read(struct uart_ctx *ctx, uint8_t *buf, size_t len, int timeout_ms);
 
 int uart_write(struct uart_ctx *ctx, const uint8_t *buf, size_t len);
@@ -20,12 +20,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "uart.h"
+#include "uart_linux.h"
 #include "../utilities.h"
 
 struct uart_ctx
@@ -39,6 +42,7 @@ struct uart_ctx *uart_init(const struct uart_config *config)
     struct termios tty = {};
     struct uart_ctx *ctx = calloc(1, sizeof(*ctx));
     speed_t uart_baud;
+    bool custom_baud = false;
     MCTRL_ASSERT(ctx != NULL, "Memory allocation failure");
 
     switch (config->baudrate)
@@ -98,9 +102,17 @@ struct uart_ctx *uart_init(const struct uart_config *config)
             uart_baud = B4000000;
             break;
         default:
-            mctrl_err("Invalid baudrate %d\n", config->baudrate);
-            free(ctx);
-            return NULL;
+            if (config->baudrate <= 0)
+            {
+                mctrl_err("Invalid baudrate %d\n", config->baudrate);
+                free(ctx);
+                return NULL;
+            }
+
+            /* Any other rate is set through termios2 once the rest is configured */
+            uart_baud = B38400;
+            custom_baud = true;
+            break;
         }
 
     ret = open(config->dev_name, O_RDWR | O_NOCTTY | O_NDELAY);
@@ -114,8 +126,13 @@ struct uart_ctx *uart_init(const struct uart_config *config)
     ctx->fd = ret;
     fcntl(ctx->fd, F_SETFL, 0);
 
-    /* Configure as 8N1, no flow control or modem status lines */
+    /* Configure as 8N1, ignoring the modem status lines, with optional RTS/CTS flow control */
     tty.c_cflag = CS8 | CLOCAL;
+    if (config->rtscts)
+        tty.c_cflag |= CRTSCTS;
+    /* Reads return whatever is available, waiting for data is done with poll() */
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
     cfsetospeed(&tty, uart_baud);
     cfsetispeed(&tty, uart_baud);
 
@@ -134,6 +151,18 @@ struct uart_ctx *uart_init(const struct uart_config *config)
         free(ctx);
         return NULL;
     }
+
+    if (custom_baud)
+    {
+        ret = uart_linux_set_custom_baudrate(ctx->fd, config->baudrate);
+        if (ret)
+        {
+            mctrl_err("Failed to set baudrate %d on UART device\n", config->baudrate);
+            close(ctx->fd);
+            free(ctx);
+            return NULL;
+        }
+    }
     return ctx;
 }
 
@@ -151,14 +180,40 @@ int uart_deinit(struct uart_ctx *ctx)
     return ret;
 }
 
-int uart_read(struct uart_ctx *ctx, uint8_t *buf, size_t len)
+int uart_read(struct uart_ctx *ctx, uint8_t *buf, size_t len, int timeout_ms)
 {
+    struct pollfd pfd = {
+        .fd = ctx->fd,
+        .events = POLLIN,
+    };
+    int ret;
+
     if (ctx->fd <= 0)
     {
         return -ETRANSERR;
     }
 
-    return read(ctx->fd, buf, len);
+    do
+    {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0)
+    {
+        return -ETRANSERR;
+    }
+    else if (ret == 0)
+    {
+        return 0;
+    }
+
+    ret = read(ctx->fd, buf, len);
+    if (ret < 0)
+    {
+        return (errno == EINTR || errno == EAGAIN) ? 0 : -ETRANSERR;
+    }
+
+    return ret;
 }
 
 int uart_write(struct uart_ctx *ctx, const uint8_t *buf, size_t len)
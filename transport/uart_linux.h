@@ -0,0 +1,35 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Linux specific UART helpers.
+ */
+
+#pragma once
+
+/**
+ * @brief Set a baud rate that has no Bxxxx constant, using the termios2 interface.
+ *
+ * The rest of the terminal configuration is left unchanged.
+ *
+ * @param fd        File descriptor of the UART.
+ * @param baudrate  Baud rate to set.
+ *
+ * @return 0 on success, otherwise -1 with errno set.
+ */
+int uart_linux_set_custom_baudrate(int fd, int baudrate);
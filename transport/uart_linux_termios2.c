@@ -0,0 +1,46 @@
+/*
+ * Copyright 2024 Morse Micro
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The termios2 interface needs the kernel's terminal definitions, which clash with those in the
+ * C library's termios.h, so it is kept apart from the rest of the Linux UART implementation.
+ */
+
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+#include "uart_linux.h"
+
+int uart_linux_set_custom_baudrate(int fd, int baudrate)
+{
+    struct termios2 tty;
+    int ret;
+
+    ret = ioctl(fd, TCGETS2, &tty);
+    if (ret)
+        return ret;
+
+    tty.c_cflag &= ~CBAUD;
+    tty.c_cflag |= BOTHER;
+    tty.c_ospeed = baudrate;
+    tty.c_cflag &= ~(CBAUD << IBSHIFT);
+    tty.c_cflag |= BOTHER << IBSHIFT;
+    tty.c_ispeed = baudrate;
+
+    return ioctl(fd, TCSETS2, &tty);
+}
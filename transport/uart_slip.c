@@ -26,7 +26,8 @@
  *          +-----------------------------------------+-----------+-----------+
  *
  * * Seq # is used to match command to response. The content is arbitrary and the response will
- *   echoed the value provided in the command.
+ *   echoed the value provided in the command. Commands sent with morsectrl_transport_submit()
+ *   carry their tag in the first two bytes so that several may be in flight at once.
  * * The command and response payload are opaque to this layer.
  * * CRC16 is a CRC16 calculated over the sequence # and payload. See below for implementation
  *   details.
@@ -35,6 +36,7 @@
  * side it is SLIP decoded before the CRC16 is validated and sequence # checked.
  */
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,16 +44,29 @@
 
 #include "transport.h"
 #include "transport_private.h"
+#include "../crc.h"
 #include "../utilities.h"
 
 #include "slip.h"
 #include "uart.h"
 
 #define DEFAULT_BAUDRATE            (115200)
+/** Default time to wait for the response to a command */
+#define DEFAULT_RESP_TIMEOUT_MS     (3000)
+
+#define UART_SLIP_STR_BAUDRATE          "baudrate"
+#define UART_SLIP_STR_RTSCTS            "rtscts"
+#define UART_SLIP_STR_RESP_TIMEOUT_MS   "resp_timeout_ms"
+#define UART_SLIP_STR_HELP              "help"
 
 #define SEQNUM_LEN                  (4)
 #define CRC_LEN                     (2)
 
+/** Size of the buffer responses to submitted commands are received into */
+#define UART_SLIP_ASYNC_RX_BUFFER_SIZE  (8192)
+/** Maximum number of octets taken from the UART with each read */
+#define UART_SLIP_RX_CHUNK_SIZE         (4096)
+
 static const struct morsectrl_transport_ops uart_slip_ops;
 
 /** @brief Data structure used to represent an instance of this trasport. */
@@ -60,6 +75,20 @@ struct morsectrl_uart_slip_transport
     struct morsectrl_transport common;
     struct uart_config uart_config;
     struct uart_ctx *uart_ctx;
+    /** Time to wait for each response */
+    uint32_t resp_timeout_ms;
+    /** Octets read from the UART that have not yet been SLIP decoded */
+    uint8_t rx_chunk[UART_SLIP_RX_CHUNK_SIZE];
+    /** Position of the next octet to decode in @c rx_chunk */
+    size_t rx_chunk_pos;
+    /** Number of octets in @c rx_chunk */
+    size_t rx_chunk_len;
+    /** Buffer for responses to submitted commands, allocated on first use */
+    uint8_t *rx_buf;
+    /** Buffer frames are SLIP encoded into before transmission, grown as needed */
+    uint8_t *tx_buf;
+    /** Size of @c tx_buf */
+    size_t tx_buf_size;
 };
 
 /**
@@ -106,13 +135,44 @@ static void uart_slip_error(int error_code, char *error_msg)
     morsectrl_transport_err("UART_SLIP", error_code, error_msg);
 }
 
+/**
+ * @brief Checks whether a configuration option has the given key and, if so, parses its value.
+ *
+ * @param key   Key of the option.
+ * @param value Value of the option.
+ * @param name  Key to match.
+ * @param val   Set to the parsed value if the key matches and the value is valid.
+ * @param min   Minimum valid value.
+ * @param max   Maximum valid value.
+ * @return      true if the key matched and the value was valid, otherwise false.
+ */
+static bool uart_slip_get_uint32(const char *key, const char *value, const char *name,
+                                 uint32_t *val, uint32_t min, uint32_t max)
+{
+    return !strcmp(key, name) && !str_to_uint32_range(value, val, min, max);
+}
+
+static void uart_slip_print_config_usage(void)
+{
+    mctrl_print("<config string> is the path to the UART device, optionally followed by a "
+                "comma-separated list of <keyword>=<value>, where <keyword> is one of the "
+                "following\n");
+    mctrl_print("\t%s - Baud rate, which need not be a standard rate on Linux (default %d)\n",
+                UART_SLIP_STR_BAUDRATE, DEFAULT_BAUDRATE);
+    mctrl_print("\t%s - RTS/CTS hardware flow control (default 0)\n", UART_SLIP_STR_RTSCTS);
+    mctrl_print("\t%s - Command response timeout (default %d)\n", UART_SLIP_STR_RESP_TIMEOUT_MS,
+                DEFAULT_RESP_TIMEOUT_MS);
+    mctrl_print("\t%s - Prints this message\n", UART_SLIP_STR_HELP);
+}
+
 /**
  * @brief Parse the configuration for the SLIP over UART interface.
  *
  * @param transport     The transport structure.
  * @param debug         Indicates whether debug print statements are enabled.
  * @param iface_opts    String containing the interface to use. May be NULL.
- * @param cfg_opts      Comma separated string with SLIP over UART configuration options.
+ * @param cfg_opts      Path to the UART device, followed by comma separated SLIP over UART
+ *                      configuration options.
  * @return              0 on success otherwise relevant error.
  */
 static int uart_slip_parse(struct morsectrl_transport **transport,
@@ -121,6 +181,11 @@ static int uart_slip_parse(struct morsectrl_transport **transport,
                            const char *cfg_opts)
 {
     struct uart_config *config;
+    size_t dev_name_len;
+    const char *opt;
+    uint32_t baudrate = DEFAULT_BAUDRATE;
+    uint32_t rtscts = 0;
+    int config_error = 0;
 
     struct morsectrl_uart_slip_transport *uart_slip_transport =
         calloc(1, sizeof(*uart_slip_transport));
@@ -141,8 +206,70 @@ static int uart_slip_parse(struct morsectrl_transport **transport,
         return -ETRANSNOMEM;
     }
 
-    strncpy(config->dev_name, cfg_opts, sizeof(config->dev_name) - 1);
-    config->baudrate = DEFAULT_BAUDRATE;
+    if (!strcmp(cfg_opts, UART_SLIP_STR_HELP))
+    {
+        uart_slip_print_config_usage();
+        exit(ETRANSSUCC);
+    }
+
+    dev_name_len = strcspn(cfg_opts, ",");
+    snprintf(config->dev_name, sizeof(config->dev_name), "%.*s", (int)dev_name_len, cfg_opts);
+    uart_slip_transport->resp_timeout_ms = DEFAULT_RESP_TIMEOUT_MS;
+
+    for (opt = cfg_opts + dev_name_len; *opt != '\0'; opt += strcspn(opt, ","))
+    {
+        char key[32];
+        char value[16];
+        size_t key_len;
+        size_t len;
+
+        opt++;
+        len = strcspn(opt, ",");
+        key_len = strcspn(opt, "=");
+
+        if (len == strlen(UART_SLIP_STR_HELP) && !strncmp(opt, UART_SLIP_STR_HELP, len))
+        {
+            uart_slip_print_config_usage();
+            exit(ETRANSSUCC);
+        }
+
+        if (key_len >= len || key_len >= sizeof(key) || (len - key_len - 1) >= sizeof(value))
+        {
+            config_error++;
+            continue;
+        }
+
+        snprintf(key, sizeof(key), "%.*s", (int)key_len, opt);
+        snprintf(value, sizeof(value), "%.*s", (int)(len - key_len - 1), opt + key_len + 1);
+
+        if (uart_slip_get_uint32(key, value, UART_SLIP_STR_BAUDRATE, &baudrate, 1, INT_MAX))
+            continue;
+        if (uart_slip_get_uint32(key, value, UART_SLIP_STR_RTSCTS, &rtscts, 0, 1))
+            continue;
+        if (uart_slip_get_uint32(key, value, UART_SLIP_STR_RESP_TIMEOUT_MS,
+                                 &uart_slip_transport->resp_timeout_ms, 1, INT_MAX / 1000))
+            continue;
+
+        config_error++;
+    }
+
+    config->baudrate = baudrate;
+    config->rtscts = rtscts;
+
+    if (config_error)
+    {
+        mctrl_err("UART SLIP configuration error\n");
+        uart_slip_print_config_usage();
+        return ETRANSERR;
+    }
+
+    if (debug)
+    {
+        mctrl_print("UART device     = %s\n", config->dev_name);
+        mctrl_print("Baud rate       = %d\n", config->baudrate);
+        mctrl_print("RTS/CTS         = %d\n", config->rtscts ? 1 : 0);
+        mctrl_print("Resp timeout    = %u ms\n", uart_slip_transport->resp_timeout_ms);
+    }
 
     return 0;
 }
@@ -180,9 +307,18 @@ static int uart_slip_init(struct morsectrl_transport *transport)
  */
 static int uart_slip_deinit(struct morsectrl_transport *transport)
 {
+    struct morsectrl_uart_slip_transport *uart_slip_transport =
+        (struct morsectrl_uart_slip_transport *)transport;
     struct uart_ctx *ctx = uart_slip_ctx(transport);
 
     uart_slip_ctx_set(transport, NULL);
+    uart_slip_transport->rx_chunk_pos = 0;
+    uart_slip_transport->rx_chunk_len = 0;
+    free(uart_slip_transport->rx_buf);
+    uart_slip_transport->rx_buf = NULL;
+    free(uart_slip_transport->tx_buf);
+    uart_slip_transport->tx_buf = NULL;
+    uart_slip_transport->tx_buf_size = 0;
 
     return uart_deinit(ctx);
 }
@@ -206,142 +342,91 @@ static struct morsectrl_transport_buff *uart_slip_alloc(struct morsectrl_transpo
     if (size <= 0)
         return NULL;
 
-    buff = calloc(1, sizeof(*buff));
+    buff = morsectrl_transport_buff_alloc(transport, size + SEQNUM_LEN + CRC_LEN);
     if (!buff)
         return NULL;
 
-    buff->capacity = size + SEQNUM_LEN + CRC_LEN;
-    buff->memblock = calloc(1, buff->capacity);
-    if (!buff->memblock)
-    {
-        free(buff);
-        return NULL;
-    }
     buff->data = buff->memblock;
     buff->data_len = size;
+    memset(buff->data, 0, size);
 
     return buff;
 }
 
-static int uart_slip_tx_char(uint8_t c, void *arg)
+/**
+ * @brief SLIP encode a frame and write it to the UART in one go.
+ *
+ * @param transport Transport structure.
+ * @param frame     Frame to transmit.
+ * @param frame_len Length of @p frame.
+ * @return          0 on success otherwise relevant error.
+ */
+static int uart_slip_tx_encoded(struct morsectrl_transport *transport,
+                                const uint8_t *frame, size_t frame_len)
 {
-    int ret;
-    struct morsectrl_transport *transport = arg;
+    struct morsectrl_uart_slip_transport *uart_slip_transport =
+        (struct morsectrl_uart_slip_transport *)transport;
     struct uart_ctx *ctx = uart_slip_ctx(transport);
+    size_t needed = SLIP_ENCODED_MAX_LEN(frame_len);
+    size_t len;
+    size_t written = 0;
 
-
-    ret = uart_write(ctx, &c, 1);
-    if (ret == 1)
+    if (uart_slip_transport->tx_buf_size < needed)
     {
-        return 0;
+        uint8_t *tx_buf = realloc(uart_slip_transport->tx_buf, needed);
+
+        if (!tx_buf)
+            return -ETRANSNOMEM;
+
+        uart_slip_transport->tx_buf = tx_buf;
+        uart_slip_transport->tx_buf_size = needed;
     }
-    else
+
+    len = slip_encode(frame, frame_len, uart_slip_transport->tx_buf);
+
+    /* A single write normally suffices, but the UART may accept less than a whole frame */
+    while (written < len)
     {
-        return -1;
+        int ret = uart_write(ctx, uart_slip_transport->tx_buf + written, len - written);
+
+        if (ret <= 0)
+            return -ETRANSERR;
+
+        written += ret;
     }
-}
 
-/**
- * Static table used for the table_driven implementation.
- */
-static const uint16_t crc16_lookup_table[256] = {
-    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
-    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
-    0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
-    0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
-    0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
-    0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
-    0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
-    0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
-    0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
-    0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
-    0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
-    0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
-    0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
-    0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
-    0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
-    0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
-    0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
-    0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
-    0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
-    0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
-    0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
-    0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
-    0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
-    0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
-    0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
-    0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
-    0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
-    0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
-    0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
-    0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
-    0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
-    0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
-};
+    return ETRANSSUCC;
+}
 
 /**
- * @brief Compute the CRC-16 for the data buffer using the XMODEM model.
- *
- * @param crc       Seed for CRC calc, zero in most cases this is zero (0).
- * @param data      Pointer to the start of the data to calculate the crc over.
- * @param data_len  Length of the data array in bytes.
+ * @brief Append the sequence number and CRC to a command, then SLIP encode and transmit it.
  *
- * @return Returns the CRC value.
- *
- * @note This implementation(with a few modifications) and corresponding table was generated using
- *       pycrc v0.9.2 (MIT) using the XMODEM model. https://pycrc.org/. The code generated by pycrc
- *       is not considered a substantial portion of the software, therefore the licence does not
- *       cover the generated code, and the author of pycrc will not claim any copyright on the
- *       generated code (https://pypi.org/project/pycrc/0.9.2/).
+ * @param transport Transport structure.
+ * @param cmd       Command to send. The data length is unchanged on return.
+ * @param seq_num   Sequence number to append to the command.
+ * @return          0 on success otherwise relevant error.
  */
-static uint16_t morse_crc16(uint16_t crc, const void *data, size_t data_len)
+static int uart_slip_tx_frame(struct morsectrl_transport *transport,
+                              struct morsectrl_transport_buff *cmd,
+                              const uint8_t seq_num[SEQNUM_LEN])
 {
-    const uint8_t *d = (const uint8_t *)data;
-
-    while (data_len--)
-    {
-        crc = (crc16_lookup_table[((crc >> 8) ^ *d++)] ^ (crc << 8));
-    }
-    return crc;
-}
-
-static int uart_slip_send(struct morsectrl_transport *transport,
-                         struct morsectrl_transport_buff *cmd,
-                         struct morsectrl_transport_buff *resp)
-{
-    struct uart_ctx *ctx;
-    int ret = -ETRANSERR;
-    int i;
-    uint8_t *cmd_seq_num_field;
-    uint8_t *rsp_seq_num_field;
+    int ret;
     uint8_t *crc_field;
     uint16_t crc;
     size_t original_cmd_data_len;
-    struct slip_rx_state slip_rx_state = SLIP_RX_STATE_INIT(resp->data, resp->capacity);
-    enum slip_rx_status slip_rx_status = SLIP_RX_IN_PROGRESS;
-
-    if (!transport || !transport->tops || !cmd || !resp)
-    {
-        return -ETRANSERR;
-    }
 
     /* We need to restore the data_len field before the function returns, so we stash the
      * value here. */
     original_cmd_data_len = cmd->data_len;
 
-    /* Append random sequence number */
-    cmd_seq_num_field = cmd->data + cmd->data_len;
+    /* Append sequence number */
     cmd->data_len += SEQNUM_LEN;
     MCTRL_ASSERT(cmd->data_len <= cmd->capacity, "Tx buffer insufficient (%u < %u)",
                  cmd->capacity, cmd->data_len);
-    for (i = 0; i < SEQNUM_LEN; i++)
-    {
-        /* NOLINTNEXTLINE(runtime/threadsafe_fn)*/
-        cmd_seq_num_field[i] = rand();
-    }
+    memcpy(cmd->data + original_cmd_data_len, seq_num, SEQNUM_LEN);
 
     /* Append CRC16 */
-    crc = morse_crc16(0, cmd->data, cmd->data_len);
+    crc = crc16_xmodem(0, cmd->data, cmd->data_len);
     crc_field = cmd->data + cmd->data_len;
     cmd->data_len += CRC_LEN;
     MCTRL_ASSERT(cmd->data_len <= cmd->capacity, "Tx buffer insufficient (%u < %u)",
@@ -350,18 +435,81 @@ static int uart_slip_send(struct morsectrl_transport *transport,
     crc_field[1] = (crc >> 8) & 0x0ff;
 
     /* Slip encode and transmit the packet */
-    ret = slip_tx(uart_slip_tx_char, transport, cmd->data, cmd->data_len);
+    ret = uart_slip_tx_encoded(transport, cmd->data, cmd->data_len);
     cmd->data_len = original_cmd_data_len;
 
     if (ret != 0)
     {
         uart_slip_error(ret, "Failed to send command");
-        goto fail;
+        return -ETRANSERR;
     }
 
-    resp->data_len = 0;
+    return ETRANSSUCC;
+}
 
-    ctx = uart_slip_ctx(transport);
+/**
+ * @brief Get the next received octet, reading a chunk from the UART if none are buffered.
+ *
+ * @param transport     Transport structure.
+ * @param c             Set to the received octet.
+ * @param deadline_us   Time by which the octet must arrive, from time_monotonic_us().
+ * @return              0 on success otherwise relevant error.
+ */
+static int uart_slip_rx_char(struct morsectrl_transport *transport, uint8_t *c,
+                             uint64_t deadline_us)
+{
+    struct morsectrl_uart_slip_transport *uart_slip_transport =
+        (struct morsectrl_uart_slip_transport *)transport;
+    struct uart_ctx *ctx = uart_slip_ctx(transport);
+
+    while (uart_slip_transport->rx_chunk_pos == uart_slip_transport->rx_chunk_len)
+    {
+        uint64_t now_us = time_monotonic_us();
+        int ret;
+
+        if (now_us >= deadline_us)
+        {
+            uart_slip_error(-ETRANSERR, "Timed out waiting for response");
+            return -ETRANSERR;
+        }
+
+        ret = uart_read(ctx, uart_slip_transport->rx_chunk, sizeof(uart_slip_transport->rx_chunk),
+                        (deadline_us - now_us + 999) / 1000);
+        if (ret < 0)
+        {
+            uart_slip_error(ret, "Failed to rx command");
+            return ret;
+        }
+
+        uart_slip_transport->rx_chunk_pos = 0;
+        uart_slip_transport->rx_chunk_len = ret;
+    }
+
+    *c = uart_slip_transport->rx_chunk[uart_slip_transport->rx_chunk_pos++];
+
+    return ETRANSSUCC;
+}
+
+/**
+ * @brief Receive a frame with a valid CRC. Frames that are too short or fail the CRC check are
+ *        ignored.
+ *
+ * @param transport     Transport structure.
+ * @param buf           Buffer to receive the frame into.
+ * @param capacity      Size of @p buf.
+ * @param len           Set to the length of the frame, including the sequence number but not the
+ *                      CRC.
+ * @param deadline_us   Time by which the frame must be received, from time_monotonic_us().
+ * @return              0 on success otherwise relevant error.
+ */
+static int uart_slip_rx_frame(struct morsectrl_transport *transport,
+                              uint8_t *buf, size_t capacity, size_t *len, uint64_t deadline_us)
+{
+    struct slip_rx_state slip_rx_state = SLIP_RX_STATE_INIT(buf, capacity);
+    enum slip_rx_status slip_rx_status = SLIP_RX_IN_PROGRESS;
+    uint8_t *crc_field;
+    uint16_t crc;
+    int ret;
 
     while (true)
     {
@@ -369,15 +517,10 @@ static int uart_slip_send(struct morsectrl_transport *transport,
         do
         {
             uint8_t rx_char;
-            ret = uart_read(ctx, &rx_char, 1);
-            if (ret < 0)
-            {
-                uart_slip_error(ret, "Failed to rx command");
-                goto fail;
-            }
-            else if (ret == 0)
+            ret = uart_slip_rx_char(transport, &rx_char, deadline_us);
+            if (ret)
             {
-                continue;
+                return ret;
             }
 
             slip_rx_status = slip_rx(&slip_rx_state, rx_char);
@@ -390,14 +533,13 @@ static int uart_slip_send(struct morsectrl_transport *transport,
                 uart_slip_error(-ETRANSERR, "Response exceeded allocated buffer");
             }
             uart_slip_error(-ETRANSERR, "Slip RX transfer incomplete");
-            ret = -ETRANSERR;
-            goto fail;
+            return -ETRANSERR;
         }
 
-        resp->data_len = slip_rx_state.length;
-        if (resp->data_len < SEQNUM_LEN + CRC_LEN)
+        *len = slip_rx_state.length;
+        if (*len < SEQNUM_LEN + CRC_LEN)
         {
-            if (resp->data_len > 0)
+            if (*len > 0)
             {
                 uart_slip_error(-ETRANSERR, "Received frame too short. Ignoring it...");
             }
@@ -405,20 +547,62 @@ static int uart_slip_send(struct morsectrl_transport *transport,
         }
 
         /* Remove and validate CRC */
-        resp->data_len -= CRC_LEN;
-        crc = morse_crc16(0, resp->data, resp->data_len);
-        crc_field = resp->data + resp->data_len;
+        *len -= CRC_LEN;
+        crc = crc16_xmodem(0, buf, *len);
+        crc_field = buf + *len;
         if ((crc_field[0] != (crc & 0xff)) || crc_field[1] != ((crc >> 8) & 0xff))
         {
             uart_slip_error(-ETRANSERR, "CRC error for received frame. Ignoring it...");
             continue;
         }
 
+        return ETRANSSUCC;
+    }
+}
+
+static int uart_slip_send(struct morsectrl_transport *transport,
+                         struct morsectrl_transport_buff *cmd,
+                         struct morsectrl_transport_buff *resp)
+{
+    struct morsectrl_uart_slip_transport *uart_slip_transport =
+        (struct morsectrl_uart_slip_transport *)transport;
+    uint64_t deadline_us;
+    int ret = -ETRANSERR;
+    int i;
+    uint8_t cmd_seq_num[SEQNUM_LEN];
+    uint8_t *rsp_seq_num_field;
+    size_t len;
+
+    if (!transport || !transport->tops || !cmd || !resp)
+    {
+        return -ETRANSERR;
+    }
+
+    /* Use a random sequence number */
+    for (i = 0; i < SEQNUM_LEN; i++)
+    {
+        /* NOLINTNEXTLINE(runtime/threadsafe_fn)*/
+        cmd_seq_num[i] = rand();
+    }
+
+    ret = uart_slip_tx_frame(transport, cmd, cmd_seq_num);
+    if (ret)
+        return ret;
+
+    resp->data_len = 0;
+    deadline_us = time_monotonic_us() + (uint64_t)uart_slip_transport->resp_timeout_ms * 1000;
+
+    while (true)
+    {
+        ret = uart_slip_rx_frame(transport, resp->data, resp->capacity, &len, deadline_us);
+        if (ret)
+            return ret;
+
         /* Remove and validate sequence number */
-        resp->data_len -= SEQNUM_LEN;
+        resp->data_len = len - SEQNUM_LEN;
         rsp_seq_num_field = resp->data + resp->data_len;
 
-        if (memcmp(cmd_seq_num_field, rsp_seq_num_field, SEQNUM_LEN) != 0)
+        if (memcmp(cmd_seq_num, rsp_seq_num_field, SEQNUM_LEN) != 0)
         {
             uart_slip_error(-ETRANSERR, "Seq # incorrect for received frame. Ignoring it...");
             continue;
@@ -426,8 +610,76 @@ static int uart_slip_send(struct morsectrl_transport *transport,
 
         return ETRANSSUCC;
     }
-fail:
-    return ret;
+}
+
+/**
+ * @brief Send a command without waiting for the response.
+ *
+ * The tag is carried in the first two bytes of the sequence number (little endian), the
+ * remaining bytes are random.
+ */
+static int uart_slip_submit(struct morsectrl_transport *transport,
+                            struct morsectrl_transport_buff *cmd,
+                            uint16_t tag)
+{
+    uint8_t cmd_seq_num[SEQNUM_LEN];
+    int i;
+
+    if (!transport || !transport->tops || !cmd)
+    {
+        return -ETRANSERR;
+    }
+
+    cmd_seq_num[0] = tag & 0xff;
+    cmd_seq_num[1] = (tag >> 8) & 0xff;
+    for (i = 2; i < SEQNUM_LEN; i++)
+    {
+        /* NOLINTNEXTLINE(runtime/threadsafe_fn)*/
+        cmd_seq_num[i] = rand();
+    }
+
+    return uart_slip_tx_frame(transport, cmd, cmd_seq_num);
+}
+
+/**
+ * @brief Receive one response and pass it to the completion function, tagged with the first two
+ *        bytes of its sequence number.
+ */
+static int uart_slip_receive(struct morsectrl_transport *transport,
+                             morsectrl_transport_complete_fn complete,
+                             void *arg)
+{
+    struct morsectrl_uart_slip_transport *uart_slip_transport =
+        (struct morsectrl_uart_slip_transport *)transport;
+    uint8_t *seq_num_field;
+    size_t len;
+    int ret;
+
+    if (!transport || !transport->tops || !complete)
+    {
+        return -ETRANSERR;
+    }
+
+    if (!uart_slip_transport->rx_buf)
+    {
+        uart_slip_transport->rx_buf = malloc(UART_SLIP_ASYNC_RX_BUFFER_SIZE);
+        if (!uart_slip_transport->rx_buf)
+            return -ETRANSNOMEM;
+    }
+
+    ret = uart_slip_rx_frame(transport, uart_slip_transport->rx_buf,
+                             UART_SLIP_ASYNC_RX_BUFFER_SIZE, &len,
+                             time_monotonic_us() +
+                             (uint64_t)uart_slip_transport->resp_timeout_ms * 1000);
+    if (ret)
+        return ret;
+
+    len -= SEQNUM_LEN;
+    seq_num_field = uart_slip_transport->rx_buf + len;
+
+    complete(arg, seq_num_field[0] | (seq_num_field[1] << 8), 0, uart_slip_transport->rx_buf, len);
+
+    return ETRANSSUCC;
 }
 
 static const struct morsectrl_transport_ops uart_slip_ops = {
@@ -448,8 +700,12 @@ static const struct morsectrl_transport_ops uart_slip_ops = {
     .raw_read = NULL,
     .raw_write = NULL,
     .raw_read_write = NULL,
+    .raw_queue = NULL,
+    .raw_flush = NULL,
     .reset_device = NULL,
     .get_ifname = NULL,
+    .submit = uart_slip_submit,
+    .receive = uart_slip_receive,
 };
 
 REGISTER_TRANSPORT(uart_slip_ops);
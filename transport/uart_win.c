@@ -31,6 +31,8 @@
 struct uart_ctx
 {
     HANDLE hnd;
+    /** Read timeout currently configured on the handle, -1 if not yet set */
+    int read_timeout_ms;
 };
 
 struct uart_ctx *uart_init(const struct uart_config *config)
@@ -49,7 +51,7 @@ struct uart_ctx *uart_init(const struct uart_config *config)
         .BaudRate = config->baudrate,
         .fBinary = TRUE,
         .fParity = FALSE,
-        .fOutxCtsFlow = FALSE,
+        .fOutxCtsFlow = config->rtscts,
         .fOutxDsrFlow = FALSE,
         .fDtrControl = DTR_CONTROL_DISABLE,
         .fDsrSensitivity = FALSE,
@@ -58,7 +60,7 @@ struct uart_ctx *uart_init(const struct uart_config *config)
         .fInX = FALSE,
         .fErrorChar = FALSE,
         .fNull = FALSE,
-        .fRtsControl = RTS_CONTROL_DISABLE,
+        .fRtsControl = config->rtscts ? RTS_CONTROL_HANDSHAKE : RTS_CONTROL_DISABLE,
         .fAbortOnError = TRUE,
         .ByteSize = 8,
         .Parity = NOPARITY,
@@ -67,6 +69,7 @@ struct uart_ctx *uart_init(const struct uart_config *config)
 
     ctx = calloc(1, sizeof(*ctx));
     MCTRL_ASSERT(ctx != NULL, "Memory allocation failure");
+    ctx->read_timeout_ms = -1;
 
     ctx->hnd = CreateFile(config->dev_name, GENERIC_READ | GENERIC_WRITE,
                           0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -119,11 +122,30 @@ int uart_deinit(struct uart_ctx *ctx)
     return ret;
 }
 
-int uart_read(struct uart_ctx *ctx, uint8_t *buf, size_t len)
+int uart_read(struct uart_ctx *ctx, uint8_t *buf, size_t len, int timeout_ms)
 {
     bool ok;
     DWORD actual_read_len;
 
+    if (timeout_ms != ctx->read_timeout_ms)
+    {
+        /* Return as soon as any data has been received, or after the timeout if none arrives */
+        COMMTIMEOUTS comm_timeouts = {
+            .ReadIntervalTimeout = MAXDWORD,
+            .ReadTotalTimeoutMultiplier = timeout_ms ? MAXDWORD : 0,
+            .ReadTotalTimeoutConstant = timeout_ms,
+            .WriteTotalTimeoutMultiplier = 10,
+            .WriteTotalTimeoutConstant = 100,
+        };
+
+        ok = SetCommTimeouts(ctx->hnd, &comm_timeouts);
+        if (!ok)
+        {
+            return -ETRANSERR;
+        }
+        ctx->read_timeout_ms = timeout_ms;
+    }
+
     ok = ReadFile(ctx->hnd, buf, len, &actual_read_len, NULL);
     if (!ok)
     {
@@ -313,70 +313,17 @@ char *strip(char *s)
     return start;
 }
 
-uint8_t crc7_gen(uint64_t number, uint8_t bit_count)
+uint64_t hash_fnv1a_64(uint64_t hash, const void *data, size_t len)
 {
-    int ii;
-    uint32_t reg_val = 0;
+    const uint8_t *d = data;
 
-    for (ii = bit_count; ii > 0; ii -= 8)
+    while (len--)
     {
-        uint32_t bit_idx;
-        uint8_t shift_val = ii - 8;
-        uint8_t octet_val = (number >> shift_val) & 0xFF;
-
-        for (bit_idx = 0; bit_idx < 8; bit_idx++)
-        {
-            reg_val <<= 1;
-            if (((octet_val ^ reg_val) & 0x80) > 0)
-                reg_val ^= 9;
-
-            octet_val = (octet_val << 1) & 0xFF;
-        }
-
-        reg_val &= 0x7F;
-    }
-
-    return (uint8_t)reg_val;
-}
-
-uint16_t crc16_gen(uint8_t *buff, size_t len)
-{
-    int ii, jj;
-    uint32_t crc = 0;
-    uint32_t round = 0;
-    size_t bit_count = len * 8;
-
-    for (ii = 0; ii < len; ii ++)
-    {
-        /* Let's go from MSb first. */
-        for (jj = 7; jj >= 0; jj--)
-        {
-            uint32_t val = ((buff[ii] >> jj) ^ (crc >> 15)) & 0x1;
-
-            crc ^= ((val << 4) | (val << 11));
-            crc = (crc << 1) | val;
-            bit_count -= 1;
-            round += 1;
-            if (bit_count == 0)
-                break;
-        }
-        if (bit_count == 0)
-            break;
+        hash ^= *d++;
+        hash *= 0x100000001b3ULL;
     }
 
-    return (crc & 0xFFFF);
-}
-
-bool crc16_check(uint8_t *buff, size_t len, uint16_t crc16)
-{
-    uint16_t buff_crc16;
-
-    if (!buff)
-        return false;
-
-    buff_crc16 = crc16_gen(buff, len);
-
-    return (crc16 == buff_crc16);
+    return hash;
 }
 
 size_t get_file_size(FILE *infile)
@@ -21,6 +21,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #ifdef MORSE_WIN_BUILD
@@ -292,34 +293,18 @@ int expression_to_int(const char *str);
  */
 char *strip(char *s);
 
-/**
- * @brief Simple inefficient calculation of CRC7
- *
- * @param number    value to run CRC on
- * @param bit_count number of bits of @c value to to run CRC on
- *
- * @return          CRC7 value
- */
-uint8_t crc7_gen(uint64_t number, uint8_t bit_count);
-
-/**
- * @brief Simple inefficient calculation of CRC16
- *
- * @param buff  Buffer of octets to run CRC16 on
- * @param len   Number of octets to run CRC16 on
- * @return      CRC16 value
- */
-uint16_t crc16_gen(uint8_t *buff, size_t len);
+/** Initial value for hash_fnv1a_64() */
+#define FNV1A_64_INIT   (0xcbf29ce484222325ULL)
 
 /**
- * @brief Calculate the CRC16 of a buffer and compare against a reference value.
+ * @brief Calculate the 64-bit FNV-1a hash of a buffer.
  *
- * @param buff  Buffer to perform the CRC16 check on.
- * @param len   Length of the buffer.
- * @param crc16 Reference CRC16 value.
- * @return      true if calculated CRC16 matches the reference value, otherwise false.
+ * @param hash  FNV1A_64_INIT, or the hash of the preceding data to continue a hash.
+ * @param data  Data to hash.
+ * @param len   Length of the data.
+ * @return      The hash.
  */
-bool crc16_check(uint8_t *buff, size_t len, uint16_t crc16);
+uint64_t hash_fnv1a_64(uint64_t hash, const void *data, size_t len);
 
 /**
  * @brief Get the file size of a file.
@@ -353,6 +338,71 @@ static inline void sleep_ms(uint32_t ms)
 #endif
 }
 
+/**
+ * @brief Sleep for a number of microseconds.
+ *
+ * @note On Windows the sleep is rounded up to a whole number of milliseconds.
+ *
+ * @param us    Time to sleep for in us.
+ */
+static inline void sleep_us(uint32_t us)
+{
+#ifdef MORSE_WIN_BUILD
+    Sleep((us + 999) / 1000);
+#else
+    sleep(us / 1000000);
+    usleep(us % 1000000);
+#endif
+}
+
+/**
+ * @brief Get the time from a monotonic clock.
+ *
+ * @return Time in us since an arbitrary starting point.
+ */
+static inline uint64_t time_monotonic_us(void)
+{
+#ifdef MORSE_WIN_BUILD
+    LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (count.QuadPart / freq.QuadPart) * 1000000 +
+           ((count.QuadPart % freq.QuadPart) * 1000000) / freq.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * @brief Get the wall clock time.
+ *
+ * @return Time in us since the Unix epoch.
+ */
+static inline uint64_t time_realtime_us(void)
+{
+#ifdef MORSE_WIN_BUILD
+    /* FILETIME counts 100 ns intervals since 1601 */
+    const uint64_t epoch_offset_us = 11644473600000000ULL;
+    FILETIME ft;
+    ULARGE_INTEGER t;
+
+    GetSystemTimeAsFileTime(&ft);
+    t.LowPart = ft.dwLowDateTime;
+    t.HighPart = ft.dwHighDateTime;
+    return t.QuadPart / 10 - epoch_offset_us;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
 /**
  * Convert a MAC address string into a byte array.
  *